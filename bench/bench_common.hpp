@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "library.hpp"
+
+namespace bench {
+
+// Catálogo sintético: `copies` copias repartidas en copies/4 libros (el 1% son
+// new releases) y copies/2 lectores, más `history` préstamos ya cerrados.
+lib::MemoryDb& catalog(std::size_t copies, std::size_t history);
+
+// Llamadas a operator new desde el arranque (bench_main las cuenta)
+std::uint64_t allocations();
+
+// Registra los benchmarks parametrizados por tamaño de catálogo hasta maxCopies
+void registerLoanBenchmarks(std::size_t maxCopies);
+
+} // namespace bench
@@ -0,0 +1,61 @@
+// Carga de copias: asignar db.copies[...] una a una (como seedMinimal) frente
+// a BulkImporter sobre el mismo CSV en memoria.
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include "bulk_import.hpp"
+#include "library.hpp"
+
+using namespace lib;
+
+namespace {
+
+constexpr std::size_t kBooks = 1024;
+
+std::string copiesCsv(std::size_t copies) {
+    std::string csv = "id,bookId,status\n";
+    for (std::size_t i = 0; i < copies; ++i) csv += "C" + std::to_string(i) + ",B" + std::to_string(i % kBooks) + "\n";
+    return csv;
+}
+
+void addBooks(MemoryDb& db) {
+    for (std::size_t b = 0; b < kBooks; ++b) {
+        const std::string id = "B" + std::to_string(b);
+        db.books[id] = Book{id, "Title", 2000, Author{"A", "1970-01-01"}, "1st", false};
+    }
+}
+
+void BM_SeedByAssign(benchmark::State& state) {
+    const auto copies = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state) {
+        MemoryDb db;
+        addBooks(db);
+        for (std::size_t i = 0; i < copies; ++i) {
+            const std::string id = "C" + std::to_string(i);
+            db.copies[id] = Copy{id, "B" + std::to_string(i % kBooks), CopyStatus::IN_LIBRARY};
+        }
+        db.rebuildIndexes();
+        benchmark::DoNotOptimize(db.copies.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_BulkImport(benchmark::State& state) {
+    const auto copies = static_cast<std::size_t>(state.range(0));
+    const std::string csv = copiesCsv(copies);
+    for (auto _ : state) {
+        MemoryDb db;
+        addBooks(db);
+        std::istringstream in(csv);
+        BulkImporter importer(db);
+        importer.importCopies(in);
+        benchmark::DoNotOptimize(importer.report().copies);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(BM_SeedByAssign)->RangeMultiplier(8)->Range(1 << 12, 1 << 18)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BulkImport)->RangeMultiplier(8)->Range(1 << 12, 1 << 18)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,283 @@
+// borrowCopy / returnCopy / borrowOriginalNewRelease sobre catálogos de
+// distinto tamaño y con distinto volumen de historial de préstamos.
+#include <benchmark/benchmark.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bench_common.hpp"
+
+using namespace lib;
+
+namespace bench {
+
+namespace {
+
+const auto kToday = makeDate(2025, 10, 1);
+
+std::string copyId(std::size_t i)   { return "C" + std::to_string(i); }
+std::string bookId(std::size_t i)   { return "B" + std::to_string(i); }
+std::string readerId(std::size_t i) { return "R" + std::to_string(i); }
+
+std::size_t bookCount(std::size_t copies)   { return copies / 4 > 0 ? copies / 4 : 1; }
+std::size_t readerCount(std::size_t copies) { return copies / 2 > 0 ? copies / 2 : 1; }
+
+std::unique_ptr<MemoryDb> build(std::size_t copies, std::size_t history,
+                                std::pmr::memory_resource* loanArena = std::pmr::get_default_resource()) {
+    auto db = std::make_unique<MemoryDb>(loanArena);
+    const std::size_t books = bookCount(copies), readers = readerCount(copies);
+    db->books.reserve(books);
+    db->copies.reserve(copies);
+    db->readers.reserve(readers);
+    for (std::size_t b = 0; b < books; ++b) {
+        db->books[bookId(b)] = Book{ bookId(b), "Title " + std::to_string(b), 2000, Author{"A", "1970-01-01"},
+                                     "1st", b % 100 == 0 };
+    }
+    for (std::size_t c = 0; c < copies; ++c) db->copies[copyId(c)] = Copy{ copyId(c), bookId(c % books), CopyStatus::IN_LIBRARY };
+    for (std::size_t r = 0; r < readers; ++r) db->readers[readerId(r)] = Reader{ readerId(r), readerId(r) + "@example.com", {}, {} };
+    db->rebuildIndexes(); // cargado a mano: indexa las copias
+
+    // Historial: préstamos devueltos a tiempo (no generan baneos)
+    LibraryService svc(*db);
+    for (std::size_t i = 0; i < history; ++i) {
+        const CopyHandle c = CopyHandle(Handle(i % copies));
+        svc.borrowCopy(c, ReaderHandle(Handle(i % readers)), kToday);
+        svc.returnCopy(c, kToday);
+    }
+    return db;
+}
+
+// Se reutiliza entre ejecuciones: cada benchmark deja todas las copias devueltas
+MemoryDb& cached(std::size_t copies, std::size_t history) {
+    static std::map<std::pair<std::size_t, std::size_t>, std::unique_ptr<MemoryDb>> dbs;
+    auto& slot = dbs[{copies, history}];
+    if (!slot) slot = build(copies, history);
+    return *slot;
+}
+
+// El mismo catálogo con los préstamos en un pool: los nodos de los índices
+// de préstamos abiertos se reciclan al devolver
+MemoryDb& pooled(std::size_t copies, std::size_t history) {
+    struct Pooled {
+        std::pmr::unsynchronized_pool_resource pool;
+        std::unique_ptr<MemoryDb> db;
+    };
+    static std::map<std::pair<std::size_t, std::size_t>, std::unique_ptr<Pooled>> dbs;
+    auto& slot = dbs[{copies, history}];
+    if (!slot) {
+        slot = std::make_unique<Pooled>();
+        slot->db = build(copies, history, &slot->pool);
+    }
+    return *slot->db;
+}
+
+// Cada iteración presta una copia distinta a un lector distinto; cada
+// `chunk` iteraciones se devuelve todo fuera del tiempo medido.
+constexpr std::size_t kChunk = 1024;
+
+// Reservas por iteración medidas alrededor del bucle (incluye las pausas)
+struct AllocCounter {
+    benchmark::State& state;
+    std::uint64_t start = allocations();
+    ~AllocCounter() {
+        state.counters["allocs/op"] = benchmark::Counter(double(allocations() - start),
+                                                         benchmark::Counter::kAvgIterations);
+    }
+};
+
+template <bool Pooled>
+void BM_BorrowCopy(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = Pooled ? pooled(copies, history) : catalog(copies, history);
+    BioAlert::getInstance().reset();
+    LibraryService svc(db);
+    const std::size_t n = std::min({kChunk, copies, readerCount(copies)});
+    std::size_t i = 0;
+    AllocCounter allocs{state};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(svc.borrowCopy(copyId(i), readerId(i), kToday));
+        if (++i == n) {
+            state.PauseTiming();
+            for (std::size_t k = 0; k < n; ++k) svc.returnCopy(copyId(k), kToday);
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    for (std::size_t k = 0; k < i; ++k) svc.returnCopy(copyId(k), kToday);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReturnCopy(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = catalog(copies, history);
+    BioAlert::getInstance().reset();
+    LibraryService svc(db);
+    const std::size_t n = std::min({kChunk, copies, readerCount(copies)});
+    auto lend = [&]{ for (std::size_t k = 0; k < n; ++k) svc.borrowCopy(copyId(k), readerId(k), kToday); };
+    lend();
+    std::size_t i = 0;
+    AllocCounter allocs{state};
+    for (auto _ : state) {
+        svc.returnCopy(copyId(i), kToday);
+        if (++i == n) {
+            state.PauseTiming();
+            lend();
+            i = 0;
+            state.ResumeTiming();
+        }
+    }
+    for (std::size_t k = i; k < n; ++k) svc.returnCopy(copyId(k), kToday);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Versión por handles: mide la lógica sin la resolución de IDs externos
+template <bool Pooled>
+void BM_BorrowReturnByHandle(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = Pooled ? pooled(copies, history) : catalog(copies, history);
+    BioAlert::getInstance().reset();
+    LibraryService svc(db);
+    std::size_t i = 0;
+    const std::size_t readers = readerCount(copies);
+    AllocCounter allocs{state};
+    for (auto _ : state) {
+        const CopyHandle c = CopyHandle(Handle(i % copies));
+        benchmark::DoNotOptimize(svc.borrowCopy(c, ReaderHandle(Handle(i % readers)), kToday));
+        svc.returnCopy(c, kToday);
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_BorrowOriginalNewRelease(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = catalog(copies, history);
+    BioAlert::getInstance().reset();
+    LibraryService svc(db);
+    // Los libros 0, 100, 200, ... son new releases
+    const std::size_t releases = (bookCount(copies) + 99) / 100;
+    const std::size_t readers = readerCount(copies);
+    std::size_t i = 0;
+    AllocCounter allocs{state};
+    for (auto _ : state) {
+        const std::string b = bookId((i % releases) * 100);
+        const std::string r = readerId(i % readers);
+        benchmark::DoNotOptimize(svc.borrowOriginalNewRelease(b, r, kToday));
+        state.PauseTiming();
+        svc.returnOriginalNewRelease(b, r, kToday);
+        state.ResumeTiming();
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Préstamo rechazado (copia ya prestada): la API que lanza frente a la que
+// devuelve LibError. Con ~20% de rechazos en producción, es el coste del desenrollado.
+template <bool Throwing>
+void BM_BorrowRejected(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = catalog(copies, history);
+    BioAlert::getInstance().reset();
+    LibraryService svc(db);
+    const std::string busy = copyId(0);
+    svc.borrowCopy(busy, readerId(0), kToday);
+    const std::string r = readerId(1);
+    for (auto _ : state) {
+        if constexpr (Throwing) {
+            try {
+                svc.borrowCopy(busy, r, kToday);
+            } catch (const std::runtime_error& e) {
+                benchmark::DoNotOptimize(e.what());
+            }
+        } else {
+            benchmark::DoNotOptimize(svc.tryBorrowCopy(busy, r, kToday).error());
+        }
+    }
+    svc.returnCopy(busy, kToday);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Suma de días de retraso del historial: recorrer `loans` (un Loan por nodo
+// o por hueco) frente a la columna `late` del histórico archivado.
+// Catálogo propio: archivar vacía `loans` y el catálogo compartido lo necesita.
+MemoryDb& archived(std::size_t copies, std::size_t history) {
+    static std::map<std::pair<std::size_t, std::size_t>, std::unique_ptr<MemoryDb>> dbs;
+    auto& slot = dbs[{copies, history}];
+    if (!slot) {
+        slot = build(copies, history);
+        LibraryService(*slot).archiveReturned(kToday + std::chrono::days(1));
+    }
+    return *slot;
+}
+
+template <bool Columnar>
+void BM_TotalLateDays(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = Columnar ? archived(copies, history) : catalog(copies, history);
+    for (auto _ : state) {
+        std::uint64_t sum = 0;
+        if constexpr (Columnar) {
+            sum = db.archive.totalLateDays();
+        } else {
+            for (auto& kv : db.loans) sum += static_cast<std::uint64_t>(kv.second.lateDays());
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(history));
+}
+
+// Recuento de todo el fondo por estado: recorriendo los registros Copy
+// frente a la columna de estados de MemoryDb::copyStates
+template <bool Columns>
+void BM_CountByStatus(benchmark::State& state) {
+    const std::size_t copies = state.range(0), history = state.range(1);
+    MemoryDb& db = catalog(copies, history);
+    BioAlert::getInstance().reset();
+    LibraryService svc(db);
+    for (auto _ : state) {
+        if constexpr (Columns) {
+            benchmark::DoNotOptimize(svc.countCopiesByStatus());
+        } else {
+            std::array<std::size_t, kCopyStatusCount> counts{};
+            for (auto& kv : db.copies) ++counts[std::size_t(kv.second.status)];
+            benchmark::DoNotOptimize(counts);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(copies));
+}
+
+void addSizes(benchmark::internal::Benchmark* b, std::size_t maxCopies) {
+    for (std::size_t copies = 1000; copies <= maxCopies; copies *= 10) {
+        for (std::size_t history : {std::size_t{0}, std::size_t{100'000}, std::size_t{1'000'000}}) {
+            if (history > 10 * copies) continue;
+            b->Args({static_cast<int64_t>(copies), static_cast<int64_t>(history)});
+        }
+    }
+    b->ArgNames({"copies", "history"});
+}
+
+} // namespace
+
+MemoryDb& catalog(std::size_t copies, std::size_t history) { return cached(copies, history); }
+
+void registerLoanBenchmarks(std::size_t maxCopies) {
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowCopy", BM_BorrowCopy<false>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowCopy/pool", BM_BorrowCopy<true>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_ReturnCopy", BM_ReturnCopy), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowReturnByHandle", BM_BorrowReturnByHandle<false>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowReturnByHandle/pool", BM_BorrowReturnByHandle<true>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowOriginalNewRelease", BM_BorrowOriginalNewRelease), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowRejected/throw", BM_BorrowRejected<true>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_BorrowRejected/expected", BM_BorrowRejected<false>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_TotalLateDays/loans", BM_TotalLateDays<false>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_TotalLateDays/archive", BM_TotalLateDays<true>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_CountByStatus/records", BM_CountByStatus<false>), maxCopies);
+    addSizes(benchmark::RegisterBenchmark("BM_CountByStatus/columns", BM_CountByStatus<true>), maxCopies);
+}
+
+} // namespace bench
@@ -0,0 +1,51 @@
+// Suite de benchmarks de la lógica de préstamos.
+//   ./bench                              catálogos de 1e3 a 1e6 copias
+//   BIBLIOTECA_BENCH_MAX_COPIES=10000000 ./bench --benchmark_filter=Borrow
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "bench_common.hpp"
+
+// Cuenta las reservas de todo el binario (ver bench::allocations)
+namespace {
+std::atomic<std::uint64_t> gAllocations{0};
+} // namespace
+
+std::uint64_t bench::allocations() { return gAllocations.load(std::memory_order_relaxed); }
+
+void* operator new(std::size_t n) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc{};
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+// std::pmr::new_delete_resource usa las versiones con alineación
+void* operator new(std::size_t n, std::align_val_t a) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t al = static_cast<std::size_t>(a);
+    if (void* p = std::aligned_alloc(al, (n + al - 1) / al * al)) return p;
+    throw std::bad_alloc{};
+}
+void* operator new[](std::size_t n, std::align_val_t a) { return operator new(n, a); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+int main(int argc, char** argv) {
+    std::size_t maxCopies = 1'000'000;
+    if (const char* env = std::getenv("BIBLIOTECA_BENCH_MAX_COPIES")) maxCopies = std::stoull(env);
+    bench::registerLoanBenchmarks(maxCopies);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Coste por suscriptor de BioAlert::notifyAvailable: versión anterior
+// (std::function que devuelve std::string + un sendEmail virtual por
+// suscriptor) frente a la actual (FunctionRef con string_view + un lote).
+// Y una devolución de un título con n interesados: suscritos (aviso a todos)
+// frente a en la cola de reservas (la copia se aparta para uno).
+#include <benchmark/benchmark.h>
+#include "library.hpp"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+
+using namespace lib;
+
+namespace {
+
+struct NullGateway : NotificationGateway {
+    std::size_t sent{0};
+    void sendEmail(const std::string& to, const std::string& subject, const std::string& body) override {
+        ++sent;
+        benchmark::DoNotOptimize(to.data());
+        benchmark::DoNotOptimize(subject.data());
+        benchmark::DoNotOptimize(body.data());
+    }
+    void sendEmails(std::span<const EmailView> batch) override {
+        sent += batch.size();
+        for (auto& m : batch) benchmark::DoNotOptimize(m.to.data());
+    }
+};
+
+MemoryDb makeNotifyDb(int subscribers) {
+    MemoryDb db;
+    db.books["B1"] = Book{ "B1","Software Engineering",2020, Author{"Ian Sommerville","1951-08-23"},"10th", false };
+    for (int i = 0; i < subscribers; ++i) {
+        const std::string id = "R" + std::to_string(i);
+        db.readers[id] = Reader{ id, "reader" + std::to_string(i) + "@example.com", {}, {} };
+    }
+    return db;
+}
+
+// Réplica del algoritmo anterior
+void legacyNotify(NotificationGateway& gw, const std::map<std::string, std::set<std::string>>& subs,
+                  const std::string& bookId,
+                  std::function<std::string(const std::string&)> getEmailByReaderId,
+                  std::function<std::string(const std::string&)> getBookTitleByBookId) {
+    auto it = subs.find(bookId);
+    if (it == subs.end()) return;
+    std::string title = getBookTitleByBookId(bookId);
+    for (auto& rid : it->second) {
+        gw.sendEmail(getEmailByReaderId(rid), "Disponible: " + title, "Ya puedes solicitarlo");
+    }
+}
+
+void BM_NotifyLegacy(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    MemoryDb db = makeNotifyDb(n);
+    std::map<std::string, std::set<std::string>> subs;
+    for (auto& kv : db.readers) subs["B1"].insert(kv.first);
+    NullGateway gw;
+    for (auto _ : state) {
+        legacyNotify(gw, subs, "B1",
+                     [&](const std::string& rid){ return db.readers.at(rid).email; },
+                     [&](const std::string& bid){ return db.books.at(bid).title; });
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+void BM_NotifyCurrent(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    MemoryDb db = makeNotifyDb(n);
+    NullGateway gw;
+    auto& alert = BioAlert::getInstance();
+    alert.reset();
+    alert.setGateway(&gw);
+    for (auto& kv : db.readers) alert.subscribe("B1", kv.first);
+    for (auto _ : state) {
+        alert.notifyAvailable("B1",
+            [&](std::string_view rid) -> std::string_view { return db.readers.at(rid).email; },
+            [&](std::string_view bid) -> std::string_view { return db.books.at(bid).title; });
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+    alert.reset();
+}
+
+// Con tope de avisos por evento el coste ya no crece con los suscriptores
+void BM_NotifyBounded(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    MemoryDb db = makeNotifyDb(n);
+    NullGateway gw;
+    BioAlert alert;
+    alert.setGateway(&gw);
+    alert.setPolicy({.maxPerEvent = 20});
+    for (auto& kv : db.readers) alert.subscribe("B1", kv.first);
+    for (auto _ : state) {
+        alert.notifyAvailable("B1",
+            [&](std::string_view rid) -> std::string_view { return db.readers.at(rid).email; },
+            [&](std::string_view bid) -> std::string_view { return db.books.at(bid).title; });
+    }
+    state.SetItemsProcessed(state.iterations() * std::min(n, 20));
+}
+
+// Préstamo + devolución de la única copia de B1 con n lectores interesados
+template <bool Queue>
+void BM_ReturnPopular(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    MemoryDb db = makeNotifyDb(n + 1);
+    db.copies["C1"] = Copy{ "C1","B1", CopyStatus::IN_LIBRARY };
+    db.rebuildIndexes();
+    NullGateway gw;
+    BioAlert alert;
+    alert.setGateway(&gw);
+    LibraryService svc(db, alert);
+    const auto day = makeDate(2025, 10, 1);
+    for (int i = 0; i < n; ++i) {
+        const std::string id = "R" + std::to_string(i);
+        if constexpr (Queue) svc.reserve("B1", id, day); else alert.subscribe("B1", id);
+    }
+    // Con cola, quien la tiene apartada se la lleva y vuelve al final de la
+    // cola; sin ella, la presta siempre el mismo lector
+    int next = 0;
+    for (auto _ : state) {
+        const std::string reader = Queue ? "R" + std::to_string(next) : "R" + std::to_string(n);
+        svc.borrowAnyCopy("B1", reader, day);
+        if constexpr (Queue) svc.reserve("B1", reader, day);
+        svc.returnCopy("C1", day);
+        next = (next + 1) % std::max(n, 1);
+    }
+    state.counters["emails/op"] = benchmark::Counter(double(gw.sent), benchmark::Counter::kAvgIterations);
+}
+
+} // namespace
+
+BENCHMARK(BM_NotifyLegacy)->Arg(0)->Arg(10)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_NotifyCurrent)->Arg(0)->Arg(10)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_NotifyBounded)->Arg(100)->Arg(10000);
+BENCHMARK(BM_ReturnPopular<false>)->Name("BM_ReturnPopular/subscribers")->Arg(10)->Arg(1000);
+BENCHMARK(BM_ReturnPopular<true>)->Name("BM_ReturnPopular/queue")->Arg(10)->Arg(1000);
@@ -0,0 +1,73 @@
+// Préstamo + devolución con varios hilos: un LibraryService frente a
+// ShardedLibrary con una sede por hilo. Cada hilo trabaja con sus copias y
+// sus lectores, así lo único compartido es lo que pone cada variante.
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "library.hpp"
+#include "sharded_library.hpp"
+
+using namespace lib;
+
+namespace {
+
+const auto kToday = makeDate(2025, 10, 1);
+constexpr std::size_t kCopiesPerThread = 1024;
+constexpr int kMaxThreads = 8;
+
+std::string copyId(std::size_t i)   { return "C" + std::to_string(i); }
+std::string readerId(std::size_t i) { return "R" + std::to_string(i); }
+
+Book book() { return Book{"B0", "Title", 2000, Author{"A", "1970-01-01"}, "1st", false}; }
+
+void BM_BorrowReturnService(benchmark::State& state) {
+    static std::unique_ptr<MemoryDb> db;
+    static std::unique_ptr<BioAlert> alerts;
+    static std::unique_ptr<LibraryService> svc;
+    if (state.thread_index() == 0) {
+        db = std::make_unique<MemoryDb>();
+        alerts = std::make_unique<BioAlert>();
+        db->books["B0"] = book();
+        for (std::size_t i = 0; i < kCopiesPerThread * kMaxThreads; ++i) {
+            db->copies[copyId(i)] = Copy{copyId(i), "B0", CopyStatus::IN_LIBRARY};
+            db->readers[readerId(i)] = Reader{readerId(i), readerId(i) + "@example.com", {}, {}};
+        }
+        svc = std::make_unique<LibraryService>(*db, *alerts);
+    }
+    const std::size_t base = std::size_t(state.thread_index()) * kCopiesPerThread;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const std::size_t k = base + i++ % kCopiesPerThread;
+        benchmark::DoNotOptimize(svc->borrowCopy(copyId(k), readerId(k), kToday));
+        svc->returnCopy(copyId(k), kToday);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_BorrowReturnSharded(benchmark::State& state) {
+    static std::unique_ptr<BioAlert> alerts;
+    static std::unique_ptr<ShardedLibrary> lib;
+    if (state.thread_index() == 0) {
+        alerts = std::make_unique<BioAlert>();
+        lib = std::make_unique<ShardedLibrary>(std::size_t(state.threads()), *alerts);
+        lib->addBook(book());
+        for (std::size_t i = 0; i < kCopiesPerThread * kMaxThreads; ++i) {
+            lib->addCopy(Copy{copyId(i), "B0", CopyStatus::IN_LIBRARY}, (i / kCopiesPerThread) % state.threads());
+            lib->addReader(Reader{readerId(i), readerId(i) + "@example.com", {}, {}});
+        }
+    }
+    const std::size_t base = std::size_t(state.thread_index()) * kCopiesPerThread;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const std::size_t k = base + i++ % kCopiesPerThread;
+        benchmark::DoNotOptimize(lib->borrowCopy(copyId(k), readerId(k), kToday));
+        lib->returnCopy(copyId(k), kToday);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace
+
+BENCHMARK(BM_BorrowReturnService)->ThreadRange(1, kMaxThreads)->UseRealTime();
+BENCHMARK(BM_BorrowReturnSharded)->ThreadRange(1, kMaxThreads)->UseRealTime();
@@ -0,0 +1,113 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "library.hpp"
+
+namespace lib {
+
+// Etapa de envío asíncrono: decora otro gateway. sendEmail() sólo encola
+// (cola acotada, varios productores) y uno o más hilos la vacían por lotes
+// hacia el gateway real (una llamada a sendEmails por lote), así devolver
+// un libro no espera a los envíos.
+// Con workers > 1 el gateway interno debe ser seguro entre hilos.
+class AsyncEmailGateway : public NotificationGateway {
+public:
+    // Qué hacer cuando la cola está llena
+    enum class OverflowPolicy {
+        Block,      // backpressure: el productor espera hueco
+        DropNewest, // se descarta el mensaje nuevo
+        DropOldest  // se descarta el más antiguo de la cola
+    };
+
+    struct Options {
+        std::size_t capacity{4096};
+        std::size_t maxBatch{64};
+        unsigned workers{1};
+        OverflowPolicy overflow{OverflowPolicy::Block};
+    };
+
+    struct Stats {
+        std::uint64_t enqueued{0};
+        std::uint64_t sent{0};
+        std::uint64_t dropped{0};
+        std::uint64_t failed{0};  // el gateway interno lanzó excepción
+        std::uint64_t batches{0};
+    };
+
+    explicit AsyncEmailGateway(NotificationGateway& inner);
+    AsyncEmailGateway(NotificationGateway& inner, Options opts);
+    ~AsyncEmailGateway() override; // vacía la cola y detiene los hilos
+
+    AsyncEmailGateway(const AsyncEmailGateway&) = delete;
+    AsyncEmailGateway& operator=(const AsyncEmailGateway&) = delete;
+
+    void sendEmail(const std::string& to, const std::string& subject, const std::string& body) override;
+    // Encola el lote completo con una sola toma del candado
+    void sendEmails(std::span<const EmailView> batch) override;
+
+    // Bloquea hasta que todo lo encolado se haya entregado (tests deterministas)
+    void flush();
+    // Entrega lo pendiente y detiene los hilos; después sendEmail descarta
+    void stop();
+
+    Stats stats() const;
+    std::size_t pending() const;
+
+private:
+    void workerLoop();
+    void enqueueLocked(std::unique_lock<std::mutex>& lk, EmailView msg);
+
+    NotificationGateway& inner;
+    Options opts;
+
+    mutable std::mutex mu;
+    std::condition_variable notEmpty, notFull, idle;
+    std::deque<EmailMessage> queue;
+    std::size_t inFlight{0};
+    bool stopping{false};
+    Stats st;
+    std::vector<std::thread> workers;
+};
+
+// Adaptador de un gateway síncrono (ConsoleEmailGateway, el de los tests o
+// cualquier NotificationGateway) a AsyncNotificationGateway: sendEmailsAsync
+// sólo encola el lote (sin copiarlo: sus vistas valen hasta `done`) y los
+// hilos propios lo entregan con sendEmails y llaman a `done`. Los envíos
+// bloqueantes quedan en esos pocos hilos; quien espera, en una corrutina
+// suspendida. Si el gateway interno lanza, `done(false)`.
+// Con workers > 1 el gateway interno debe ser seguro entre hilos.
+class AsyncGatewayAdapter : public AsyncNotificationGateway {
+public:
+    explicit AsyncGatewayAdapter(NotificationGateway& inner, unsigned workers = 1);
+    ~AsyncGatewayAdapter() override; // entrega lo pendiente y detiene los hilos
+
+    AsyncGatewayAdapter(const AsyncGatewayAdapter&) = delete;
+    AsyncGatewayAdapter& operator=(const AsyncGatewayAdapter&) = delete;
+
+    void sendEmailsAsync(std::span<const EmailView> batch, SendCompletion done) override;
+    // Entrega lo pendiente y detiene los hilos; después cada envío acaba en done(false)
+    void stop();
+    std::size_t pending() const;
+
+private:
+    struct Job {
+        std::span<const EmailView> batch;
+        SendCompletion done;
+    };
+    void workerLoop();
+
+    NotificationGateway& inner;
+    mutable std::mutex mu;
+    std::condition_variable notEmpty;
+    std::deque<Job> queue;
+    std::size_t inFlight{0};
+    bool stopping{false};
+    std::vector<std::thread> workers;
+};
+
+} // namespace lib
@@ -0,0 +1,53 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <unordered_set>
+#include <vector>
+#include "tables.hpp"
+
+namespace lib {
+
+enum class ReaderHandle : Handle;
+
+// Rueda de tiempo de vencimiento de baneos: un hueco por día (módulo kSlots)
+// con los lectores cuyo baneo termina ese día; los baneos más largos que la
+// rueda esperan vueltas en su hueco. Avanzar d días mira min(d, kSlots)
+// huecos, y el conjunto de baneados vivos se mantiene al día, así que
+// listarlos es O(baneados), no O(lectores).
+// No es segura entre hilos por sí sola: la protege LibraryService.
+class BanWheel {
+public:
+    static constexpr std::size_t kSlots = 64;
+
+    struct Entry {
+        ReaderHandle reader;
+        std::chrono::sys_days until; // último día baneado
+    };
+
+    // Registra (o amplía/acorta) el baneo de un lector. La entrada anterior,
+    // si la había, queda obsoleta y se descarta al vencer.
+    void add(ReaderHandle reader, std::chrono::sys_days until);
+
+    // Saca las entradas con until < today (baneos ya cumplidos) hacia `out`.
+    // El llamador decide si siguen vigentes (p.ej. comparando con activeBanUntil)
+    // y llama a release() para quitar al lector del conjunto de baneados.
+    void collectExpired(std::chrono::sys_days today, std::vector<Entry>& out);
+    void release(ReaderHandle reader) { live.erase(reader); }
+
+    bool contains(ReaderHandle reader) const { return live.count(reader) != 0; }
+    std::size_t size() const { return live.size(); }
+    const std::unordered_set<ReaderHandle>& banned() const { return live; }
+    void clear();
+
+private:
+    std::array<std::vector<Entry>, kSlots> slots;
+    std::unordered_set<ReaderHandle> live;
+    std::chrono::sys_days cursor{}; // días < cursor ya procesados
+
+    static std::size_t slotOf(std::chrono::sys_days d) {
+        return static_cast<std::size_t>(d.time_since_epoch().count()) % kSlots;
+    }
+};
+
+} // namespace lib
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "library.hpp"
+
+namespace lib {
+
+// --- Importación masiva del catálogo y de lectores ---
+// Lee CSV de un registro por línea (sin saltos de línea dentro de un campo;
+// las comillas dobles y "" dentro de ellas sí valen):
+//   libros:   id,title,year,authorName,authorBirthDate,edition,isNewRelease(0|1)
+//   lectores: id,email[,activeBanUntil YYYY-MM-DD]
+//   copias:   id,bookId[,status]   (IN_LIBRARY por defecto; nunca LOANED/LATE)
+// El flujo se lee por bloques (memoria acotada); cada bloque se parte en
+// trozos que se analizan en paralelo a vistas sobre el buffer, sin copiar
+// strings, mientras el hilo llamador inserta el bloque anterior. Las tablas
+// se dimensionan con el tamaño del fichero antes de insertar.
+// La integridad se valida en la misma pasada: IDs repetidos y copias de un
+// libro inexistente se rechazan (los libros van antes que las copias). Las
+// copias y los baneos entran ya en sus índices (copiesByBook, bans).
+// Sin servicio activo sobre `db` mientras dura.
+
+enum class ImportTable : std::uint8_t { Books, Readers, Copies };
+
+enum class ImportIssue : std::uint8_t {
+    Malformed,   // columnas de menos/de más o comillas sin cerrar
+    BadNumber,
+    BadDate,
+    BadStatus,
+    DuplicateId,
+    UnknownBook,
+};
+const char* importIssueCode(ImportIssue issue);
+
+struct ImportOptions {
+    unsigned threads{0};               // hilos de análisis; 0 = hardware_concurrency
+    std::size_t blockBytes{4u << 20};  // bytes leídos por bloque
+    std::size_t maxErrors{100};        // errores guardados con detalle (el resto sólo cuenta)
+    bool header{true};                 // la primera línea de cada fuente son los nombres de columna
+};
+
+struct ImportError {
+    ImportTable table;
+    std::size_t line; // 1 = primera línea de la fuente
+    ImportIssue issue;
+};
+
+struct ImportReport {
+    std::size_t books{0}, readers{0}, copies{0}; // registros añadidos
+    std::size_t rejected{0};
+    std::vector<ImportError> errors; // los primeros ImportOptions::maxErrors
+    bool ok() const { return rejected == 0; }
+};
+
+class BulkImporter {
+public:
+    explicit BulkImporter(MemoryDb& db, ImportOptions opts = {});
+
+    // `expected` dimensiona la tabla; con 0 se estima por el tamaño del flujo
+    void importBooks(std::istream& in, std::size_t expected = 0);
+    void importReaders(std::istream& in, std::size_t expected = 0);
+    void importCopies(std::istream& in, std::size_t expected = 0);
+
+    const ImportReport& report() const { return rep; }
+
+private:
+    MemoryDb& db;
+    ImportOptions opts;
+    ImportReport rep;
+
+    template <class Rec, class Parse, class Insert>
+    void run(std::istream& in, ImportTable table, std::size_t expected, Parse parse, Insert insert);
+    void reject(ImportTable table, std::size_t line, ImportIssue issue);
+};
+
+// Libros, lectores y copias desde ficheros, en ese orden. Lanza
+// runtime_error("IMPORT_NOT_FOUND") si no se puede abrir alguno.
+ImportReport importCatalog(MemoryDb& db, const std::string& booksPath, const std::string& readersPath,
+                           const std::string& copiesPath, const ImportOptions& opts = {});
+
+} // namespace lib
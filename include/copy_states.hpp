@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "tables.hpp"
+
+namespace lib {
+
+// TRANSFERRED: la copia se fue a otra sede (ShardedLibrary::transferCopy);
+// su fila se queda para que el historial siga apuntando a ella
+enum class CopyStatus : std::uint8_t { IN_LIBRARY, LOANED, RESERVED, LATE, REPAIR, TRANSFERRED };
+inline constexpr std::size_t kCopyStatusCount = 6;
+
+enum class BookHandle : Handle;
+enum class CopyHandle : Handle;
+
+// Estado de las copias en columnas por CopyHandle (struct-of-arrays): un
+// byte de estado, el handle de su libro y su posición en la lista libre de
+// ese libro. Los IDs y el bookId en texto se quedan en db.copies, que es
+// la parte fría: préstamos, devoluciones y escaneos sólo tocan las columnas.
+// Con un byte por copia, la columna de estados de un millón de copias cabe
+// en la L2 y los recuentos la recorren en bloques que el compilador vectoriza.
+// No es segura entre hilos por sí sola: la mantiene MemoryDb::setCopyStatus.
+class CopyStateTable {
+public:
+    static constexpr std::uint8_t kUntracked = 0xFF; // copia aún sin indexar
+    static constexpr std::uint32_t kNotFree = kNoHandle;
+
+    std::size_t size() const { return states.size(); }
+    bool tracked(CopyHandle h) const {
+        const auto i = static_cast<std::size_t>(h);
+        return i < states.size() && states[i] != kUntracked;
+    }
+    CopyStatus status(CopyHandle h) const { return static_cast<CopyStatus>(states[std::size_t(h)]); }
+    BookHandle book(CopyHandle h) const { return books[std::size_t(h)]; }
+    std::uint32_t freePos(CopyHandle h) const { return freeSlots[std::size_t(h)]; }
+
+    // Indexa la copia con su libro y estado (las columnas crecen si hace falta)
+    void track(CopyHandle h, BookHandle book, CopyStatus s);
+    void setStatus(CopyHandle h, CopyStatus s) { states[std::size_t(h)] = static_cast<std::uint8_t>(s); }
+    void setFreePos(CopyHandle h, std::uint32_t pos) { freeSlots[std::size_t(h)] = pos; }
+
+    void reserve(std::size_t n);
+    void clear();
+
+    // --- Escaneos sobre la columna de estados (sólo copias indexadas) ---
+    std::size_t count(CopyStatus s) const;
+    std::array<std::size_t, kCopyStatusCount> countByStatus() const;
+    // Añade a `out` las copias en `s`, en orden de handle
+    void collect(CopyStatus s, std::vector<CopyHandle>& out) const;
+    std::span<const std::uint8_t> statusColumn() const { return states; }
+
+private:
+    std::vector<std::uint8_t> states;
+    std::vector<BookHandle> books;
+    std::vector<std::uint32_t> freeSlots;
+};
+
+} // namespace lib
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace lib {
+
+// Errores de negocio de LibraryService. errorCode() da el código de texto
+// histórico, que es también el mensaje de las excepciones de la API que lanza.
+enum class LibError : std::uint8_t {
+    None,
+    CopyNotFound,
+    BookNotFound,
+    ReaderNotFound,
+    LoanNotFound,
+    BorrowForbidden,
+    CopyNotAvailable,
+    CopyNotLoaned,
+    NotNewRelease,
+    OriginalAlreadyBorrowed,
+    OriginalNotBorrowed,
+    LoanAlreadyExists,
+    DuplicateInBatch,
+    BatchAborted,
+    AlreadyReserved,
+    ReservationNotFound,
+    WalWriteFailed,     // el log falló antes: no acepta más registros
+    WalRecordTooLarge,  // algún ID no cabe en un registro del log
+};
+inline constexpr std::size_t kLibErrorCount = 18;
+
+constexpr const char* errorCode(LibError e) {
+    switch (e) {
+    case LibError::None:                    return "OK";
+    case LibError::CopyNotFound:            return "COPY_NOT_FOUND";
+    case LibError::BookNotFound:            return "BOOK_NOT_FOUND";
+    case LibError::ReaderNotFound:          return "READER_NOT_FOUND";
+    case LibError::LoanNotFound:            return "LOAN_NOT_FOUND";
+    case LibError::BorrowForbidden:         return "BORROW_FORBIDDEN";
+    case LibError::CopyNotAvailable:        return "COPY_NOT_AVAILABLE";
+    case LibError::CopyNotLoaned:           return "COPY_NOT_LOANED";
+    case LibError::NotNewRelease:           return "NOT_NEW_RELEASE";
+    case LibError::OriginalAlreadyBorrowed: return "ORIGINAL_ALREADY_BORROWED";
+    case LibError::OriginalNotBorrowed:     return "ORIGINAL_NOT_BORROWED";
+    case LibError::LoanAlreadyExists:       return "LOAN_ALREADY_EXISTS";
+    case LibError::DuplicateInBatch:        return "DUPLICATE_IN_BATCH";
+    case LibError::BatchAborted:            return "BATCH_ABORTED";
+    case LibError::AlreadyReserved:         return "ALREADY_RESERVED";
+    case LibError::ReservationNotFound:     return "RESERVATION_NOT_FOUND";
+    case LibError::WalWriteFailed:          return "WAL_WRITE_FAILED";
+    case LibError::WalRecordTooLarge:       return "WAL_RECORD_TOO_LARGE";
+    }
+    return "UNKNOWN";
+}
+
+[[noreturn]] inline void throwError(LibError e) { throw std::runtime_error(errorCode(e)); }
+
+// Lado de error de Expected (como std::unexpected de C++23)
+struct Unexpected {
+    LibError error;
+};
+
+// Resultado al estilo std::expected<T, LibError> (C++23), reducido a lo que
+// usa el servicio. value() sobre un error lanza, como la API clásica.
+template <class T>
+class [[nodiscard]] Expected {
+    T val{};
+    LibError err{LibError::None};
+public:
+    Expected(T v) : val(std::move(v)) {}
+    Expected(Unexpected u) : err(u.error) {}
+
+    bool has_value() const { return err == LibError::None; }
+    explicit operator bool() const { return has_value(); }
+    LibError error() const { return err; }
+
+    T& value() & { if (!has_value()) throwError(err); return val; }
+    const T& value() const& { if (!has_value()) throwError(err); return val; }
+    T&& value() && { if (!has_value()) throwError(err); return std::move(val); }
+
+    // Sin comprobar: sólo tras has_value()
+    T& operator*() { return val; }
+    const T& operator*() const { return val; }
+    T* operator->() { return &val; }
+    const T* operator->() const { return &val; }
+};
+
+template <>
+class [[nodiscard]] Expected<void> {
+    LibError err{LibError::None};
+public:
+    Expected() = default;
+    Expected(Unexpected u) : err(u.error) {}
+
+    bool has_value() const { return err == LibError::None; }
+    explicit operator bool() const { return has_value(); }
+    LibError error() const { return err; }
+    void value() const { if (!has_value()) throwError(err); }
+};
+
+} // namespace lib
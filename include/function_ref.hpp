@@ -0,0 +1,31 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace lib {
+
+// Referencia no propietaria a algo invocable (estilo std::function_ref de C++26):
+// dos punteros, sin heap ni copias del callable. Sólo vale mientras viva el
+// callable, así que se usa para parámetros, no para guardarla.
+template <class Sig> class FunctionRef;
+
+template <class R, class... Args>
+class FunctionRef<R(Args...)> {
+    void* obj;
+    R (*call)(void*, Args...);
+public:
+    template <class F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, FunctionRef>
+                  && std::is_invocable_r_v<R, F&, Args...>)
+    FunctionRef(F&& f) noexcept
+        : obj(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+          call([](void* o, Args... a) -> R {
+              return std::invoke(*static_cast<std::remove_reference_t<F>*>(o), std::forward<Args>(a)...);
+          }) {}
+
+    R operator()(Args... a) const { return call(obj, std::forward<Args>(a)...); }
+};
+
+} // namespace lib
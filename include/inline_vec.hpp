@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+namespace lib {
+
+// Vector de capacidad fija con almacenamiento en línea (sin heap). Pensado
+// para listas cortas con tope conocido, como los préstamos activos de un
+// lector. Sólo tipos triviales (handles): copiar es copiar bytes.
+template <class T, std::size_t N>
+class InlineVec {
+    static_assert(std::is_trivially_copyable_v<T>, "InlineVec guarda tipos triviales");
+    static_assert(N > 0 && N <= 255, "la longitud se guarda en un byte");
+
+    std::array<T, N> items{};
+    std::uint8_t len{0};
+public:
+    using value_type     = T;
+    using iterator       = T*;
+    using const_iterator = const T*;
+
+    InlineVec() = default;
+    InlineVec(std::initializer_list<T> init) {
+        for (const T& v : init) push_back(v);
+    }
+
+    static constexpr std::size_t capacity() { return N; }
+    std::size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    bool full() const { return len == N; }
+
+    T& operator[](std::size_t i) { return items[i]; }
+    const T& operator[](std::size_t i) const { return items[i]; }
+
+    iterator begin() { return items.data(); }
+    iterator end() { return items.data() + len; }
+    const_iterator begin() const { return items.data(); }
+    const_iterator end() const { return items.data() + len; }
+
+    // Pasar del tope es un error de programa (las reglas lo impiden antes)
+    void push_back(const T& v) {
+        if (full()) throw std::length_error("InlineVec::push_back");
+        items[len++] = v;
+    }
+
+    // Quita la primera aparición en su sitio, conservando el orden
+    bool remove(const T& v) {
+        const auto it = std::find(begin(), end(), v);
+        if (it == end()) return false;
+        std::copy(it + 1, end(), it);
+        --len;
+        return true;
+    }
+
+    void clear() { len = 0; }
+
+    friend bool operator==(const InlineVec& a, const InlineVec& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+};
+
+} // namespace lib
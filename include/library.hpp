@@ -2,16 +2,44 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <array>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <atomic>
+#include <string_view>
+#include <span>
 #include <optional>
+#include <variant>
 #include <stdexcept>
-#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <chrono>
 #include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <concepts>
+#include "tables.hpp"
+#include "lock_stripes.hpp"
+#include "function_ref.hpp"
+#include "errors.hpp"
+#include "inline_vec.hpp"
+#include "ban_wheel.hpp"
+#include "loan_archive.hpp"
+#include "copy_states.hpp"
+#include "task.hpp"
 
 namespace lib {
 
-enum class CopyStatus { IN_LIBRARY, LOANED, RESERVED, LATE, REPAIR };
+// Handles internos (posición del registro en su tabla de MemoryDb)
+enum class BookHandle   : Handle {};
+enum class CopyHandle   : Handle {};
+enum class ReaderHandle : Handle {};
+enum class LoanHandle   : Handle {};
+inline constexpr CopyHandle kNoCopy{kNoHandle};
 
 struct Author {
     std::string fullName;
@@ -28,77 +56,464 @@ struct Book {
 };
 
 struct Loan {
-    std::string copyId;     // vacío si es préstamo de “original” (new release sin copias)
-    std::string bookId;
-    std::string readerId;
+    CopyHandle copy{kNoCopy}; // kNoCopy si es préstamo de “original” (new release sin copias)
+    BookHandle book{};
+    ReaderHandle reader{};
     std::chrono::sys_days start;
     std::chrono::sys_days due;
     std::optional<std::chrono::sys_days> returned;
 
     static std::chrono::sys_days addDays(std::chrono::sys_days base, int d);
     long lateDays() const;
+    bool isOriginal() const { return copy == kNoCopy; }
 };
 
 struct Copy {
     std::string id;
     std::string bookId;
+    // El del registro (snapshots, WAL, vistas). En una copia indexada lo
+    // escribe setCopyStatus junto a su columna en MemoryDb::copyStates, que
+    // es la que consulta el servicio.
     CopyStatus status{CopyStatus::IN_LIBRARY};
 };
 
+// Tope de préstamos activos por lector de la política por defecto. La
+// capacidad en línea de Reader::activeLoanIds es el tope más alto que admite
+// una LoanPolicy (el servicio rechaza políticas que no quepan).
+inline constexpr std::size_t kMaxActiveLoans = 3;
+inline constexpr std::size_t kActiveLoansCapacity = 8;
+// Días que una copia devuelta espera apartada (RESERVED) al primero de la
+// cola de reservas de su libro antes de pasar al siguiente
+inline constexpr int kHoldDays = 3;
+using ActiveLoans = InlineVec<LoanHandle, kActiveLoansCapacity>;
+
 struct Reader {
     std::string id;
     std::string email;
     std::optional<std::chrono::sys_days> activeBanUntil;
-    std::vector<std::string> activeLoanIds; // IDs de préstamos activos
+    ActiveLoans activeLoanIds; // préstamos activos (en línea, sin heap)
 
-    bool canBorrow(std::chrono::sys_days today) const;
+    bool isBanned(std::chrono::sys_days today) const;
+    bool canBorrow(std::chrono::sys_days today) const; // con las reglas por defecto
 };
 
 // --- Notificaciones ---
+// Vista no propietaria de un mensaje (lo que recibe el envío por lotes)
+struct EmailView {
+    std::string_view to;
+    std::string_view subject;
+    std::string_view body;
+};
+
+struct EmailMessage {
+    std::string to;
+    std::string subject;
+    std::string body;
+
+    EmailView view() const { return {to, subject, body}; }
+};
+
 struct NotificationGateway {
     virtual ~NotificationGateway() = default;
     virtual void sendEmail(const std::string& to, const std::string& subject, const std::string& body) = 0;
+    // Envío por lotes; por defecto cae en sendEmail por mensaje. Los proveedores
+    // con envío masivo (SMTP pipelining, APIs HTTP bulk) deberían sobrescribirlo.
+    // Las vistas sólo son válidas durante la llamada.
+    virtual void sendEmails(std::span<const EmailView> batch);
 };
 
 struct ConsoleEmailGateway : NotificationGateway {
     void sendEmail(const std::string& to, const std::string& subject, const std::string& body) override;
+    void sendEmails(std::span<const EmailView> batch) override;
+};
+
+// Fin de un envío asíncrono: fn(ctx, ok). Puntero a función + contexto, sin
+// reservar memoria por envío.
+struct SendCompletion {
+    void (*fn)(void* ctx, bool ok);
+    void* ctx;
+    void operator()(bool ok) const { fn(ctx, ok); }
+};
+
+// Gateway de envío no bloqueante: sendEmailsAsync() inicia el envío y vuelve;
+// `done` se llama una sola vez cuando termina, desde cualquier hilo (también
+// dentro de la misma llamada). Las vistas del lote siguen válidas hasta entonces.
+// Para envolver un NotificationGateway síncrono: AsyncGatewayAdapter (async_gateway.hpp).
+struct AsyncNotificationGateway {
+    virtual ~AsyncNotificationGateway() = default;
+    virtual void sendEmailsAsync(std::span<const EmailView> batch, SendCompletion done) = 0;
+};
+
+// co_await sendAsync(gw, lote): suspende sin ocupar hilo hasta que el gateway
+// termina (true si fue bien) y sigue en el hilo que lo completa. Si termina
+// dentro de la llamada, no llega a suspender.
+class SendAwaiter {
+    AsyncNotificationGateway& gw;
+    std::span<const EmailView> batch;
+    std::coroutine_handle<> waiting;
+    std::atomic<bool> finished{false}; // lo pone el primero de await_suspend/complete
+    bool ok{false};
+
+    static void complete(void* ctx, bool ok) {
+        auto* self = static_cast<SendAwaiter*>(ctx);
+        self->ok = ok;
+        if (self->finished.exchange(true, std::memory_order_acq_rel)) self->waiting.resume();
+    }
+public:
+    SendAwaiter(AsyncNotificationGateway& gw, std::span<const EmailView> batch) : gw(gw), batch(batch) {}
+    bool await_ready() const noexcept { return batch.empty(); }
+    bool await_suspend(std::coroutine_handle<> h) {
+        waiting = h;
+        gw.sendEmailsAsync(batch, SendCompletion{&SendAwaiter::complete, this});
+        return !finished.exchange(true, std::memory_order_acq_rel);
+    }
+    bool await_resume() const noexcept { return ok || batch.empty(); }
+};
+inline SendAwaiter sendAsync(AsyncNotificationGateway& gw, std::span<const EmailView> batch) { return {gw, batch}; }
+
+// Cuánto avisa BioAlert por cada devolución. Por defecto (todo a 0/false)
+// avisa a todos los suscriptores y no consume nada.
+struct FanoutPolicy {
+    std::size_t maxPerEvent{0};          // 0 = todos; si no, los N primeros en orden de suscripción
+    bool oneShot{false};                 // avisar consume la suscripción
+    std::uint32_t maxPerReaderPerDay{0}; // 0 = sin límite; quien lo alcanza se salta (sin consumirse)
+
+    bool unlimited() const { return maxPerEvent == 0 && !oneShot && maxPerReaderPerDay == 0; }
 };
 
-// Singleton BioAlert (Observer por libro)
+// BioAlert (Observer por libro); seguro entre hilos. Cada LibraryService
+// usa el suyo (inyectado) o, por defecto, la instancia de proceso getInstance().
+// Los lectores se internan una vez (un handle de 32 bits por lector, no un
+// string por suscripción) y cada libro guarda sus suscriptores en un vector
+// de handles en orden de llegada, inmutable (copy-on-write): subscribe lo
+// reemplaza y notifyAvailable sólo toma una referencia, sin copiarlo. Los
+// libros se reparten en shards con su propio mutex, así libros distintos no
+// compiten. Con una FanoutPolicy acotada cada aviso cuesta O(N + saltados).
 class BioAlert {
-    std::map<std::string, std::set<std::string>> subs; // bookId -> set(readerId)
-    NotificationGateway* gateway{nullptr};
-    BioAlert() = default;
+    using Subscribers = std::shared_ptr<const std::vector<Handle>>; // handles de lector, FIFO
+    struct alignas(64) Shard {
+        std::mutex mu;
+        Table<Subscribers> subs; // bookId -> suscriptores
+        FanoutPolicy policy;     // copia por shard: se lee con el candado que ya se toma
+    };
+    struct RateState {
+        std::chrono::sys_days day{};
+        std::uint32_t sent{0};
+    };
+    std::size_t mask;
+    std::unique_ptr<Shard[]> shards;
+    mutable std::shared_mutex readersMu;
+    Table<std::monostate> readerIds; // readerId <-> handle interno
+    std::mutex rateMu;               // tras el del shard; sólo con maxPerReaderPerDay
+    std::vector<RateState> rate;     // por handle de lector
+    std::atomic<NotificationGateway*> gateway{nullptr};
+    std::atomic<AsyncNotificationGateway*> asyncGateway{nullptr};
+
+    Shard& shardOf(std::string_view bookId) const;
+    Handle internReader(std::string_view readerId);
+    void select(Shard& sh, std::string_view bookId, std::optional<std::chrono::sys_days> day,
+                std::vector<Handle>& out);
 public:
+    // Consultas de datos: devuelven vistas a datos que viven durante la llamada
+    using EmailLookup = FunctionRef<std::string_view(std::string_view readerId)>;
+    using TitleLookup = FunctionRef<std::string_view(std::string_view bookId)>;
+
+    explicit BioAlert(std::size_t shardCount = 16);
+    BioAlert(const BioAlert&) = delete;
+    BioAlert& operator=(const BioAlert&) = delete;
+
     static BioAlert& getInstance();
     void setGateway(NotificationGateway* g);
-    void subscribe(const std::string& bookId, const std::string& readerId);
-    void notifyAvailable(const std::string& bookId,
-                         std::function<std::string(const std::string&)> getEmailByReaderId,
-                         std::function<std::string(const std::string&)> getBookTitleByBookId);
-    // Limpia el estado entre tests (evita punteros colgantes)
+    // Lo usan las variantes *Async; sin él, éstas envían por el síncrono
+    void setAsyncGateway(AsyncNotificationGateway* g);
+    void setPolicy(const FanoutPolicy& p);
+    FanoutPolicy policy() const;
+    void subscribe(std::string_view bookId, std::string_view readerId);
+    // Avisa según la política; `day` es el día del evento (para el límite
+    // por lector). Devuelve cuántos emails se enviaron.
+    std::size_t notifyAvailable(std::string_view bookId, EmailLookup emailByReaderId, TitleLookup titleByBookId,
+                                std::chrono::sys_days day);
+    std::size_t notifyAvailable(std::string_view bookId, EmailLookup emailByReaderId, TitleLookup titleByBookId);
+    std::size_t subscriberCount(std::string_view bookId) const;
+    // Aviso a un solo lector de que tiene una copia apartada hasta `until`
+    // (sin pasar por los suscriptores ni su política). false sin gateway.
+    bool notifyHold(std::string_view email, std::string_view title, std::chrono::sys_days until);
+    // Como notifyAvailable / notifyHold, pero el envío va por el gateway
+    // asíncrono y la tarea no ocupa hilo mientras dura. Las consultas se usan
+    // antes de suspender (las direcciones se copian): basta con que vivan
+    // mientras se espera la tarea en la misma expresión.
+    Task<std::size_t> notifyAvailableAsync(std::string bookId, EmailLookup emailByReaderId,
+                                           TitleLookup titleByBookId, std::chrono::sys_days day);
+    Task<bool> notifyHoldAsync(std::string email, std::string title, std::chrono::sys_days until);
+    // Limpia el estado entre tests (evita punteros colgantes); la política vuelve a la de defecto
     void reset();
+
+private:
+    std::size_t notify(std::string_view bookId, EmailLookup emailByReaderId, TitleLookup titleByBookId,
+                       std::optional<std::chrono::sys_days> day);
+    // Elige a quién avisar según la política y deja sus mensajes en `batch`
+    // (vistas a `subject` y a lo que devuelva emailByReaderId)
+    void collect(std::string_view bookId, EmailLookup emailByReaderId, TitleLookup titleByBookId,
+                 std::optional<std::chrono::sys_days> day, std::string& subject, std::vector<EmailView>& batch);
+};
+
+// --- IDs de préstamo ---
+// Forma numérica compacta; el ID externo es "L" + número (ver formatLoanId).
+using LoanNumber = std::uint64_t;
+
+// Texto de un ID de préstamo en un buffer fijo (sin heap)
+struct LoanIdText {
+    char buf[24];
+    std::uint8_t len{0};
+    std::string_view view() const { return {buf, len}; }
+    operator std::string_view() const { return view(); }
+};
+LoanIdText formatLoanId(LoanNumber n);
+std::optional<LoanNumber> parseLoanId(std::string_view id);
+
+// Asignador monótono y lock-free: nunca reutiliza un número, aunque se
+// archiven o borren préstamos, y es seguro con varios hilos prestando a la vez.
+class LoanIdAllocator {
+    std::atomic<LoanNumber> next{1};
+public:
+    LoanIdAllocator() = default;
+    LoanIdAllocator(const LoanIdAllocator& o) : next(o.peek()) {}
+    LoanIdAllocator& operator=(const LoanIdAllocator& o) { next.store(o.peek()); return *this; }
+
+    LoanNumber allocate() { return next.fetch_add(1, std::memory_order_relaxed); }
+    // Reserva un rango [first, first + n) para repartir por hilo sin contención
+    LoanNumber allocateRange(LoanNumber n) { return next.fetch_add(n, std::memory_order_relaxed); }
+    // Garantiza que los próximos números sean > n (p.ej. tras cargar préstamos existentes)
+    void observe(LoanNumber n);
+    LoanNumber peek() const { return next.load(std::memory_order_relaxed); }
 };
 
 // --- “Repos” en memoria ---
 struct MemoryDb {
-    std::map<std::string, Book> books;
-    std::map<std::string, Copy> copies;
-    std::map<std::string, Reader> readers;
-    std::map<std::string, Loan> loans;
-    std::set<std::string> newReleaseBorrowed; // bookId cuando el “original” está prestado
+    MemoryDb() : MemoryDb(std::pmr::get_default_resource()) {}
+    // `loanArena` sirve la memoria de lo que cambia con cada préstamo: `loans`,
+    // sus índices y newReleaseBorrowed. LibraryService sólo los toca con
+    // loansMu en exclusivo, así que puede ser un recurso no sincronizado
+    // (p.ej. std::pmr::unsynchronized_pool_resource, que recicla los nodos
+    // de los préstamos devueltos). Debe vivir más que la MemoryDb.
+    explicit MemoryDb(std::pmr::memory_resource* loanArena)
+        : loans(loanArena), newReleaseBorrowed(loanArena), openLoanByCopy(loanArena),
+          openOriginalLoan(loanArena), dueIndex(loanArena) {}
+
+    // Las claves string son los IDs externos; cada tabla interna además sus
+    // claves como handles de 32 bits, que es lo que guardan Loan, Reader y los índices.
+    HandleTable<Book, BookHandle> books;
+    HandleTable<Copy, CopyHandle> copies;
+    HandleTable<Reader, ReaderHandle> readers;
+    HandleTable<Loan, LoanHandle> loans;
+    std::pmr::unordered_set<BookHandle> newReleaseBorrowed; // libros cuyo “original” está prestado
+    LoanIdAllocator loanIds;
+
+    // Índices secundarios de préstamos abiertos (los mantiene LibraryService)
+    std::pmr::unordered_map<CopyHandle, LoanHandle> openLoanByCopy;
+    std::pmr::unordered_map<std::uint64_t, LoanHandle> openOriginalLoan; // originalKey(book, reader)
+
+    // Préstamos abiertos por fecha de vencimiento (min-heap). Las entradas de
+    // préstamos ya devueltos no se borran: se descartan al salir del heap.
+    struct DueEntry {
+        std::chrono::sys_days due;
+        LoanHandle loan;
+        bool operator>(const DueEntry& o) const { return due > o.due; }
+    };
+    std::pmr::vector<DueEntry> dueIndex;
+    std::chrono::sys_days overdueScannedTo{}; // vencidos con due < esto ya se emitieron
+    void pushDue(LoanHandle h, std::chrono::sys_days due);
+
+    // Copias de cada libro por estado: las IN_LIBRARY en una lista libre
+    // (alta y baja O(1)) y un contador por estado. Lo mantiene setCopyStatus;
+    // una copia cargada a mano entra con rebuildIndexes o al cambiar de estado.
+    struct BookCopies {
+        std::vector<CopyHandle> free;
+        std::array<std::uint32_t, kCopyStatusCount> byStatus{};
+    };
+    std::unordered_map<BookHandle, BookCopies> copiesByBook;
+    // Por CopyHandle, en columnas: estado con el que está indexada, libro y
+    // posición en `free`
+    CopyStateTable copyStates;
+    // Único punto que cambia Copy::status de una copia indexada (con loansMu
+    // en exclusivo y el candado de la copia)
+    void setCopyStatus(CopyHandle h, CopyStatus s);
+    std::optional<CopyHandle> anyFreeCopy(BookHandle b) const;
+    bool trackCopy(CopyHandle h); // indexa la copia si aún no lo estaba (false si su libro no existe)
+
+    // Préstamos cerrados sacados de `loans` por LibraryService::archiveReturned
+    LoanArchive archive;
+
+    // Lectores con activeBanUntil puesto, por día de fin del baneo (lo
+    // mantiene LibraryService; un baneo puesto a mano entra con rebuildIndexes)
+    BanWheel bans;
+
+    // --- Reservas (las mantiene LibraryService con loansMu en exclusivo) ---
+    // Cola FIFO de lectores por libro. Cancelar sólo invalida el turno; la
+    // entrada se descarta al llegar al frente, así que encolar, cancelar y
+    // sacar al siguiente son O(1) amortizado.
+    struct Turn {
+        ReaderHandle reader;
+        std::uint64_t ticket;
+    };
+    struct ReservationQueue {
+        std::deque<Turn> line;
+        std::size_t live{0}; // turnos vigentes en `line`
+    };
+    std::unordered_map<BookHandle, ReservationQueue> reservations;
+    std::unordered_map<std::uint64_t, std::uint64_t> queuedTurns; // originalKey(libro, lector) -> ticket vigente
+    std::uint64_t nextTicket{0};
+    // Copia apartada (RESERVED) para un lector hasta `until` incluido. Los
+    // apartados no van al WAL ni al snapshot (que la guarda IN_LIBRARY).
+    struct Hold {
+        BookHandle book;
+        ReaderHandle reader;
+        std::chrono::sys_days until;
+    };
+    std::unordered_map<CopyHandle, Hold> holds;
+    std::unordered_map<std::uint64_t, CopyHandle> heldFor; // originalKey(libro, lector) -> copia
+    struct HoldEntry {
+        std::chrono::sys_days until;
+        CopyHandle copy;
+        bool operator>(const HoldEntry& o) const { return until > o.until; }
+    };
+    std::vector<HoldEntry> holdExpiry; // min-heap; las de apartados ya cerrados se saltan
+
+    bool enqueueReservation(BookHandle b, ReaderHandle r); // false si ya tenía turno
+    bool cancelReservation(BookHandle b, ReaderHandle r);  // false si no lo tenía
+    std::optional<ReaderHandle> nextReservation(BookHandle b); // saca al siguiente vigente
+    std::size_t reservationCount(BookHandle b) const;
+    // Sólo los apartados: el estado de la copia lo cambia quien llama
+    void placeHold(CopyHandle c, BookHandle b, ReaderHandle r, std::chrono::sys_days until);
+    std::optional<Hold> releaseHold(CopyHandle c);
+    void clearReservations();
+
+    static std::uint64_t originalKey(BookHandle b, ReaderHandle r) {
+        return (std::uint64_t(b) << 32) | std::uint64_t(r);
+    }
+
+    // Reconstruye los índices desde `loans` y `readers` (p.ej. tras cargar
+    // datos a mano) y adelanta `loanIds` más allá del mayor ID existente
+    void rebuildIndexes();
+    // Verifica que los índices coincidan con `loans` y el estado de las
+    // copias indexadas; O(n), sólo para depuración
+    bool checkIndexes() const;
+    // Verifica que `bans` tenga justo los lectores con activeBanUntil. Lee
+    // todos los lectores: sólo sin operaciones en curso (tests, depuración)
+    bool checkBans() const;
+};
+
+class WriteAheadLog;
+struct WalRecord;
+class ReadViews;
+using WalTicket = std::uint64_t; // posición de un registro en el WAL (0 = sin registro)
+// Mutación registrada (WalRecord::Op); los valores son los del formato del WAL
+enum class LogOp : std::uint8_t { BorrowCopy = 1, BorrowOriginal, ReturnCopy, ReturnOriginal };
+
+// --- Operaciones por lotes ---
+struct BatchItemResult {
+    std::string itemId;
+    std::string loanId;             // préstamo creado o cerrado (vacío si no se aplicó)
+    LibError error{LibError::None}; // el mismo que daría la operación suelta
+    bool ok() const { return error == LibError::None; }
+};
+
+// Todo o nada: si algún ítem falla no se aplica ninguno; los que sí eran
+// válidos llevan BATCH_ABORTED
+struct BatchResult {
+    bool committed{false};
+    std::vector<BatchItemResult> items; // en el orden de entrada
+};
+
+// Préstamo que acaba de vencer (lo emite LibraryService::advanceClock)
+struct OverdueLoan {
+    LoanHandle loan;
+    CopyHandle copy;   // kNoCopy en préstamos del original
+    BookHandle book;
+    ReaderHandle reader;
+    std::chrono::sys_days due;
+};
+
+// --- Reglas de préstamo ---
+// Plazo, tope de préstamos activos y multiplicador de la sanción (días de
+// baneo por día de retraso). Una política es cualquier tipo con estas tres
+// funciones; si son static constexpr, BasicLibraryService las pliega como
+// constantes y el camino caliente no lee nada en ejecución.
+template <class P>
+concept LoanPolicy = std::copy_constructible<P> && requires(const P& p) {
+    { p.loanDays() } -> std::convertible_to<int>;
+    { p.maxActiveLoans() } -> std::convertible_to<std::size_t>;
+    { p.banMultiplier() } -> std::convertible_to<int>;
+};
+
+// 30 días, 3 préstamos, sanción 2x
+struct DefaultLoanPolicy {
+    static constexpr int loanDays() { return 30; }
+    static constexpr std::size_t maxActiveLoans() { return kMaxActiveLoans; }
+    static constexpr int banMultiplier() { return 2; }
+};
+
+// Reglas leídas en ejecución, para sedes que las configuran sin recompilar
+struct RuntimeLoanPolicy {
+    int days{30};
+    std::size_t maxLoans{kMaxActiveLoans};
+    int multiplier{2};
+
+    int loanDays() const { return days; }
+    std::size_t maxActiveLoans() const { return maxLoans; }
+    int banMultiplier() const { return multiplier; }
+
+    // Las reglas de cualquier política, como valores
+    template <LoanPolicy P>
+    static RuntimeLoanPolicy of(const P& p) {
+        return {static_cast<int>(p.loanDays()), static_cast<std::size_t>(p.maxActiveLoans()),
+                static_cast<int>(p.banMultiplier())};
+    }
 };
 
 // --- Servicio principal ---
-class LibraryService {
+// Concurrencia: varios hilos pueden llamar al servicio a la vez (el catálogo
+// -books, copies, readers- no debe cambiar de estructura mientras tanto).
+// Los candados se toman siempre en el mismo orden, lo que evita interbloqueos:
+//   1) itemLocks: por copia (o por libro, en préstamos del original)
+//   2) readerLocks: por lector (hace atómico el tope de 3 y el baneo)
+//   3) loansMu: estructura de `loans`, de los índices y Copy::status, por tramos cortos
+//   4) bansMu: la rueda de baneos, tras el del lector (nunca junto a loansMu)
+//   5) archiveMu: el histórico; se escribe sólo con el servicio detenido
+//   6) el de ReadViews al pasarle una mutación (hoja: tramo corto, sin volver al servicio)
+// Con WAL, cada mutación se anexa al log dentro de su tramo exclusivo de
+// loansMu (el orden del log es el de aplicación) y se espera a que sea
+// durable ya sin candados, así el fsync lo comparten llamadas concurrentes.
+// Las reglas vienen de `Policy` (ver LoanPolicy); LibraryService usa las de
+// defecto y ConfigurableLibraryService las lee en ejecución.
+template <LoanPolicy Policy>
+class BasicLibraryService {
     MemoryDb& db;
+    BioAlert& alerts;
+    WriteAheadLog* wal;
+    ReadViews* views{nullptr};
+    std::function<void(ReaderHandle, std::chrono::sys_days)> banHook;
+    LockStripes itemLocks;
+    LockStripes readerLocks;
+    mutable std::shared_mutex loansMu;
+    mutable std::mutex bansMu;
+    mutable std::shared_mutex archiveMu;
+    [[no_unique_address]] Policy rules;
 public:
-    explicit LibraryService(MemoryDb& db);
+    // Sin BioAlert explícito los avisos van a BioAlert::getInstance()
+    explicit BasicLibraryService(MemoryDb& db, WriteAheadLog* wal = nullptr);
+    BasicLibraryService(MemoryDb& db, BioAlert& alerts, WriteAheadLog* wal = nullptr);
+    // invalid_argument si el tope no cabe en ActiveLoans o el plazo no es positivo
+    BasicLibraryService(MemoryDb& db, BioAlert& alerts, Policy policy, WriteAheadLog* wal = nullptr);
+    ~BasicLibraryService(); // desengancha las vistas, si las hay
+
+    const Policy& policy() const { return rules; }
 
     static std::chrono::sys_days today_utc();
     static std::chrono::sys_days addDays(std::chrono::sys_days base, int d);
 
-    // reglas: 30 días, límite 3, sanción 2x
+    // reglas: las de Policy (por defecto 30 días, límite 3, sanción 2x)
+    // API por IDs externos: resuelve los handles y delega en la versión por handles
     std::string borrowCopy(const std::string& copyId, const std::string& readerId,
                            std::chrono::sys_days today = today_utc());
 
@@ -108,8 +523,213 @@ public:
     void returnCopy(const std::string& copyId, std::chrono::sys_days when = today_utc());
     void returnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
                                   std::chrono::sys_days when = today_utc());
+
+    // Presta una copia IN_LIBRARY cualquiera del libro, en O(1) con
+    // MemoryDb::copiesByBook (COPY_NOT_AVAILABLE si no queda ninguna)
+    std::string borrowAnyCopy(const std::string& bookId, const std::string& readerId,
+                              std::chrono::sys_days today = today_utc());
+
+    // Cambia a mano el estado de una copia que no está prestada (REPAIR,
+    // RESERVED, TRANSFERRED...) pasando por el índice de disponibilidad.
+    // COPY_NOT_AVAILABLE si su estado ya no es `from`. No va al WAL.
+    // Con LOANED/LATE en `from` o `to` lanza invalid_argument: ésos sólo
+    // los ponen préstamos, devoluciones y advanceClock. Sacarla de RESERVED
+    // suelta su apartado; pasarla a IN_LIBRARY sirve antes a la cola de reservas,
+    // con `today` como día del apartado (vence a los kHoldDays) y del aviso.
+    Expected<void> tryChangeCopyStatus(CopyHandle copy, CopyStatus from, CopyStatus to,
+                                       std::chrono::sys_days today = today_utc());
+
+    // --- Reservas ---
+    // Cola por libro en lugar del aviso a todos los suscriptores: al volver
+    // una copia se aparta (RESERVED) en O(1) para el primero de la cola, con
+    // un único email, durante kHoldDays días; si no la recoge, expireHolds
+    // (o advanceClock) la pasa al siguiente. Sin nadie en cola, la copia
+    // vuelve IN_LIBRARY y avisa a los suscriptores de BioAlert como siempre.
+    // Recogerla es borrowCopy/borrowAnyCopy del lector; para los demás la
+    // copia no está disponible. No van al WAL: tras recuperar no hay colas y
+    // las copias apartadas vuelven IN_LIBRARY.
+    // tryReserve aparta ya una copia libre si la hay. BORROW_FORBIDDEN con el
+    // lector baneado; ALREADY_RESERVED si ya tiene turno o una apartada del libro.
+    Expected<void> tryReserve(const std::string& bookId, const std::string& readerId,
+                              std::chrono::sys_days today = today_utc());
+    Expected<void> tryReserve(BookHandle book, ReaderHandle reader, std::chrono::sys_days today = today_utc());
+    void reserve(const std::string& bookId, const std::string& readerId, std::chrono::sys_days today = today_utc());
+    // Sale de la cola o suelta la copia apartada, que pasa al siguiente.
+    // RESERVATION_NOT_FOUND si no tenía ninguna de las dos.
+    Expected<void> tryCancelReservation(const std::string& bookId, const std::string& readerId,
+                                        std::chrono::sys_days today = today_utc());
+    Expected<void> tryCancelReservation(BookHandle book, ReaderHandle reader,
+                                        std::chrono::sys_days today = today_utc());
+    // Pasa al siguiente de la cola los apartados con until < today (o los
+    // devuelve a IN_LIBRARY si no queda nadie). Devuelve cuántos vencieron.
+    std::size_t expireHolds(std::chrono::sys_days today);
+    std::size_t reservationCount(const std::string& bookId) const; // turnos en cola
+    // Lector para el que está apartada la copia (nullopt si no lo está)
+    std::optional<std::string> holdOf(const std::string& copyId) const;
+
+    // Consultas de mostrador/OPAC sobre el índice de disponibilidad
+    std::optional<std::string> findAvailableCopy(const std::string& bookId) const;
+    std::size_t countCopies(const std::string& bookId, CopyStatus status) const;
+    // Recuentos e inventario de todo el fondo sobre MemoryDb::copyStates (sólo
+    // la columna de estados; los IDs se leen para las que coinciden). Cuentan
+    // las copias indexadas, como countCopies.
+    std::array<std::size_t, kCopyStatusCount> countCopiesByStatus() const;
+    std::vector<std::string> copiesInStatus(CopyStatus status) const;
+
+    // API por handles (sin búsquedas por string)
+    LoanHandle borrowCopy(CopyHandle copy, ReaderHandle reader, std::chrono::sys_days today = today_utc());
+    LoanHandle borrowOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                        std::chrono::sys_days today = today_utc());
+    LoanHandle borrowAnyCopy(BookHandle book, ReaderHandle reader, std::chrono::sys_days today = today_utc());
+    void returnCopy(CopyHandle copy, std::chrono::sys_days when = today_utc());
+    void returnOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                  std::chrono::sys_days when = today_utc());
+
+    // API sin excepciones: un rechazo de negocio vuelve como LibError, sin
+    // reservar memoria ni desenrollar la pila. Las variantes que lanzan de
+    // arriba envuelven a éstas (value() lanza runtime_error(errorCode(e))).
+    Expected<std::string> tryBorrowCopy(const std::string& copyId, const std::string& readerId,
+                                        std::chrono::sys_days today = today_utc());
+    Expected<std::string> tryBorrowOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                                      std::chrono::sys_days today = today_utc());
+    Expected<std::string> tryBorrowAnyCopy(const std::string& bookId, const std::string& readerId,
+                                           std::chrono::sys_days today = today_utc());
+    Expected<void> tryReturnCopy(const std::string& copyId, std::chrono::sys_days when = today_utc());
+    Expected<void> tryReturnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                               std::chrono::sys_days when = today_utc());
+
+    Expected<LoanHandle> tryBorrowCopy(CopyHandle copy, ReaderHandle reader,
+                                       std::chrono::sys_days today = today_utc());
+    Expected<LoanHandle> tryBorrowOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                                     std::chrono::sys_days today = today_utc());
+    Expected<LoanHandle> tryBorrowAnyCopy(BookHandle book, ReaderHandle reader,
+                                          std::chrono::sys_days today = today_utc());
+    Expected<void> tryReturnCopy(CopyHandle copy, std::chrono::sys_days when = today_utc());
+    Expected<void> tryReturnOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                               std::chrono::sys_days when = today_utc());
+
+    // Lotes (autopréstamo, buzón de devolución): un lector valida una vez, las
+    // copias se resuelven en una pasada y los avisos de BioAlert se agrupan
+    // por libro. No lanzan por reglas de negocio: el detalle va por ítem.
+    BatchResult borrowBatch(const std::string& readerId, std::span<const std::string> copyIds,
+                            std::chrono::sys_days today = today_utc());
+    BatchResult returnBatch(std::span<const std::string> copyIds, std::chrono::sys_days when = today_utc());
+
+    // API asíncrona (corrutinas C++20), con los mismos resultados que la try*.
+    // Las tareas son diferidas: empiezan en el co_await (o syncWait/spawn) y
+    // la parte con candados corre en ese hilo. Los avisos van por el gateway
+    // asíncrono de BioAlert: mientras se envían la tarea no ocupa ningún hilo
+    // y luego sigue en el que completa el envío. La espera del WAL (fsync)
+    // sigue siendo bloqueante. El servicio debe vivir hasta que terminen.
+    Task<Expected<std::string>> borrowCopyAsync(std::string copyId, std::string readerId,
+                                                std::chrono::sys_days today = today_utc());
+    Task<Expected<std::string>> borrowAnyCopyAsync(std::string bookId, std::string readerId,
+                                                   std::chrono::sys_days today = today_utc());
+    Task<Expected<void>> returnCopyAsync(std::string copyId, std::chrono::sys_days when = today_utc());
+    Task<Expected<void>> returnCopyAsync(CopyHandle copy, std::chrono::sys_days when = today_utc());
+    Task<Expected<void>> returnOriginalNewReleaseAsync(std::string bookId, std::string readerId,
+                                                       std::chrono::sys_days when = today_utc());
+
+    // Avanza el reloj hasta `today`: los préstamos con due < today que aún no
+    // se habían visto vencidos se emiten por `sink` (sin candados tomados) y
+    // su copia pasa a LATE. Cuesta O(k log n) con k = vencidos nuevos, gracias
+    // a MemoryDb::dueIndex. Devuelve k.
+    // LATE es derivado de `due`: no va al WAL ni al snapshot el punto hasta el
+    // que se escaneó, así que tras recuperar los originales vencidos (sin
+    // estado propio) se vuelven a emitir una vez.
+    // También vence los baneos cumplidos (expireBans) y los apartados (expireHolds).
+    std::size_t advanceClock(std::chrono::sys_days today, FunctionRef<void(const OverdueLoan&)> sink);
+
+    // Levanta en bloque los baneos con activeBanUntil < today (el optional se
+    // vacía). Cuesta O(min(días avanzados, BanWheel::kSlots) + vencidos).
+    // Devuelve cuántos lectores quedaron libres.
+    std::size_t expireBans(std::chrono::sys_days today);
+    // Lectores con baneo aún no vencido por el reloj, ordenados; O(baneados)
+    std::vector<ReaderHandle> bannedReaders() const;
+    std::size_t bannedCount() const;
+
+    // Ejecuta fn con el servicio detenido (todos los candados tomados, en el
+    // orden habitual): fn ve un estado consistente de todo MemoryDb
+    void quiesce(FunctionRef<void(const MemoryDb&)> fn);
+    // Mueve a MemoryDb::archive los préstamos devueltos antes de `before`
+    // (con el servicio detenido, como un checkpoint). Devuelve cuántos.
+    std::size_t archiveReturned(std::chrono::sys_days before);
+    // Consultas sobre el histórico; no bloquean préstamos ni devoluciones
+    void queryArchive(FunctionRef<void(const LoanArchive&)> fn) const;
+
+    // Engancha vistas de sólo lectura para informes (ver read_views.hpp): con
+    // el servicio detenido, copia el estado actual como su versión 0 y desde
+    // ahí les pasa cada mutación. nullptr las desengancha. Como mucho unas.
+    // Los cambios hechos a MemoryDb por fuera del servicio no les llegan.
+    void attachViews(ReadViews* views);
+
+    // Llamada en cada baneo nuevo (devolución tardía), con el candado del
+    // lector tomado: sirve para propagarlo fuera del servicio (ShardedLibrary).
+    // Debe ser breve y no volver al servicio; se fija antes de usarlo entre hilos.
+    void setBanHook(std::function<void(ReaderHandle, std::chrono::sys_days until)> hook);
+
+    // Snapshot binario consistente (ver snapshot.hpp)
+    void writeSnapshot(const std::string& path);
+    // Snapshot + vaciado del WAL en el mismo punto (sin WAL equivale a writeSnapshot)
+    void checkpoint(const std::string& snapshotPath);
+
+    // Recuperación: reaplica un registro del WAL, sin volver a registrarlo ni
+    // notificar. Devuelve false si ya estaba aplicado (p.ej. en el snapshot).
+    bool applyLogRecord(const WalRecord& rec);
+
+private:
+    CopyHandle copyHandle(const std::string& copyId) const;
+    BookHandle bookHandle(const std::string& bookId) const;
+    ReaderHandle readerHandle(const std::string& readerId) const;
+    // Núcleo de cada operación. `fixedId` fuerza el ID del préstamo (recuperación);
+    // con `ticket` nulo la mutación no se registra en el WAL.
+    Expected<LoanHandle> borrowCopyImpl(CopyHandle copy, ReaderHandle reader, std::chrono::sys_days today,
+                                        std::string_view fixedId, WalTicket* ticket);
+    Expected<LoanHandle> borrowOriginalImpl(BookHandle book, ReaderHandle reader, std::chrono::sys_days today,
+                                            std::string_view fixedId, WalTicket* ticket);
+    // Lo que deja libre una devolución o un apartado vencido: a quién avisar
+    struct Released {
+        BookHandle book;
+        std::optional<MemoryDb::Hold> hold; // apartada para el siguiente de la cola
+    };
+    Expected<Released> returnCopyImpl(CopyHandle copy, std::chrono::sys_days when, WalTicket* ticket);
+    Expected<void> returnOriginalImpl(BookHandle book, ReaderHandle reader, std::chrono::sys_days when,
+                                      WalTicket* ticket);
+    // Requiere loansMu en exclusivo: las vistas y, con `ticket`, el WAL reciben
+    // la mutación en el orden de aplicación
+    void logMutation(WalTicket* ticket, LogOp op, std::chrono::sys_days day, std::string_view loanId,
+                     std::string_view itemId, std::string_view readerId);
+    // Antes de mutar (con `ticket`): si el WAL rechazaría el registro, el
+    // error, y la operación se descarta sin cambiar nada. Los IDs de préstamo
+    // nuevos los genera el servicio y siempre caben.
+    Expected<void> checkLog(const WalTicket* ticket, std::string_view loanId, std::string_view itemId,
+                            std::string_view readerId) const;
+    void commitLog(WalTicket ticket);
+    void quiesceMutable(FunctionRef<void(MemoryDb&)> fn);
+    LoanHandle insertLoan(Loan&& loan, std::string_view fixedId = {});
+    std::string loanId(LoanHandle h) const;
+    void notifyAvailable(BookHandle book, std::chrono::sys_days day);
+    void notifyReleased(const Released& r, std::chrono::sys_days day);
+    Task<> notifyAvailableAsync(BookHandle book, std::chrono::sys_days day);
+    Task<> notifyReleasedAsync(Released r, std::chrono::sys_days day);
+    // Requieren el candado de la copia y loansMu en exclusivo. holdForNext
+    // aparta la copia (ya IN_LIBRARY o RESERVED) para el siguiente de la cola;
+    // rollOver suelta su apartado y hace lo mismo, o la deja IN_LIBRARY.
+    std::optional<MemoryDb::Hold> holdForNext(CopyHandle copy, BookHandle book, std::chrono::sys_days day);
+    Released rollOver(CopyHandle copy, std::chrono::sys_days day);
+    // Requiere el candado del lector
+    void banReader(ReaderHandle reader, Reader& R, std::chrono::sys_days until);
+    bool mayBorrow(const Reader& r, std::chrono::sys_days today) const {
+        return !r.isBanned(today) && r.activeLoanIds.size() < rules.maxActiveLoans();
+    }
 };
 
+using LibraryService = BasicLibraryService<DefaultLoanPolicy>;
+using ConfigurableLibraryService = BasicLibraryService<RuntimeLoanPolicy>;
+// Instanciadas en library.cpp; otra política: library_service_impl.hpp
+extern template class BasicLibraryService<DefaultLoanPolicy>;
+extern template class BasicLibraryService<RuntimeLoanPolicy>;
+
 // utils
 std::chrono::sys_days makeDate(int y, unsigned m, unsigned d);
 
@@ -0,0 +1,1167 @@
+#pragma once
+// Definiciones de BasicLibraryService. library.cpp instancia DefaultLoanPolicy
+// y RuntimeLoanPolicy; sólo hace falta incluirlo para instanciar una política
+// propia (en un único .cpp: `template class lib::BasicLibraryService<MiPolitica>;`).
+#include "library.hpp"
+#include "snapshot.hpp"
+#include "wal.hpp"
+#include "read_views.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+// Con BIBLIOTECA_CHECK_INDEXES (CMake) cada mutación verifica los índices en builds de depuración.
+// Se invoca con loansMu en exclusivo: todo lo que lee checkIndexes (préstamos,
+// `returned`, índices de abiertos y estado de las copias) sólo cambia bajo ese candado.
+#if defined(LIB_CHECK_INDEXES) && !defined(NDEBUG)
+#define LIB_ASSERT_INDEXES(db) assert((db).checkIndexes())
+#else
+#define LIB_ASSERT_INDEXES(db) ((void)0)
+#endif
+
+namespace lib {
+
+template <LoanPolicy Policy>
+BasicLibraryService<Policy>::BasicLibraryService(MemoryDb& db, WriteAheadLog* wal)
+    : BasicLibraryService(db, BioAlert::getInstance(), wal) {}
+
+template <LoanPolicy Policy>
+BasicLibraryService<Policy>::BasicLibraryService(MemoryDb& db, BioAlert& alerts, WriteAheadLog* wal)
+    : BasicLibraryService(db, alerts, Policy{}, wal) {}
+
+template <LoanPolicy Policy>
+BasicLibraryService<Policy>::BasicLibraryService(MemoryDb& db, BioAlert& alerts, Policy policy, WriteAheadLog* wal)
+    : db(db), alerts(alerts), wal(wal), rules(policy) {
+    // Con una política constexpr esto se resuelve al compilar
+    if (rules.loanDays() < 1 || rules.banMultiplier() < 0)
+        throw std::invalid_argument("LoanPolicy: plazo o multiplicador inválido");
+    if (rules.maxActiveLoans() > ActiveLoans::capacity())
+        throw std::invalid_argument("LoanPolicy: tope mayor que ActiveLoans::capacity()");
+}
+
+template <LoanPolicy Policy>
+BasicLibraryService<Policy>::~BasicLibraryService() {
+    if (views) views->detach();
+}
+
+template <LoanPolicy Policy>
+std::chrono::sys_days BasicLibraryService<Policy>::today_utc() {
+    using namespace std::chrono;
+    const auto now = floor<days>(system_clock::now());
+    return time_point_cast<days>(now);
+}
+template <LoanPolicy Policy>
+std::chrono::sys_days BasicLibraryService<Policy>::addDays(std::chrono::sys_days base, int d) {
+    return base + std::chrono::days(d);
+}
+
+template <LoanPolicy Policy>
+CopyHandle BasicLibraryService<Policy>::copyHandle(const std::string& copyId) const {
+    auto h = db.copies.lookup(copyId);
+    if (!h) throwError(LibError::CopyNotFound);
+    return *h;
+}
+template <LoanPolicy Policy>
+BookHandle BasicLibraryService<Policy>::bookHandle(const std::string& bookId) const {
+    auto h = db.books.lookup(bookId);
+    if (!h) throwError(LibError::BookNotFound);
+    return *h;
+}
+template <LoanPolicy Policy>
+ReaderHandle BasicLibraryService<Policy>::readerHandle(const std::string& readerId) const {
+    auto h = db.readers.lookup(readerId);
+    if (!h) throwError(LibError::ReaderNotFound);
+    return *h;
+}
+
+// --- API que lanza: envuelve a la API sin excepciones ---
+template <LoanPolicy Policy>
+std::string BasicLibraryService<Policy>::borrowCopy(const std::string& copyId, const std::string& readerId,
+                                                    std::chrono::sys_days today) {
+    return tryBorrowCopy(copyId, readerId, today).value();
+}
+
+template <LoanPolicy Policy>
+std::string BasicLibraryService<Policy>::borrowOriginalNewRelease(const std::string& bookId,
+                                                                  const std::string& readerId,
+                                                                  std::chrono::sys_days today) {
+    return tryBorrowOriginalNewRelease(bookId, readerId, today).value();
+}
+
+template <LoanPolicy Policy>
+std::string BasicLibraryService<Policy>::borrowAnyCopy(const std::string& bookId, const std::string& readerId,
+                                                       std::chrono::sys_days today) {
+    return tryBorrowAnyCopy(bookId, readerId, today).value();
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::returnCopy(const std::string& copyId, std::chrono::sys_days when) {
+    tryReturnCopy(copyId, when).value();
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::returnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                                           std::chrono::sys_days when) {
+    tryReturnOriginalNewRelease(bookId, readerId, when).value();
+}
+
+template <LoanPolicy Policy>
+LoanHandle BasicLibraryService<Policy>::borrowCopy(CopyHandle copy, ReaderHandle reader, std::chrono::sys_days today) {
+    return tryBorrowCopy(copy, reader, today).value();
+}
+
+template <LoanPolicy Policy>
+LoanHandle BasicLibraryService<Policy>::borrowOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                                                 std::chrono::sys_days today) {
+    return tryBorrowOriginalNewRelease(book, reader, today).value();
+}
+
+template <LoanPolicy Policy>
+LoanHandle BasicLibraryService<Policy>::borrowAnyCopy(BookHandle book, ReaderHandle reader,
+                                                      std::chrono::sys_days today) {
+    return tryBorrowAnyCopy(book, reader, today).value();
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::returnCopy(CopyHandle copy, std::chrono::sys_days when) {
+    tryReturnCopy(copy, when).value();
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::returnOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                                           std::chrono::sys_days when) {
+    tryReturnOriginalNewRelease(book, reader, when).value();
+}
+
+// --- API sin excepciones por IDs externos ---
+template <LoanPolicy Policy>
+Expected<std::string> BasicLibraryService<Policy>::tryBorrowCopy(const std::string& copyId, const std::string& readerId,
+                                                                 std::chrono::sys_days today) {
+    const auto c = db.copies.lookup(copyId);
+    if (!c) return metrics::rejected(metrics::Op::Borrow, LibError::CopyNotFound);
+    const auto r = db.readers.lookup(readerId);
+    if (!r) return metrics::rejected(metrics::Op::Borrow, LibError::ReaderNotFound);
+    const auto h = tryBorrowCopy(*c, *r, today);
+    if (!h) return Unexpected{h.error()};
+    return loanId(*h);
+}
+
+template <LoanPolicy Policy>
+Expected<std::string> BasicLibraryService<Policy>::tryBorrowOriginalNewRelease(const std::string& bookId,
+                                                                               const std::string& readerId,
+                                                                               std::chrono::sys_days today) {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return metrics::rejected(metrics::Op::Borrow, LibError::BookNotFound);
+    const auto r = db.readers.lookup(readerId);
+    if (!r) return metrics::rejected(metrics::Op::Borrow, LibError::ReaderNotFound);
+    const auto h = tryBorrowOriginalNewRelease(*b, *r, today);
+    if (!h) return Unexpected{h.error()};
+    return loanId(*h);
+}
+
+template <LoanPolicy Policy>
+Expected<std::string> BasicLibraryService<Policy>::tryBorrowAnyCopy(const std::string& bookId,
+                                                                    const std::string& readerId,
+                                                                    std::chrono::sys_days today) {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return metrics::rejected(metrics::Op::Borrow, LibError::BookNotFound);
+    const auto r = db.readers.lookup(readerId);
+    if (!r) return metrics::rejected(metrics::Op::Borrow, LibError::ReaderNotFound);
+    const auto h = tryBorrowAnyCopy(*b, *r, today);
+    if (!h) return Unexpected{h.error()};
+    return loanId(*h);
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryReturnCopy(const std::string& copyId, std::chrono::sys_days when) {
+    const auto c = db.copies.lookup(copyId);
+    if (!c) return metrics::rejected(metrics::Op::Return, LibError::CopyNotFound);
+    return tryReturnCopy(*c, when);
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryReturnOriginalNewRelease(const std::string& bookId,
+                                                                        const std::string& readerId,
+                                                                        std::chrono::sys_days when) {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return metrics::rejected(metrics::Op::Return, LibError::BookNotFound);
+    const auto r = db.readers.lookup(readerId);
+    if (!r) return metrics::rejected(metrics::Op::Return, LibError::ReaderNotFound);
+    return tryReturnOriginalNewRelease(*b, *r, when);
+}
+
+// --- API sin excepciones por handles ---
+// Aquí se miden las operaciones sueltas (con la espera del WAL y los avisos);
+// los rechazos de las búsquedas por ID se apuntan arriba
+template <LoanPolicy Policy>
+Expected<LoanHandle> BasicLibraryService<Policy>::tryBorrowCopy(CopyHandle copy, ReaderHandle reader,
+                                                                std::chrono::sys_days today) {
+    metrics::ScopedLatency timer(metrics::Op::Borrow);
+    WalTicket ticket = 0;
+    const auto h = borrowCopyImpl(copy, reader, today, {}, &ticket);
+    commitLog(ticket);
+    if (!h) metrics::recordRejection(metrics::Op::Borrow, h.error());
+    return h;
+}
+
+template <LoanPolicy Policy>
+Expected<LoanHandle> BasicLibraryService<Policy>::tryBorrowOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                                                              std::chrono::sys_days today) {
+    metrics::ScopedLatency timer(metrics::Op::Borrow);
+    WalTicket ticket = 0;
+    const auto h = borrowOriginalImpl(book, reader, today, {}, &ticket);
+    commitLog(ticket);
+    if (!h) metrics::recordRejection(metrics::Op::Borrow, h.error());
+    return h;
+}
+
+template <LoanPolicy Policy>
+Expected<LoanHandle> BasicLibraryService<Policy>::tryBorrowAnyCopy(BookHandle book, ReaderHandle reader,
+                                                                   std::chrono::sys_days today) {
+    metrics::ScopedLatency timer(metrics::Op::Borrow);
+    for (;;) {
+        std::optional<CopyHandle> copy;
+        {
+            std::shared_lock lk(loansMu);
+            // La que tenga apartada, antes que una libre
+            auto held = db.heldFor.find(MemoryDb::originalKey(book, reader));
+            copy = held != db.heldFor.end() ? std::optional(held->second) : db.anyFreeCopy(book);
+        }
+        if (!copy) return metrics::rejected(metrics::Op::Borrow, LibError::CopyNotAvailable);
+        WalTicket ticket = 0;
+        const auto h = borrowCopyImpl(*copy, reader, today, {}, &ticket);
+        if (h || h.error() != LibError::CopyNotAvailable) {
+            commitLog(ticket);
+            if (!h) metrics::recordRejection(metrics::Op::Borrow, h.error());
+            return h;
+        }
+        // Otro hilo se la llevó (y ya salió de la lista) o su estado cambió a
+        // mano sin pasar por el índice: se corrige y se prueba con otra
+        std::lock_guard itemLk(itemLocks.at(Handle(*copy)));
+        std::unique_lock lk(loansMu);
+        if (db.copies[*copy].status != CopyStatus::RESERVED) db.releaseHold(*copy);
+        db.setCopyStatus(*copy, db.copies[*copy].status);
+    }
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryReturnCopy(CopyHandle copy, std::chrono::sys_days when) {
+    metrics::ScopedLatency timer(metrics::Op::Return);
+    WalTicket ticket = 0;
+    const auto released = returnCopyImpl(copy, when, &ticket);
+    if (!released) return metrics::rejected(metrics::Op::Return, released.error());
+    commitLog(ticket);
+    notifyReleased(*released, when);
+    return {};
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryReturnOriginalNewRelease(BookHandle book, ReaderHandle reader,
+                                                                        std::chrono::sys_days when) {
+    metrics::ScopedLatency timer(metrics::Op::Return);
+    WalTicket ticket = 0;
+    const auto done = returnOriginalImpl(book, reader, when, &ticket);
+    if (!done) return metrics::rejected(metrics::Op::Return, done.error());
+    commitLog(ticket);
+    notifyAvailable(book, when);
+    return {};
+}
+
+template <LoanPolicy Policy>
+Expected<LoanHandle> BasicLibraryService<Policy>::borrowCopyImpl(CopyHandle copy, ReaderHandle reader,
+                                                                 std::chrono::sys_days today,
+                                                                 std::string_view fixedId, WalTicket* ticket) {
+    std::lock_guard itemLk(itemLocks.at(Handle(copy)));
+    std::lock_guard readerLk(readerLocks.at(Handle(reader)));
+    auto& c = db.copies[copy];
+    auto& r = db.readers[reader];
+
+    if (!mayBorrow(r, today)) return Unexpected{LibError::BorrowForbidden};
+    // Una copia RESERVED sólo se la lleva el lector para el que está apartada.
+    // Sin apartado (importada, de un snapshot anterior a las reservas o en la
+    // réplica de las vistas) RESERVED no la guarda para nadie: se presta como
+    // IN_LIBRARY.
+    bool pickup = false;
+    if (c.status == CopyStatus::RESERVED) {
+        std::shared_lock lk(loansMu);
+        auto held = db.holds.find(copy);
+        if (held != db.holds.end() && held->second.reader != reader) return Unexpected{LibError::CopyNotAvailable};
+        pickup = held != db.holds.end();
+    } else if (c.status != CopyStatus::IN_LIBRARY) {
+        return Unexpected{LibError::CopyNotAvailable};
+    }
+    const auto book = db.books.lookup(c.bookId);
+    if (!book) return Unexpected{LibError::BookNotFound};
+    if (auto ok = checkLog(ticket, {}, db.copies.idOf(copy), db.readers.idOf(reader)); !ok)
+        return Unexpected{ok.error()};
+
+    LoanHandle h;
+    {
+        std::unique_lock lk(loansMu);
+        h = insertLoan(Loan{copy, *book, reader, today, addDays(today, rules.loanDays()), std::nullopt}, fixedId);
+        db.openLoanByCopy[copy] = h;
+        if (pickup) {
+            // Para las vistas (y su réplica, sin apartados) se presta desde IN_LIBRARY
+            db.releaseHold(copy);
+            if (views) views->statusChanged(db.copies.idOf(copy), CopyStatus::IN_LIBRARY);
+        }
+        db.setCopyStatus(copy, CopyStatus::LOANED);
+        LIB_ASSERT_INDEXES(db);
+        logMutation(ticket, LogOp::BorrowCopy, today, db.loans.idOf(h), db.copies.idOf(copy),
+                    db.readers.idOf(reader));
+    }
+
+    r.activeLoanIds.push_back(h);
+    return h;
+}
+
+template <LoanPolicy Policy>
+Expected<LoanHandle> BasicLibraryService<Policy>::borrowOriginalImpl(BookHandle book, ReaderHandle reader,
+                                                                     std::chrono::sys_days today,
+                                                                     std::string_view fixedId, WalTicket* ticket) {
+    std::lock_guard itemLk(itemLocks.at(Handle(book)));
+    std::lock_guard readerLk(readerLocks.at(Handle(reader)));
+    auto& b = db.books[book];
+    auto& r = db.readers[reader];
+
+    if (!b.isNewRelease) return Unexpected{LibError::NotNewRelease};
+    if (!mayBorrow(r, today)) return Unexpected{LibError::BorrowForbidden};
+    if (auto ok = checkLog(ticket, {}, db.books.idOf(book), db.readers.idOf(reader)); !ok)
+        return Unexpected{ok.error()};
+
+    LoanHandle h;
+    {
+        std::unique_lock lk(loansMu);
+        if (db.newReleaseBorrowed.count(book)) return Unexpected{LibError::OriginalAlreadyBorrowed};
+        // kNoCopy: sin copia física
+        h = insertLoan(Loan{kNoCopy, book, reader, today, addDays(today, rules.loanDays()), std::nullopt}, fixedId);
+        db.openOriginalLoan[MemoryDb::originalKey(book, reader)] = h;
+        db.newReleaseBorrowed.insert(book);
+        LIB_ASSERT_INDEXES(db);
+        logMutation(ticket, LogOp::BorrowOriginal, today, db.loans.idOf(h), db.books.idOf(book),
+                    db.readers.idOf(reader));
+    }
+
+    r.activeLoanIds.push_back(h);
+    return h;
+}
+
+template <LoanPolicy Policy>
+auto BasicLibraryService<Policy>::returnCopyImpl(CopyHandle copy, std::chrono::sys_days when, WalTicket* ticket)
+    -> Expected<Released> {
+    std::lock_guard itemLk(itemLocks.at(Handle(copy)));
+    auto& c = db.copies[copy];
+    if (c.status != CopyStatus::LOANED && c.status != CopyStatus::LATE) {
+        return Unexpected{LibError::CopyNotLoaned};
+    }
+
+    // Con el candado de la copia tomado nadie más puede abrir/cerrar su préstamo
+    LoanHandle loanH;
+    Loan* loan;
+    {
+        std::shared_lock lk(loansMu);
+        auto open = db.openLoanByCopy.find(copy);
+        if (open == db.openLoanByCopy.end()) return Unexpected{LibError::LoanNotFound};
+        loanH = open->second;
+        loan = &db.loans[loanH];
+    }
+    auto& L = *loan;
+
+    std::lock_guard readerLk(readerLocks.at(Handle(L.reader)));
+    auto& R = db.readers[L.reader];
+    if (auto ok = checkLog(ticket, db.loans.idOf(loanH), db.copies.idOf(copy), {}); !ok)
+        return Unexpected{ok.error()};
+
+    Released released{L.book, std::nullopt};
+    {
+        std::unique_lock lk(loansMu);
+        L.returned = when;
+        db.openLoanByCopy.erase(copy);
+        db.setCopyStatus(copy, CopyStatus::IN_LIBRARY);
+        logMutation(ticket, LogOp::ReturnCopy, when, db.loans.idOf(loanH), db.copies.idOf(copy), {});
+        released.hold = holdForNext(copy, L.book, when);
+        LIB_ASSERT_INDEXES(db);
+    }
+    const long late = L.lateDays();
+    if (late > 0) {
+        banReader(L.reader, R, when + std::chrono::days(late * rules.banMultiplier()));
+    }
+
+    R.activeLoanIds.remove(loanH);
+    return released;
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::returnOriginalImpl(BookHandle book, ReaderHandle reader,
+                                                               std::chrono::sys_days when, WalTicket* ticket) {
+    std::lock_guard itemLk(itemLocks.at(Handle(book)));
+    std::lock_guard readerLk(readerLocks.at(Handle(reader)));
+
+    LoanHandle loanH;
+    Loan* loan;
+    {
+        std::shared_lock lk(loansMu);
+        if (!db.newReleaseBorrowed.count(book)) return Unexpected{LibError::OriginalNotBorrowed};
+        auto open = db.openOriginalLoan.find(MemoryDb::originalKey(book, reader));
+        if (open == db.openOriginalLoan.end()) return Unexpected{LibError::LoanNotFound};
+        loanH = open->second;
+        loan = &db.loans[loanH];
+    }
+    auto& L = *loan;
+    auto& R = db.readers[reader];
+    if (auto ok = checkLog(ticket, db.loans.idOf(loanH), db.books.idOf(book), db.readers.idOf(reader)); !ok)
+        return Unexpected{ok.error()};
+    {
+        std::unique_lock lk(loansMu);
+        L.returned = when;
+        db.newReleaseBorrowed.erase(book);
+        db.openOriginalLoan.erase(MemoryDb::originalKey(book, reader));
+        LIB_ASSERT_INDEXES(db);
+        logMutation(ticket, LogOp::ReturnOriginal, when, db.loans.idOf(loanH), db.books.idOf(book),
+                    db.readers.idOf(reader));
+    }
+    const long late = L.lateDays();
+    if (late > 0) banReader(reader, R, when + std::chrono::days(late * rules.banMultiplier()));
+
+    R.activeLoanIds.remove(loanH);
+    return {};
+}
+
+// --- Lotes ---
+namespace detail {
+
+// Resuelve las copias del lote en una pasada; marca desconocidas y repetidas
+inline bool resolveBatchCopies(const MemoryDb& db, std::span<const std::string> copyIds, BatchResult& res,
+                               std::vector<CopyHandle>& copies, std::vector<std::uint32_t>& keys) {
+    bool ok = true;
+    res.items.resize(copyIds.size());
+    copies.assign(copyIds.size(), kNoCopy);
+    keys.reserve(copyIds.size());
+    for (std::size_t i = 0; i < copyIds.size(); ++i) {
+        res.items[i].itemId = copyIds[i];
+        const auto h = db.copies.lookup(copyIds[i]);
+        if (!h) { res.items[i].error = LibError::CopyNotFound; ok = false; continue; }
+        if (std::find(copies.begin(), copies.begin() + i, *h) != copies.begin() + i) {
+            res.items[i].error = LibError::DuplicateInBatch; ok = false; continue;
+        }
+        copies[i] = *h;
+        keys.push_back(Handle(*h));
+    }
+    return ok;
+}
+
+inline void abortBatch(BatchResult& res) {
+    for (auto& it : res.items) {
+        it.loanId.clear();
+        if (it.ok()) it.error = LibError::BatchAborted;
+    }
+}
+
+} // namespace detail
+
+template <LoanPolicy Policy>
+BatchResult BasicLibraryService<Policy>::borrowBatch(const std::string& readerId, std::span<const std::string> copyIds,
+                                                     std::chrono::sys_days today) {
+    BatchResult res;
+    std::vector<CopyHandle> copies;
+    std::vector<std::uint32_t> keys;
+    bool ok = detail::resolveBatchCopies(db, copyIds, res, copies, keys);
+    const auto reader = db.readers.lookup(readerId);
+    if (!reader) {
+        for (auto& it : res.items) it.error = LibError::ReaderNotFound;
+        return res;
+    }
+    if (!ok) { detail::abortBatch(res); return res; }
+
+    WalTicket ticket = 0;
+    {
+        MultiLock itemLk(itemLocks, keys);
+        std::lock_guard readerLk(readerLocks.at(Handle(*reader)));
+        auto& r = db.readers[*reader];
+
+        // Validación completa antes de tocar nada
+        const bool banned = r.isBanned(today);
+        const std::size_t limit = rules.maxActiveLoans();
+        std::size_t room = limit - std::min(r.activeLoanIds.size(), limit);
+        std::vector<BookHandle> books(copies.size());
+        for (std::size_t i = 0; i < copies.size(); ++i) {
+            const auto& c = db.copies[copies[i]];
+            const auto b = db.books.lookup(c.bookId);
+            LibError& err = res.items[i].error;
+            if (banned) err = LibError::BorrowForbidden;
+            else if (c.status != CopyStatus::IN_LIBRARY) err = LibError::CopyNotAvailable;
+            else if (!b) err = LibError::BookNotFound;
+            else if (room == 0) err = LibError::BorrowForbidden; // superaría el tope
+            else if (auto logOk = checkLog(&ticket, {}, copyIds[i], readerId); !logOk) err = logOk.error();
+            else { --room; books[i] = *b; continue; }
+            ok = false;
+        }
+        if (!ok) { detail::abortBatch(res); return res; }
+
+        std::vector<LoanHandle> loans(copies.size());
+        {
+            std::unique_lock lk(loansMu);
+            for (std::size_t i = 0; i < copies.size(); ++i) {
+                loans[i] = insertLoan(
+                    Loan{copies[i], books[i], *reader, today, addDays(today, rules.loanDays()), std::nullopt});
+                db.openLoanByCopy[copies[i]] = loans[i];
+                db.setCopyStatus(copies[i], CopyStatus::LOANED);
+                res.items[i].loanId = db.loans.idOf(loans[i]);
+                logMutation(&ticket, LogOp::BorrowCopy, today, res.items[i].loanId, copyIds[i], readerId);
+            }
+            LIB_ASSERT_INDEXES(db);
+        }
+        for (LoanHandle h : loans) r.activeLoanIds.push_back(h);
+        res.committed = true;
+    }
+    commitLog(ticket);
+    return res;
+}
+
+template <LoanPolicy Policy>
+BatchResult BasicLibraryService<Policy>::returnBatch(std::span<const std::string> copyIds, std::chrono::sys_days when) {
+    BatchResult res;
+    std::vector<CopyHandle> copies;
+    std::vector<std::uint32_t> keys;
+    if (!detail::resolveBatchCopies(db, copyIds, res, copies, keys)) { detail::abortBatch(res); return res; }
+
+    WalTicket ticket = 0;
+    std::vector<BookHandle> books; // distintos, para avisar una vez por libro
+    std::vector<MemoryDb::Hold> held; // apartadas para la cola: un aviso a cada uno
+    {
+        MultiLock itemLk(itemLocks, keys);
+
+        // Con los candados de las copias nadie más abre/cierra sus préstamos
+        std::vector<LoanHandle> loanHs(copies.size());
+        std::vector<Loan*> loans(copies.size(), nullptr);
+        bool ok = true;
+        {
+            std::shared_lock lk(loansMu);
+            for (std::size_t i = 0; i < copies.size(); ++i) {
+                const auto& c = db.copies[copies[i]];
+                if (c.status != CopyStatus::LOANED && c.status != CopyStatus::LATE) {
+                    res.items[i].error = LibError::CopyNotLoaned; ok = false; continue;
+                }
+                auto open = db.openLoanByCopy.find(copies[i]);
+                if (open == db.openLoanByCopy.end()) {
+                    res.items[i].error = LibError::LoanNotFound; ok = false; continue;
+                }
+                if (auto logOk = checkLog(&ticket, db.loans.idOf(open->second), copyIds[i], {}); !logOk) {
+                    res.items[i].error = logOk.error(); ok = false; continue;
+                }
+                loanHs[i] = open->second;
+                loans[i] = &db.loans[open->second];
+            }
+        }
+        if (!ok) { detail::abortBatch(res); return res; }
+
+        keys.clear();
+        for (auto* L : loans) keys.push_back(Handle(L->reader));
+        MultiLock readerLk(readerLocks, keys);
+
+        std::vector<bool> isHeld(copies.size(), false);
+        {
+            std::unique_lock lk(loansMu);
+            for (std::size_t i = 0; i < copies.size(); ++i) {
+                loans[i]->returned = when;
+                db.openLoanByCopy.erase(copies[i]);
+                db.setCopyStatus(copies[i], CopyStatus::IN_LIBRARY);
+                res.items[i].loanId = db.loans.idOf(loanHs[i]);
+                logMutation(&ticket, LogOp::ReturnCopy, when, res.items[i].loanId, copyIds[i], {});
+                if (auto h = holdForNext(copies[i], loans[i]->book, when)) {
+                    held.push_back(*h);
+                    isHeld[i] = true;
+                }
+            }
+            LIB_ASSERT_INDEXES(db);
+        }
+        // Mismo efecto que devolverlas una a una en el orden del lote
+        for (std::size_t i = 0; i < copies.size(); ++i) {
+            const Loan& L = *loans[i];
+            auto& R = db.readers[L.reader];
+            if (const long late = L.lateDays(); late > 0)
+                banReader(L.reader, R, when + std::chrono::days(late * rules.banMultiplier()));
+            R.activeLoanIds.remove(loanHs[i]);
+            if (!isHeld[i] && std::find(books.begin(), books.end(), L.book) == books.end()) books.push_back(L.book);
+        }
+        res.committed = true;
+    }
+    commitLog(ticket);
+    for (const MemoryDb::Hold& h : held) notifyReleased({h.book, h}, when);
+    for (BookHandle b : books) notifyAvailable(b, when);
+    return res;
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::logMutation(WalTicket* ticket, LogOp op, std::chrono::sys_days day,
+                                              std::string_view loanId, std::string_view itemId,
+                                              std::string_view readerId) {
+    if (views) views->logged(op, day, loanId, itemId, readerId);
+    if (wal && ticket) *ticket = wal->append(op, day, loanId, itemId, readerId);
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::checkLog(const WalTicket* ticket, std::string_view loanId,
+                                                     std::string_view itemId, std::string_view readerId) const {
+    if (!wal || !ticket) return {};
+    return wal->check(loanId, itemId, readerId);
+}
+
+// Sin candados: aquí es donde se agrupan los fsync de llamadas concurrentes
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::commitLog(WalTicket ticket) {
+    if (wal && ticket) wal->commit(ticket);
+}
+
+template <LoanPolicy Policy>
+bool BasicLibraryService<Policy>::applyLogRecord(const WalRecord& rec) {
+    switch (rec.op) {
+    case WalRecord::Op::BorrowCopy:
+        if (db.loans.contains(rec.loanId) || db.archive.contains(rec.loanId)) return false;
+        borrowCopyImpl(copyHandle(rec.itemId), readerHandle(rec.readerId), rec.day, rec.loanId, nullptr).value();
+        return true;
+    case WalRecord::Op::BorrowOriginal:
+        if (db.loans.contains(rec.loanId) || db.archive.contains(rec.loanId)) return false;
+        borrowOriginalImpl(bookHandle(rec.itemId), readerHandle(rec.readerId), rec.day, rec.loanId, nullptr)
+            .value();
+        return true;
+    case WalRecord::Op::ReturnCopy:
+    case WalRecord::Op::ReturnOriginal: {
+        const auto h = db.loans.lookup(rec.loanId);
+        if (!h && db.archive.contains(rec.loanId)) return false; // devuelto y ya archivado
+        if (!h) throwError(LibError::LoanNotFound);
+        if (db.loans[*h].returned) return false;
+        if (rec.op == WalRecord::Op::ReturnCopy) returnCopyImpl(copyHandle(rec.itemId), rec.day, nullptr).value();
+        else returnOriginalImpl(bookHandle(rec.itemId), readerHandle(rec.readerId), rec.day, nullptr).value();
+        return true;
+    }
+    }
+    return false;
+}
+
+// Requiere loansMu en exclusivo. También lo indexa por vencimiento. El Loan
+// se construye directamente en la tabla (try_emplace no lo toca si la clave ya existe).
+template <LoanPolicy Policy>
+LoanHandle BasicLibraryService<Policy>::insertLoan(Loan&& loan, std::string_view fixedId) {
+    const auto due = loan.due;
+    LoanHandle h;
+    if (!fixedId.empty()) {
+        auto [added, inserted] = db.loans.add(fixedId, std::move(loan));
+        if (!inserted) throwError(LibError::LoanAlreadyExists);
+        if (auto n = parseLoanId(fixedId)) db.loanIds.observe(*n);
+        h = added;
+    } else {
+        // Un ID cargado a mano podría coincidir con el siguiente número: se salta
+        for (;;) {
+            auto [added, inserted] = db.loans.add(formatLoanId(db.loanIds.allocate()), std::move(loan));
+            if (inserted) { h = added; break; }
+        }
+    }
+    db.pushDue(h, due);
+    return h;
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::banReader(ReaderHandle reader, Reader& R, std::chrono::sys_days until) {
+    R.activeBanUntil = until;
+    if (banHook) banHook(reader, until);
+    std::lock_guard lk(bansMu);
+    db.bans.add(reader, until);
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::setBanHook(std::function<void(ReaderHandle, std::chrono::sys_days)> hook) {
+    banHook = std::move(hook);
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::expireBans(std::chrono::sys_days today) {
+    std::vector<BanWheel::Entry> expired;
+    {
+        std::lock_guard lk(bansMu);
+        db.bans.collectExpired(today, expired);
+    }
+    // Con el candado del lector: si el baneo cambió desde que se registró esta
+    // entrada (otra devolución tardía) la entrada está obsoleta y se ignora
+    std::size_t lifted = 0;
+    for (const BanWheel::Entry& e : expired) {
+        std::lock_guard readerLk(readerLocks.at(Handle(e.reader)));
+        auto& R = db.readers[e.reader];
+        if (R.activeBanUntil != e.until) continue;
+        R.activeBanUntil.reset();
+        if (views) views->banLifted(db.readers.idOf(e.reader), e.until);
+        std::lock_guard lk(bansMu);
+        db.bans.release(e.reader);
+        ++lifted;
+    }
+    return lifted;
+}
+
+template <LoanPolicy Policy>
+std::vector<ReaderHandle> BasicLibraryService<Policy>::bannedReaders() const {
+    std::vector<ReaderHandle> out;
+    {
+        std::lock_guard lk(bansMu);
+        out.assign(db.bans.banned().begin(), db.bans.banned().end());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::bannedCount() const {
+    std::lock_guard lk(bansMu);
+    return db.bans.size();
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::advanceClock(std::chrono::sys_days today,
+                                                     FunctionRef<void(const OverdueLoan&)> sink) {
+    expireBans(today);
+    expireHolds(today);
+    // 1) Sacar del heap lo vencido; sólo se miran k entradas (más las obsoletas)
+    std::vector<OverdueLoan> due;
+    {
+        std::unique_lock lk(loansMu);
+        db.overdueScannedTo = std::max(db.overdueScannedTo, today);
+        auto& heap = db.dueIndex;
+        while (!heap.empty() && heap.front().due < today) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            const MemoryDb::DueEntry e = heap.back();
+            heap.pop_back();
+            const Loan& L = db.loans[e.loan];
+            if (L.returned || L.due != e.due) continue; // devuelto (o handle reutilizado)
+            due.push_back({e.loan, L.copy, L.book, L.reader, L.due});
+        }
+    }
+    // Un handle reutilizado con el mismo vencimiento dejaría dos entradas
+    std::sort(due.begin(), due.end(), [](auto& a, auto& b) { return a.loan < b.loan; });
+    due.erase(std::unique(due.begin(), due.end(), [](auto& a, auto& b) { return a.loan == b.loan; }), due.end());
+
+    // 2) Marcar LATE con el orden habitual (copia y luego loansMu); un préstamo
+    //    devuelto entre 1) y 2) ya no es el abierto de su copia y se salta
+    std::size_t kept = 0;
+    for (const OverdueLoan& o : due) {
+        if (o.copy != kNoCopy) {
+            std::lock_guard itemLk(itemLocks.at(Handle(o.copy)));
+            std::unique_lock lk(loansMu);
+            auto open = db.openLoanByCopy.find(o.copy);
+            if (open == db.openLoanByCopy.end() || open->second != o.loan) continue;
+            if (db.loans[o.loan].due != o.due) continue; // handle reutilizado tras archivar
+            if (db.copies[o.copy].status != CopyStatus::LOANED) continue;
+            db.setCopyStatus(o.copy, CopyStatus::LATE);
+            if (views) views->markedLate(db.copies.idOf(o.copy));
+        }
+        due[kept++] = o;
+    }
+    due.resize(kept);
+
+    // 3) Emitir sin candados
+    std::sort(due.begin(), due.end(), [](auto& a, auto& b) { return a.due < b.due; });
+    for (const OverdueLoan& o : due) sink(o);
+    return due.size();
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::quiesce(FunctionRef<void(const MemoryDb&)> fn) {
+    quiesceMutable([&](MemoryDb& d) { fn(d); });
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::quiesceMutable(FunctionRef<void(MemoryDb&)> fn) {
+    std::vector<std::unique_lock<std::mutex>> held;
+    held.reserve(itemLocks.size() + readerLocks.size());
+    for (std::size_t i = 0; i < itemLocks.size(); ++i) held.emplace_back(itemLocks.stripe(i));
+    for (std::size_t i = 0; i < readerLocks.size(); ++i) held.emplace_back(readerLocks.stripe(i));
+    std::unique_lock lk(loansMu);
+    fn(db);
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::archiveReturned(std::chrono::sys_days before) {
+    std::size_t moved = 0;
+    // Detenido: las devoluciones en curso siguen leyendo su Loan tras soltar loansMu
+    quiesceMutable([&](MemoryDb& d) {
+        std::vector<std::string> keys;
+        std::vector<LoanArchive::Row> rows;
+        std::unordered_set<LoanHandle> gone;
+        for (auto& kv : d.loans) {
+            const Loan& L = kv.second;
+            if (!L.returned || *L.returned >= before) continue;
+            keys.push_back(kv.first);
+            rows.push_back({parseLoanId(kv.first).value_or(0), {}, L.copy, L.book, L.reader,
+                            L.start, L.due, *L.returned});
+            gone.insert(*d.loans.lookup(kv.first));
+        }
+        if (keys.empty()) return;
+        for (std::size_t i = 0; i < rows.size(); ++i)
+            if (rows[i].number == 0) rows[i].oddId = keys[i];
+
+        // El heap de vencimientos aún puede apuntar a préstamos devueltos
+        auto& heap = d.dueIndex;
+        heap.erase(std::remove_if(heap.begin(), heap.end(), [&](auto& e) { return gone.count(e.loan) != 0; }),
+                   heap.end());
+        std::make_heap(heap.begin(), heap.end(), std::greater<>{});
+        {
+            std::unique_lock lk(archiveMu);
+            d.archive.appendSegment(std::move(rows));
+        }
+        for (const std::string& k : keys) d.loans.erase(k);
+        moved = keys.size();
+        if (views) views->archived(before);
+        LIB_ASSERT_INDEXES(d);
+    });
+    return moved;
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::queryArchive(FunctionRef<void(const LoanArchive&)> fn) const {
+    std::shared_lock lk(archiveMu);
+    fn(db.archive);
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::attachViews(ReadViews* v) {
+    quiesceMutable([&](MemoryDb& d) {
+        if (views && views != v) views->detach();
+        views = v;
+        if (v) v->start(d, RuntimeLoanPolicy::of(rules), [this] { attachViews(nullptr); });
+    });
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::writeSnapshot(const std::string& path) {
+    quiesce([&](const MemoryDb& d) { lib::writeSnapshot(d, path); });
+}
+
+// Con todos los candados tomados no hay append() en curso: el snapshot cubre
+// exactamente lo registrado y el log puede vaciarse
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::checkpoint(const std::string& snapshotPath) {
+    quiesce([&](const MemoryDb& d) {
+        lib::writeSnapshot(d, snapshotPath);
+        if (wal) wal->truncate();
+    });
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryChangeCopyStatus(CopyHandle copy, CopyStatus from, CopyStatus to,
+                                                                std::chrono::sys_days today) {
+    auto lent = [](CopyStatus st) { return st == CopyStatus::LOANED || st == CopyStatus::LATE; };
+    if (lent(from) || lent(to)) throw std::invalid_argument("tryChangeCopyStatus: LOANED/LATE");
+    std::optional<MemoryDb::Hold> hold;
+    {
+        std::lock_guard itemLk(itemLocks.at(Handle(copy)));
+        std::unique_lock lk(loansMu);
+        if (db.copies[copy].status != from) return Unexpected{LibError::CopyNotAvailable};
+        if (from == CopyStatus::RESERVED) db.releaseHold(copy);
+        db.setCopyStatus(copy, to);
+        if (views) views->statusChanged(db.copies.idOf(copy), to);
+        if (to == CopyStatus::IN_LIBRARY) {
+            if (const auto book = db.books.lookup(db.copies[copy].bookId)) hold = holdForNext(copy, *book, today);
+        }
+        LIB_ASSERT_INDEXES(db);
+    }
+    if (hold) notifyReleased({hold->book, hold}, today);
+    return {};
+}
+
+template <LoanPolicy Policy>
+std::optional<std::string> BasicLibraryService<Policy>::findAvailableCopy(const std::string& bookId) const {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return std::nullopt;
+    std::shared_lock lk(loansMu);
+    const auto c = db.anyFreeCopy(*b);
+    if (!c) return std::nullopt;
+    return db.copies.idOf(*c);
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::countCopies(const std::string& bookId, CopyStatus status) const {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return 0;
+    std::shared_lock lk(loansMu);
+    auto it = db.copiesByBook.find(*b);
+    return it == db.copiesByBook.end() ? 0 : it->second.byStatus[std::size_t(status)];
+}
+
+template <LoanPolicy Policy>
+std::array<std::size_t, kCopyStatusCount> BasicLibraryService<Policy>::countCopiesByStatus() const {
+    std::shared_lock lk(loansMu);
+    return db.copyStates.countByStatus();
+}
+
+template <LoanPolicy Policy>
+std::vector<std::string> BasicLibraryService<Policy>::copiesInStatus(CopyStatus status) const {
+    std::vector<CopyHandle> hits;
+    std::shared_lock lk(loansMu);
+    db.copyStates.collect(status, hits);
+    std::vector<std::string> out;
+    out.reserve(hits.size());
+    for (const CopyHandle h : hits) out.push_back(db.copies.idOf(h));
+    return out;
+}
+
+template <LoanPolicy Policy>
+std::string BasicLibraryService<Policy>::loanId(LoanHandle h) const {
+    std::shared_lock lk(loansMu);
+    return db.loans.idOf(h);
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::notifyAvailable(BookHandle book, std::chrono::sys_days day) {
+    alerts.notifyAvailable(
+        db.books.idOf(book),
+        [&](std::string_view rid) -> std::string_view { return db.readers.at(rid).email; },
+        [&](std::string_view bid) -> std::string_view { return db.books.at(bid).title; },
+        day
+    );
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::notifyReleased(const Released& r, std::chrono::sys_days day) {
+    if (!r.hold) {
+        notifyAvailable(r.book, day);
+        return;
+    }
+    alerts.notifyHold(db.readers[r.hold->reader].email, db.books[r.hold->book].title, r.hold->until);
+}
+
+template <LoanPolicy Policy>
+Task<> BasicLibraryService<Policy>::notifyAvailableAsync(BookHandle book, std::chrono::sys_days day) {
+    co_await alerts.notifyAvailableAsync(
+        std::string(db.books.idOf(book)),
+        [&](std::string_view rid) -> std::string_view { return db.readers.at(rid).email; },
+        [&](std::string_view bid) -> std::string_view { return db.books.at(bid).title; },
+        day
+    );
+}
+
+template <LoanPolicy Policy>
+Task<> BasicLibraryService<Policy>::notifyReleasedAsync(Released r, std::chrono::sys_days day) {
+    if (!r.hold) {
+        co_await notifyAvailableAsync(r.book, day);
+        co_return;
+    }
+    co_await alerts.notifyHoldAsync(db.readers[r.hold->reader].email, db.books[r.hold->book].title, r.hold->until);
+}
+
+// --- API asíncrona ---
+// Préstamos: sin envíos que esperar, la tarea es la llamada síncrona
+template <LoanPolicy Policy>
+Task<Expected<std::string>> BasicLibraryService<Policy>::borrowCopyAsync(std::string copyId, std::string readerId,
+                                                                         std::chrono::sys_days today) {
+    co_return tryBorrowCopy(copyId, readerId, today);
+}
+
+template <LoanPolicy Policy>
+Task<Expected<std::string>> BasicLibraryService<Policy>::borrowAnyCopyAsync(std::string bookId,
+                                                                            std::string readerId,
+                                                                            std::chrono::sys_days today) {
+    co_return tryBorrowAnyCopy(bookId, readerId, today);
+}
+
+template <LoanPolicy Policy>
+Task<Expected<void>> BasicLibraryService<Policy>::returnCopyAsync(std::string copyId, std::chrono::sys_days when) {
+    const auto c = db.copies.lookup(copyId);
+    if (!c) co_return metrics::rejected(metrics::Op::Return, LibError::CopyNotFound);
+    co_return co_await returnCopyAsync(*c, when);
+}
+
+// Como tryReturnCopy, con el aviso esperado en vez de enviado en el hilo
+template <LoanPolicy Policy>
+Task<Expected<void>> BasicLibraryService<Policy>::returnCopyAsync(CopyHandle copy, std::chrono::sys_days when) {
+    metrics::ScopedLatency timer(metrics::Op::Return);
+    WalTicket ticket = 0;
+    const auto released = returnCopyImpl(copy, when, &ticket);
+    if (!released) co_return metrics::rejected(metrics::Op::Return, released.error());
+    commitLog(ticket);
+    co_await notifyReleasedAsync(*released, when);
+    co_return Expected<void>{};
+}
+
+template <LoanPolicy Policy>
+Task<Expected<void>> BasicLibraryService<Policy>::returnOriginalNewReleaseAsync(std::string bookId,
+                                                                                std::string readerId,
+                                                                                std::chrono::sys_days when) {
+    const auto b = db.books.lookup(bookId);
+    if (!b) co_return metrics::rejected(metrics::Op::Return, LibError::BookNotFound);
+    const auto r = db.readers.lookup(readerId);
+    if (!r) co_return metrics::rejected(metrics::Op::Return, LibError::ReaderNotFound);
+    metrics::ScopedLatency timer(metrics::Op::Return);
+    WalTicket ticket = 0;
+    const auto done = returnOriginalImpl(*b, *r, when, &ticket);
+    if (!done) co_return metrics::rejected(metrics::Op::Return, done.error());
+    commitLog(ticket);
+    co_await notifyAvailableAsync(*b, when);
+    co_return Expected<void>{};
+}
+
+// --- Reservas ---
+template <LoanPolicy Policy>
+std::optional<MemoryDb::Hold> BasicLibraryService<Policy>::holdForNext(CopyHandle copy, BookHandle book,
+                                                                      std::chrono::sys_days day) {
+    const auto next = db.nextReservation(book);
+    if (!next) return std::nullopt;
+    db.placeHold(copy, book, *next, day + std::chrono::days(kHoldDays));
+    if (db.copies[copy].status != CopyStatus::RESERVED) {
+        db.setCopyStatus(copy, CopyStatus::RESERVED);
+        if (views) views->statusChanged(db.copies.idOf(copy), CopyStatus::RESERVED);
+    }
+    return db.holds.at(copy);
+}
+
+template <LoanPolicy Policy>
+auto BasicLibraryService<Policy>::rollOver(CopyHandle copy, std::chrono::sys_days day) -> Released {
+    const MemoryDb::Hold old = *db.releaseHold(copy);
+    if (auto next = holdForNext(copy, old.book, day)) return {old.book, next};
+    db.setCopyStatus(copy, CopyStatus::IN_LIBRARY);
+    if (views) views->statusChanged(db.copies.idOf(copy), CopyStatus::IN_LIBRARY);
+    return {old.book, std::nullopt};
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryReserve(const std::string& bookId, const std::string& readerId,
+                                                       std::chrono::sys_days today) {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return Unexpected{LibError::BookNotFound};
+    const auto r = db.readers.lookup(readerId);
+    if (!r) return Unexpected{LibError::ReaderNotFound};
+    return tryReserve(*b, *r, today);
+}
+
+template <LoanPolicy Policy>
+void BasicLibraryService<Policy>::reserve(const std::string& bookId, const std::string& readerId,
+                                          std::chrono::sys_days today) {
+    tryReserve(bookId, readerId, today).value();
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryReserve(BookHandle book, ReaderHandle reader,
+                                                       std::chrono::sys_days today) {
+    {
+        std::lock_guard readerLk(readerLocks.at(Handle(reader)));
+        if (db.readers[reader].isBanned(today)) return Unexpected{LibError::BorrowForbidden};
+    }
+    const auto key = MemoryDb::originalKey(book, reader);
+    for (;;) {
+        // Sin copia libre se encola bajo el mismo tramo que lo comprueba: una
+        // devolución posterior ya ve el turno
+        std::optional<CopyHandle> copy;
+        {
+            std::unique_lock lk(loansMu);
+            if (db.queuedTurns.count(key) || db.heldFor.count(key)) return Unexpected{LibError::AlreadyReserved};
+            copy = db.anyFreeCopy(book);
+            if (!copy) {
+                db.enqueueReservation(book, reader);
+                LIB_ASSERT_INDEXES(db);
+                return {};
+            }
+        }
+        // Hay una libre: se aparta ya, con el orden habitual de candados
+        std::optional<MemoryDb::Hold> hold;
+        {
+            std::lock_guard itemLk(itemLocks.at(Handle(*copy)));
+            std::unique_lock lk(loansMu);
+            if (db.queuedTurns.count(key) || db.heldFor.count(key)) return Unexpected{LibError::AlreadyReserved};
+            if (db.copies[*copy].status != CopyStatus::IN_LIBRARY) {
+                // Se la llevaron o cambió a mano: se corrige el índice y se reintenta
+                db.setCopyStatus(*copy, db.copies[*copy].status);
+                continue;
+            }
+            db.placeHold(*copy, book, reader, today + std::chrono::days(kHoldDays));
+            db.setCopyStatus(*copy, CopyStatus::RESERVED);
+            if (views) views->statusChanged(db.copies.idOf(*copy), CopyStatus::RESERVED);
+            hold = db.holds.at(*copy);
+            LIB_ASSERT_INDEXES(db);
+        }
+        notifyReleased({book, hold}, today);
+        return {};
+    }
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryCancelReservation(const std::string& bookId,
+                                                                 const std::string& readerId,
+                                                                 std::chrono::sys_days today) {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return Unexpected{LibError::BookNotFound};
+    const auto r = db.readers.lookup(readerId);
+    if (!r) return Unexpected{LibError::ReaderNotFound};
+    return tryCancelReservation(*b, *r, today);
+}
+
+template <LoanPolicy Policy>
+Expected<void> BasicLibraryService<Policy>::tryCancelReservation(BookHandle book, ReaderHandle reader,
+                                                                 std::chrono::sys_days today) {
+    std::optional<CopyHandle> copy;
+    {
+        std::unique_lock lk(loansMu);
+        if (db.cancelReservation(book, reader)) return {};
+        auto held = db.heldFor.find(MemoryDb::originalKey(book, reader));
+        if (held == db.heldFor.end()) return Unexpected{LibError::ReservationNotFound};
+        copy = held->second;
+    }
+    // Tenía una apartada: pasa al siguiente, salvo que la recogiera o venciera entretanto
+    Released next;
+    {
+        std::lock_guard itemLk(itemLocks.at(Handle(*copy)));
+        std::unique_lock lk(loansMu);
+        auto held = db.holds.find(*copy);
+        if (held == db.holds.end() || held->second.reader != reader) return Unexpected{LibError::ReservationNotFound};
+        next = rollOver(*copy, today);
+        LIB_ASSERT_INDEXES(db);
+    }
+    notifyReleased(next, today);
+    return {};
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::expireHolds(std::chrono::sys_days today) {
+    // 1) Sacar del heap lo vencido
+    std::vector<MemoryDb::HoldEntry> due;
+    {
+        std::unique_lock lk(loansMu);
+        auto& heap = db.holdExpiry;
+        while (!heap.empty() && heap.front().until < today) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            due.push_back(heap.back());
+            heap.pop_back();
+        }
+    }
+    // 2) Con el candado de la copia: si el apartado ya no es el de la entrada
+    //    (recogido, cancelado o vuelto a apartar) se salta
+    std::vector<Released> released;
+    for (const MemoryDb::HoldEntry& e : due) {
+        std::lock_guard itemLk(itemLocks.at(Handle(e.copy)));
+        std::unique_lock lk(loansMu);
+        auto held = db.holds.find(e.copy);
+        if (held == db.holds.end() || held->second.until != e.until) continue;
+        released.push_back(rollOver(e.copy, today));
+        LIB_ASSERT_INDEXES(db);
+    }
+    // 3) Avisar sin candados
+    for (const Released& r : released) notifyReleased(r, today);
+    return released.size();
+}
+
+template <LoanPolicy Policy>
+std::size_t BasicLibraryService<Policy>::reservationCount(const std::string& bookId) const {
+    const auto b = db.books.lookup(bookId);
+    if (!b) return 0;
+    std::shared_lock lk(loansMu);
+    return db.reservationCount(*b);
+}
+
+template <LoanPolicy Policy>
+std::optional<std::string> BasicLibraryService<Policy>::holdOf(const std::string& copyId) const {
+    const auto c = db.copies.lookup(copyId);
+    if (!c) return std::nullopt;
+    std::shared_lock lk(loansMu);
+    auto held = db.holds.find(*c);
+    if (held == db.holds.end()) return std::nullopt;
+    return db.readers.idOf(held->second.reader);
+}
+
+} // namespace lib
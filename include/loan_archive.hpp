@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "tables.hpp"
+
+namespace lib {
+
+enum class BookHandle   : Handle;
+enum class CopyHandle   : Handle;
+enum class ReaderHandle : Handle;
+using LoanNumber = std::uint64_t;
+
+// Histórico de préstamos cerrados en columnas (una por campo): handles de 32
+// bits, días como int32 desde 1970-01-01 y dos columnas derivadas, días de
+// retraso (u16, saturado) y mes de inicio (u16, meses desde 1970-01). Los
+// agregados recorren columnas contiguas sin ramas, así el compilador puede
+// vectorizarlos y van al ritmo de la memoria.
+// Las filas se añaden por segmentos ordenados por número de préstamo, así
+// se puede buscar un ID sin mantener un hash por fila.
+// No es segura entre hilos por sí sola: la protege LibraryService.
+class LoanArchive {
+public:
+    struct Row {
+        LoanNumber number;    // 0 si el ID no tiene la forma "L<n>"...
+        std::string_view oddId; // ...y entonces va aquí el ID tal cual
+        CopyHandle copy;      // kNoHandle en préstamos del original
+        BookHandle book;
+        ReaderHandle reader;
+        std::chrono::sys_days start, due, returned;
+    };
+
+    // Añade las filas como un segmento nuevo (las ordena por número)
+    void appendSegment(std::vector<Row> rows);
+    void clear();
+
+    std::size_t size() const { return number.size(); }
+    bool empty() const { return number.empty(); }
+    Row row(std::size_t i) const;
+    std::string idOf(std::size_t i) const;
+    std::optional<std::size_t> find(std::string_view loanId) const;
+    bool contains(std::string_view loanId) const { return find(loanId).has_value(); }
+
+    // --- Agregados ---
+    std::uint64_t totalLateDays() const;
+    std::size_t countLate() const;
+    // h[d] = préstamos con d días de retraso; el último cubo acumula los >= buckets-1
+    std::vector<std::uint64_t> lateDaysHistogram(std::size_t buckets) const;
+    std::size_t countByBook(BookHandle book) const;
+    // Préstamos del libro por mes de inicio, para `months` meses desde `first`
+    std::vector<std::uint32_t> monthlyLoans(BookHandle book, int first, std::size_t months) const;
+    static int monthOf(std::chrono::sys_days d);
+
+    // Columnas en crudo (snapshot, kernels propios)
+    std::span<const LoanNumber> numbers() const { return number; }
+    std::span<const Handle> copies() const { return copy; }
+    std::span<const Handle> books() const { return book; }
+    std::span<const Handle> readers() const { return reader; }
+    std::span<const std::int32_t> startDays() const { return start; }
+    std::span<const std::int32_t> dueDays() const { return due; }
+    std::span<const std::int32_t> returnedDays() const { return returned; }
+    std::span<const std::uint32_t> segmentStarts() const { return segments; }
+    const std::unordered_map<std::uint32_t, std::string>& oddIds() const { return odd; }
+
+private:
+    std::vector<LoanNumber> number;
+    std::vector<Handle> copy, book, reader;
+    std::vector<std::int32_t> start, due, returned;
+    std::vector<std::uint16_t> late, month;
+    std::vector<std::uint32_t> segments;              // fila inicial de cada segmento
+    std::unordered_map<std::uint32_t, std::string> odd; // fila -> ID sin forma "L<n>"
+};
+
+} // namespace lib
@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace lib {
+
+// Conjunto fijo de mutex repartidos por clave: una misma clave (handle) cae
+// siempre en el mismo mutex y claves distintas casi nunca comparten uno.
+// Los handles son densos, así que basta con la máscara para repartirlos.
+// Cada mutex ocupa su propia línea de caché para evitar falso compartido.
+class LockStripes {
+    struct alignas(64) Stripe { std::mutex m; };
+    std::size_t mask;
+    std::unique_ptr<Stripe[]> stripes;
+public:
+    explicit LockStripes(std::size_t count = 64)
+        : mask(std::bit_ceil(count == 0 ? 1 : count) - 1),
+          stripes(std::make_unique<Stripe[]>(mask + 1)) {}
+
+    std::size_t indexOf(std::uint32_t key) const { return key & mask; }
+    std::mutex& at(std::uint32_t key) { return stripes[indexOf(key)].m; }
+    std::mutex& stripe(std::size_t i) { return stripes[i].m; }
+    std::size_t size() const { return mask + 1; }
+};
+
+// Candados de varias claves a la vez (operaciones por lotes). Se toman en
+// orden de stripe y sin repetir, así dos lotes que se solapan no se
+// interbloquean; respecto a los demás niveles cuenta como un solo paso.
+class MultiLock {
+    std::vector<std::unique_lock<std::mutex>> held;
+public:
+    MultiLock(LockStripes& stripes, std::span<const std::uint32_t> keys) {
+        std::vector<std::size_t> idx;
+        idx.reserve(keys.size());
+        for (auto k : keys) idx.push_back(stripes.indexOf(k));
+        std::sort(idx.begin(), idx.end());
+        idx.erase(std::unique(idx.begin(), idx.end()), idx.end());
+        held.reserve(idx.size());
+        for (auto i : idx) held.emplace_back(stripes.stripe(i));
+    }
+};
+
+} // namespace lib
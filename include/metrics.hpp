@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "errors.hpp"
+
+// Métricas de LibraryService y BioAlert: llamadas y latencias de préstamos,
+// devoluciones y avisos, rechazos por código, tamaño de los avisos y
+// latencia del gateway. Cada hilo escribe en sus propios contadores (un
+// load + store relajado, sin RMW ni candados); snapshot() y prometheusText()
+// los suman al leer. Con BIBLIOTECA_METRICS=OFF (CMake) todo esto queda en
+// funciones vacías en línea y no cuesta nada.
+namespace lib::metrics {
+
+enum class Op : std::uint8_t { Borrow, Return, Notify, GatewaySend };
+inline constexpr std::size_t kOpCount = 4;
+
+// Latencias en cubos log2: el cubo k recoge hasta 64 << k ns (64 ns .. ~33 ms);
+// el último es +Inf
+inline constexpr std::size_t kLatencyBuckets = 21;
+inline constexpr std::uint64_t latencyBound(std::size_t k) { return std::uint64_t{64} << k; }
+inline constexpr std::size_t latencyBucket(std::uint64_t ns) {
+    const std::size_t k = ns <= 64 ? 0 : std::size_t(std::bit_width((ns - 1) >> 6));
+    return k < kLatencyBuckets - 1 ? k : kLatencyBuckets - 1;
+}
+
+// Emails por aviso: el cubo k recoge hasta 2^k - 1 (0, 1, 3, 7, ...); el último es +Inf
+inline constexpr std::size_t kFanoutBuckets = 17;
+inline constexpr std::uint64_t fanoutBound(std::size_t k) { return (std::uint64_t{1} << k) - 1; }
+inline constexpr std::size_t fanoutBucket(std::uint64_t n) {
+    const std::size_t k = std::size_t(std::bit_width(n));
+    return k < kFanoutBuckets - 1 ? k : kFanoutBuckets - 1;
+}
+
+constexpr const char* opName(Op op) {
+    switch (op) {
+    case Op::Borrow:      return "borrow";
+    case Op::Return:      return "return";
+    case Op::Notify:      return "notify";
+    case Op::GatewaySend: return "gateway_send";
+    }
+    return "unknown";
+}
+
+// Totales sumados de todos los hilos (también de los que ya terminaron)
+struct Snapshot {
+    struct Latency {
+        std::uint64_t count{0};
+        std::uint64_t sumNs{0};
+        std::array<std::uint64_t, kLatencyBuckets> buckets{}; // no acumulados
+    };
+    std::array<Latency, kOpCount> latency{};
+    std::array<std::array<std::uint64_t, kLibErrorCount>, kOpCount> rejected{};
+    std::uint64_t fanoutEvents{0};
+    std::uint64_t fanoutSum{0};
+    std::array<std::uint64_t, kFanoutBuckets> fanout{};
+
+    std::uint64_t calls(Op op) const { return latency[std::size_t(op)].count; }
+    std::uint64_t rejections(Op op, LibError e) const { return rejected[std::size_t(op)][std::size_t(e)]; }
+    std::uint64_t rejections(Op op) const {
+        std::uint64_t n = 0;
+        for (auto v : rejected[std::size_t(op)]) n += v;
+        return n;
+    }
+};
+
+#ifdef LIB_METRICS
+inline constexpr bool kEnabled = true;
+
+// Contadores de un hilo. Sólo los escribe su hilo; los lectores cargan relajado.
+struct alignas(64) ThreadCounters {
+    std::atomic<std::uint64_t> latencyCount[kOpCount]{};
+    std::atomic<std::uint64_t> latencySumNs[kOpCount]{};
+    std::atomic<std::uint64_t> latency[kOpCount][kLatencyBuckets]{};
+    std::atomic<std::uint64_t> rejected[kOpCount][kLibErrorCount]{};
+    std::atomic<std::uint64_t> fanoutEvents{0};
+    std::atomic<std::uint64_t> fanoutSum{0};
+    std::atomic<std::uint64_t> fanout[kFanoutBuckets]{};
+};
+
+// Los del hilo actual (se registran en el primer uso)
+ThreadCounters& local();
+
+namespace detail {
+// Un solo escritor: no hace falta fetch_add
+inline void bump(std::atomic<std::uint64_t>& a, std::uint64_t n = 1) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+} // namespace detail
+
+inline void recordLatency(Op op, std::chrono::nanoseconds d) {
+    auto& t = local();
+    const auto i = std::size_t(op);
+    const auto ns = static_cast<std::uint64_t>(d.count() < 0 ? 0 : d.count());
+    detail::bump(t.latencyCount[i]);
+    detail::bump(t.latencySumNs[i], ns);
+    detail::bump(t.latency[i][latencyBucket(ns)]);
+}
+inline void recordRejection(Op op, LibError e) { detail::bump(local().rejected[std::size_t(op)][std::size_t(e)]); }
+inline void recordFanout(std::size_t emails) {
+    auto& t = local();
+    detail::bump(t.fanoutEvents);
+    detail::bump(t.fanoutSum, emails);
+    detail::bump(t.fanout[fanoutBucket(emails)]);
+}
+
+// Mide el ámbito y lo apunta como una llamada de `op`
+class ScopedLatency {
+    Op op;
+    std::chrono::steady_clock::time_point start;
+public:
+    explicit ScopedLatency(Op op) : op(op), start(std::chrono::steady_clock::now()) {}
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+    ~ScopedLatency() { recordLatency(op, std::chrono::steady_clock::now() - start); }
+};
+
+Snapshot snapshot();
+// Formato de texto de Prometheus (histogramas en segundos, rechazos distintos de cero)
+std::string prometheusText();
+#else
+inline constexpr bool kEnabled = false;
+
+inline void recordLatency(Op, std::chrono::nanoseconds) {}
+inline void recordRejection(Op, LibError) {}
+inline void recordFanout(std::size_t) {}
+
+class ScopedLatency {
+public:
+    explicit ScopedLatency(Op) {}
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+};
+
+inline Snapshot snapshot() { return {}; }
+inline std::string prometheusText() { return {}; }
+#endif
+
+// Apunta el rechazo y lo devuelve como lado de error de Expected
+inline Unexpected rejected(Op op, LibError e) {
+    recordRejection(op, e);
+    return Unexpected{e};
+}
+
+} // namespace lib::metrics
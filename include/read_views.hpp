@@ -0,0 +1,172 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "library.hpp"
+#include "wal.hpp"
+
+namespace lib {
+
+// --- Vistas de sólo lectura para informes ---
+// Versiones inmutables de MemoryDb (libros, copias, lectores, préstamos e
+// índices) que se consultan sin tomar ningún candado de LibraryService, así
+// un informe largo no frena borrowCopy/returnCopy.
+// El servicio enganchado (attachViews) pasa cada mutación, en su tramo de
+// loansMu y en el mismo orden que el WAL, a una réplica privada que aplica
+// un hilo propio; éste publica de vez en cuando una versión nueva. Cada
+// versión equivale al estado tras sus `version` primeras mutaciones: un corte
+// consistente, aunque algo atrasado.
+// Copia en escritura por tabla: una versión sólo copia de la réplica las
+// tablas (con sus índices) que tocaron los cambios desde la anterior y
+// comparte el resto con ella. Los libros no cambian con el servicio en
+// marcha y se comparten siempre; devolver una copia copia copias, lectores
+// y préstamos, y levantar un baneo sólo los lectores.
+// Las versiones viejas viven mientras algún lector tenga su puntero; al
+// soltar el último, la memoria la libera el hilo de las vistas, no el lector.
+// Las vistas no incluyen el histórico (MemoryDb::archive queda vacío): para
+// eso está LibraryService::queryArchive.
+class ReadViews {
+public:
+    // Tablas de una versión, cada una con los índices que dependen de ella
+    struct Books {
+        HandleTable<Book, BookHandle> table;
+    };
+    struct Copies {
+        HandleTable<Copy, CopyHandle> table;
+        decltype(MemoryDb::copiesByBook) byBook;
+        CopyStateTable states;
+    };
+    struct Readers {
+        HandleTable<Reader, ReaderHandle> table;
+        BanWheel bans;
+    };
+    struct Loans {
+        HandleTable<Loan, LoanHandle> table;
+        decltype(MemoryDb::newReleaseBorrowed) newReleaseBorrowed;
+        decltype(MemoryDb::openLoanByCopy) openLoanByCopy;
+        decltype(MemoryDb::openOriginalLoan) openOriginalLoan;
+        decltype(MemoryDb::dueIndex) dueIndex;
+        std::chrono::sys_days overdueScannedTo{};
+        LoanIdAllocator loanIds;
+    };
+
+    struct View {
+        std::shared_ptr<const Books> books;
+        std::shared_ptr<const Copies> copies;
+        std::shared_ptr<const Readers> readers;
+        std::shared_ptr<const Loans> loans;
+        std::uint64_t version{0}; // mutaciones incluidas desde attachViews
+
+        // Copia completa como MemoryDb: O(n), para comprobaciones (checkIndexes,
+        // comparar con el servicio) o para quien necesite la API de MemoryDb
+        MemoryDb materialize() const;
+    };
+    using ViewPtr = std::shared_ptr<const View>;
+
+    struct Options {
+        // Como mucho una versión por intervalo (cada una copia las tablas que
+        // cambiaron); latest() publica sin esperar a que venza
+        std::chrono::milliseconds interval{10};
+    };
+
+    struct Stats {
+        std::uint64_t changes{0};   // mutaciones aplicadas a la réplica
+        std::uint64_t published{0}; // versiones publicadas
+        std::uint64_t reclaimed{0}; // versiones ya liberadas
+        std::uint64_t tablesCopied{0}; // tablas copiadas de la réplica al publicar
+    };
+
+    ReadViews();
+    explicit ReadViews(Options opts);
+    ~ReadViews(); // se desengancha del servicio si sigue enganchada
+
+    ReadViews(const ReadViews&) = delete;
+    ReadViews& operator=(const ReadViews&) = delete;
+
+    // La última versión publicada, sin esperar (nullptr antes de engancharse)
+    ViewPtr current() const;
+    // Una versión con todas las mutaciones recibidas hasta ahora (espera a que
+    // el hilo las aplique y publique)
+    ViewPtr latest();
+
+    Stats stats() const;
+
+private:
+    template <LoanPolicy> friend class BasicLibraryService;
+
+    // Mutación tal como la ve la réplica
+    struct Change {
+        enum class Kind : std::uint8_t { Log, MarkLate, LiftBan, Archive, SetStatus };
+        Kind kind;
+        WalRecord rec;                // Log
+        std::string id;               // MarkLate/SetStatus: copyId; LiftBan: readerId
+        std::chrono::sys_days day{};  // LiftBan: fin del baneo levantado; Archive: corte
+        CopyStatus status{};          // SetStatus
+    };
+
+    // Lo comparten el hilo y los deleters de las versiones publicadas, que
+    // pueden vivir más que ReadViews
+    struct Shared {
+        std::mutex mu;
+        std::condition_variable cv;
+        std::vector<const View*> graveyard; // versiones soltadas, a liberar por el hilo
+        bool stopped{false};
+        std::atomic<std::uint64_t> reclaimed{0};
+    };
+
+    Options opts;
+    std::shared_ptr<Shared> shared;
+    std::function<void()> unhook; // desengancha del servicio dueño
+
+    // Protegidos por shared->mu
+    std::vector<Change> pending;
+    std::uint64_t received{0};     // mutaciones recibidas
+    std::uint64_t wantVersion{0};  // latest() espera a esta versión
+    std::uint64_t publishedVersion{0};
+    bool stop{false};
+    std::condition_variable publishedCv;
+
+    mutable std::mutex viewMu; // sólo para copiar o cambiar `published`
+    ViewPtr published;
+    std::atomic<std::uint64_t> applied{0};
+    std::atomic<std::uint64_t> publishCount{0};
+    std::atomic<std::uint64_t> tablesCopied{0};
+
+    // Sólo el hilo (tras start)
+    std::unique_ptr<MemoryDb> replica;
+    // Tablas de la réplica cambiadas desde la última versión publicada
+    enum TableBit : std::uint8_t { kBookTable = 1, kCopyTable = 2, kReaderTable = 4, kLoanTable = 8, kAllTables = 15 };
+    std::uint8_t touched{kAllTables};
+    BioAlert quiet{1};
+    std::optional<ConfigurableLibraryService> replicaSvc; // con las reglas del servicio dueño
+
+    std::thread worker;
+
+    // Llamadas del servicio (start/detach con el servicio detenido; el resto
+    // con loansMu en exclusivo o con el candado del lector)
+    void start(const MemoryDb& primary, RuntimeLoanPolicy rules, std::function<void()> unhookOwner);
+    void detach();
+    void push(Change c);
+    void logged(WalRecord::Op op, std::chrono::sys_days day, std::string_view loanId,
+                std::string_view itemId, std::string_view readerId);
+    void markedLate(std::string_view copyId);
+    void statusChanged(std::string_view copyId, CopyStatus status);
+    void banLifted(std::string_view readerId, std::chrono::sys_days until);
+    void archived(std::chrono::sys_days before);
+
+    void run();
+    void apply(const Change& c);
+    void publish(std::uint64_t version);
+    static void reclaim(std::vector<const View*>& views, Shared& s);
+};
+
+} // namespace lib
@@ -0,0 +1,143 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "library.hpp"
+
+namespace lib {
+
+// --- Varias sedes: un LibraryService por shard ---
+// Cada shard tiene su MemoryDb y su servicio (con sus candados), y guarda sus
+// copias, sus préstamos y los originales de sus libros. Libros y lectores se
+// replican en todos con los mismos handles. Una operación sobre una copia va
+// sólo a su shard: hilos en sedes distintas no comparten ningún candado.
+// Todas las sedes aplican las mismas reglas (RuntimeLoanPolicy, por defecto
+// las de DefaultLoanPolicy). Lo que es global por lector -el tope de
+// maxActiveLoans() y los baneos- va en una cuota atómica por lector fuera de
+// los shards: prestar la reserva
+// (CAS) antes de entrar al shard y la suelta si el shard rechaza; devolver
+// la suelta. Un baneo puesto en un shard se publica en la cuota (el mayor
+// fin de baneo visto) y los demás shards lo respetan desde ese momento.
+// Un directorio de copias (copyId -> shard y quién la tiene) permite mover
+// copias entre sedes (transferCopy) y saber a quién descontar al devolver.
+// Carga del catálogo (add*) primero y sin otros hilos; después, las
+// operaciones son seguras entre hilos.
+class ShardedLibrary {
+public:
+    // Sin BioAlert explícito los avisos van a BioAlert::getInstance()
+    explicit ShardedLibrary(std::size_t shardCount, RuntimeLoanPolicy rules = RuntimeLoanPolicy{});
+    ShardedLibrary(std::size_t shardCount, BioAlert& alerts, RuntimeLoanPolicy rules = RuntimeLoanPolicy{});
+
+    ShardedLibrary(const ShardedLibrary&) = delete;
+    ShardedLibrary& operator=(const ShardedLibrary&) = delete;
+
+    std::size_t shardCount() const { return shards.size(); }
+    const RuntimeLoanPolicy& policy() const { return rules; }
+    // Sede de un libro: guarda su original (new release)
+    std::size_t shardOfBook(const std::string& bookId) const;
+    // Sede actual de una copia (nullopt si no existe)
+    std::optional<std::size_t> shardOfCopy(const std::string& copyId) const;
+
+    // --- Carga del catálogo ---
+    void addBook(const Book& book);
+    // El lector entra sin préstamos activos; su baneo, si lo trae, vale en todas las sedes
+    void addReader(const Reader& reader);
+    // En `branch` o, sin él, en la sede que toque por hash del ID. La copia no
+    // puede venir prestada (LOANED/LATE).
+    void addCopy(const Copy& copy, std::optional<std::size_t> branch = std::nullopt);
+
+    // --- Operaciones (mismos códigos de error que LibraryService) ---
+    Expected<std::string> tryBorrowCopy(const std::string& copyId, const std::string& readerId,
+                                        std::chrono::sys_days today = LibraryService::today_utc());
+    Expected<std::string> tryBorrowOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                                      std::chrono::sys_days today = LibraryService::today_utc());
+    Expected<void> tryReturnCopy(const std::string& copyId,
+                                 std::chrono::sys_days when = LibraryService::today_utc());
+    Expected<void> tryReturnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                               std::chrono::sys_days when = LibraryService::today_utc());
+
+    std::string borrowCopy(const std::string& copyId, const std::string& readerId,
+                           std::chrono::sys_days today = LibraryService::today_utc());
+    std::string borrowOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                         std::chrono::sys_days today = LibraryService::today_utc());
+    void returnCopy(const std::string& copyId, std::chrono::sys_days when = LibraryService::today_utc());
+    void returnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                  std::chrono::sys_days when = LibraryService::today_utc());
+
+    // Mueve una copia IN_LIBRARY a otra sede. En la de origen queda como
+    // TRANSFERRED (su historial sigue ahí); si vuelve, reaprovecha esa fila.
+    // COPY_NOT_AVAILABLE si está prestada o no está IN_LIBRARY; a su misma
+    // sede, no hace nada. Las copias nuevas en una sede no llegan a sus ReadViews.
+    // `today` es el día del apartado si al volver a una sede la espera su cola.
+    Expected<void> tryTransferCopy(const std::string& copyId, std::size_t toShard,
+                                   std::chrono::sys_days today = LibraryService::today_utc());
+    void transferCopy(const std::string& copyId, std::size_t toShard,
+                      std::chrono::sys_days today = LibraryService::today_utc());
+
+    // Préstamos activos del lector sumando todas las sedes (0 si no existe)
+    std::size_t activeLoanCount(const std::string& readerId) const;
+    // ¿Algún baneo vigente en `today`, de cualquier sede?
+    bool isBanned(const std::string& readerId, std::chrono::sys_days today) const;
+
+    // LibraryService::advanceClock en todas las sedes a la vez (un hilo por
+    // shard); los vencidos se emiten después, sede a sede, desde el llamador
+    std::size_t advanceClock(std::chrono::sys_days today,
+                             FunctionRef<void(std::size_t shard, const OverdueLoan&)> sink);
+
+    // Acceso a cada sede (consultas, quiesce, snapshots por shard). Sus
+    // mutaciones por fuera de ShardedLibrary no pasan por las cuotas.
+    ConfigurableLibraryService& service(std::size_t shard) { return shards.at(shard)->svc; }
+    const MemoryDb& db(std::size_t shard) const { return shards.at(shard)->db; }
+
+    // Verifica cuotas y directorio contra los shards; O(n), sólo sin
+    // operaciones en curso (tests, depuración)
+    bool checkQuotas() const;
+
+private:
+    struct Shard {
+        MemoryDb db;
+        ConfigurableLibraryService svc;
+        // Compartido en cada operación; exclusivo para añadir una copia que
+        // llega por transferencia (cambia la estructura de db.copies)
+        std::shared_mutex structure;
+        Shard(BioAlert& alerts, RuntimeLoanPolicy rules) : svc(db, alerts, rules) {}
+    };
+
+    // Cuota global de un lector
+    struct ReaderQuota {
+        std::atomic<std::uint32_t> loans{0};
+        std::atomic<std::int32_t> banUntil{kNoBan}; // último día baneado (días desde 1970)
+    };
+    static constexpr std::int32_t kNoBan = INT32_MIN;
+
+    // Entrada del directorio de copias. `holder` es kFree, kBusy (una
+    // operación la tiene reservada) o el handle del lector que la tiene.
+    struct CopyEntry {
+        std::atomic<std::uint32_t> shard{0};
+        std::atomic<std::uint32_t> holder{kFree};
+    };
+    static constexpr std::uint32_t kFree = kNoHandle;
+    static constexpr std::uint32_t kBusy = kNoHandle - 1;
+
+    RuntimeLoanPolicy rules;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::deque<ReaderQuota> quotas; // por ReaderHandle (igual en todas las sedes)
+    Table<std::uint32_t> copyIndex; // copyId -> posición en `directory`
+    std::deque<CopyEntry> directory;
+
+    std::size_t shardByHash(std::string_view id) const;
+    std::optional<ReaderHandle> readerOf(const std::string& readerId) const;
+    CopyEntry* entryOf(const std::string& copyId);
+    Expected<void> reserve(ReaderHandle reader, std::chrono::sys_days today);
+    void release(ReaderHandle reader);
+    void raiseBan(ReaderHandle reader, std::chrono::sys_days until);
+};
+
+} // namespace lib
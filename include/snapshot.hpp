@@ -0,0 +1,91 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "library.hpp"
+
+namespace lib {
+
+// --- Snapshot binario de MemoryDb ---
+// Formato versionado y compacto (little-endian):
+//   cabecera | pool de strings | registros de tamaño fijo por tabla |
+//   préstamos activos por lector | libros con original prestado |
+//   un índice hash (open addressing) por tabla para buscar por ID |
+//   columnas del histórico de préstamos
+// Los registros se refieren entre sí por posición, y al materializar en un
+// MemoryDb vacío la posición pasa a ser el handle.
+
+// v2 añade el histórico columnar (MemoryDb::archive); los v1 se siguen leyendo
+inline constexpr std::uint32_t kSnapshotVersion = 2;
+
+// Escribe `db` en `path` (vía fichero temporal + rename). No toma candados:
+// con el servicio activo usar LibraryService::writeSnapshot.
+void writeSnapshot(const MemoryDb& db, const std::string& path);
+
+// Vistas de sólo lectura sobre el fichero mapeado (válidas mientras viva el SnapshotView)
+struct BookView {
+    std::string_view id, title, authorName, authorBirthDate, edition;
+    int year;
+    bool isNewRelease;
+};
+struct CopyView {
+    std::string_view id, bookId;
+    CopyStatus status;
+};
+struct ReaderView {
+    std::string_view id, email;
+    std::optional<std::chrono::sys_days> activeBanUntil;
+    std::size_t activeLoans;
+};
+struct LoanView {
+    std::string_view id, copyId, bookId, readerId; // copyId vacío en préstamos del original
+    std::chrono::sys_days start, due;
+    std::optional<std::chrono::sys_days> returned;
+};
+
+// Abre un snapshot con mmap de sólo lectura: abrir cuesta validar la
+// cabecera, no leer los datos. Las búsquedas por ID van directo a los índices
+// del fichero, así que se puede atender consultas antes de materializar.
+class SnapshotView {
+public:
+    explicit SnapshotView(const std::string& path);
+    ~SnapshotView();
+    SnapshotView(const SnapshotView&) = delete;
+    SnapshotView& operator=(const SnapshotView&) = delete;
+
+    std::size_t bookCount() const;
+    std::size_t copyCount() const;
+    std::size_t readerCount() const;
+    std::size_t loanCount() const;
+    std::size_t archivedLoanCount() const;
+    LoanNumber nextLoanNumber() const;
+
+    BookView book(std::size_t i) const;
+    CopyView copy(std::size_t i) const;
+    ReaderView reader(std::size_t i) const;
+    LoanView loan(std::size_t i) const;
+
+    std::optional<BookView> findBook(std::string_view id) const;
+    std::optional<CopyView> findCopy(std::string_view id) const;
+    std::optional<ReaderView> findReader(std::string_view id) const;
+    std::optional<LoanView> findLoan(std::string_view id) const;
+    bool isOriginalBorrowed(std::string_view bookId) const;
+
+    // Construye el MemoryDb completo (debe estar vacío)
+    void materialize(MemoryDb& db) const;
+
+private:
+    struct Mapping;
+    std::unique_ptr<Mapping> map;
+    std::optional<std::size_t> findIn(int section, std::string_view id) const;
+    void materializeArchive(MemoryDb& db) const;
+};
+
+// Atajo: abre y materializa
+void loadSnapshot(MemoryDb& db, const std::string& path);
+
+} // namespace lib
@@ -0,0 +1,399 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lib {
+
+// Handle compacto de un registro dentro de su tabla (estable mientras el registro exista)
+using Handle = std::uint32_t;
+inline constexpr Handle kNoHandle = static_cast<Handle>(-1);
+
+// Interfaz mínima que LibraryService espera de cada tabla de MemoryDb
+template <class T>
+concept KeyedTable = requires(T t, const T ct, std::string_view k) {
+    typename T::mapped_type;
+    typename T::iterator;
+    { t[k] } -> std::same_as<typename T::mapped_type&>;
+    { ct.at(k) } -> std::same_as<const typename T::mapped_type&>;
+    { ct.count(k) } -> std::convertible_to<std::size_t>;
+    { t.find(k) } -> std::same_as<typename T::iterator>;
+    { t.erase(k) } -> std::convertible_to<std::size_t>;
+    { ct.size() } -> std::convertible_to<std::size_t>;
+    t.reserve(std::size_t{});
+    t.begin();
+    t.end();
+    // Internado: clave externa <-> handle
+    { ct.handleOf(k) } -> std::same_as<Handle>;
+    { t.byHandle(Handle{}) } -> std::same_as<typename T::mapped_type&>;
+    { ct.keyOf(Handle{}) } -> std::same_as<const std::string&>;
+    { t.tryEmplaceHandle(k) } -> std::same_as<std::pair<Handle, bool>>;
+};
+
+// Las dos tablas reservan su memoria en el memory_resource que se les dé al
+// construirlas (por defecto, el global). Las claves son std::string: los IDs
+// cortos caben en el buffer interno y no reservan.
+
+// --- Implementación de referencia: árbol ordenado (std::map) ---
+// Los handles se asignan en un mapa aparte; resolver un handle cuesta un
+// recorrido del árbol, igual que una búsqueda por clave.
+template <class V>
+class MapTable {
+    using Map = std::pmr::map<std::string, V, std::less<>>;
+    Map m;
+    std::pmr::map<std::string, Handle, std::less<>> handles; // clave -> handle
+    std::pmr::vector<std::string> keys;                      // handle -> clave
+    std::pmr::vector<Handle> freeList;
+
+    Handle assign(std::string_view k) {
+        Handle h;
+        if (!freeList.empty()) { h = freeList.back(); freeList.pop_back(); keys[h] = k; }
+        else { h = static_cast<Handle>(keys.size()); keys.emplace_back(k); }
+        handles.emplace(std::string(k), h);
+        return h;
+    }
+    void release(std::string_view k) {
+        auto it = handles.find(k);
+        freeList.push_back(it->second);
+        keys[it->second].clear();
+        handles.erase(it);
+    }
+public:
+    using key_type       = std::string;
+    using mapped_type    = V;
+    using value_type     = typename Map::value_type;
+    using iterator       = typename Map::iterator;
+    using const_iterator = typename Map::const_iterator;
+
+    explicit MapTable(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : m(mr), handles(mr), keys(mr), freeList(mr) {}
+
+    V& operator[](std::string_view k) { return try_emplace(k).first->second; }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(std::string_view k, Args&&... args) {
+        auto it = m.lower_bound(k);
+        if (it != m.end() && it->first == k) return {it, false};
+        it = m.emplace_hint(it, std::piecewise_construct, std::forward_as_tuple(k),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+        assign(k);
+        return {it, true};
+    }
+
+    template <class... Args>
+    std::pair<Handle, bool> tryEmplaceHandle(std::string_view k, Args&&... args) {
+        const bool inserted = try_emplace(k, std::forward<Args>(args)...).second;
+        return {handleOf(k), inserted};
+    }
+    Handle handleOf(std::string_view k) const {
+        auto it = handles.find(k);
+        return it == handles.end() ? kNoHandle : it->second;
+    }
+    V& byHandle(Handle h) { return m.find(keys[h])->second; }
+    const V& byHandle(Handle h) const { return m.find(keys[h])->second; }
+    const std::string& keyOf(Handle h) const { return keys[h]; }
+
+    V& at(std::string_view k) {
+        auto it = m.find(k);
+        if (it == m.end()) throw std::out_of_range("MapTable::at");
+        return it->second;
+    }
+    const V& at(std::string_view k) const {
+        auto it = m.find(k);
+        if (it == m.end()) throw std::out_of_range("MapTable::at");
+        return it->second;
+    }
+
+    iterator find(std::string_view k) { return m.find(k); }
+    const_iterator find(std::string_view k) const { return m.find(k); }
+    std::size_t count(std::string_view k) const { return m.find(k) != m.end() ? 1 : 0; }
+    bool contains(std::string_view k) const { return m.find(k) != m.end(); }
+
+    std::size_t erase(std::string_view k) {
+        auto it = m.find(k);
+        if (it == m.end()) return 0;
+        erase(it);
+        return 1;
+    }
+    iterator erase(iterator it) {
+        release(it->first);
+        return m.erase(it);
+    }
+
+    std::size_t size() const { return m.size(); }
+    bool empty() const { return m.empty(); }
+    void clear() {
+        m.clear();
+        handles.clear();
+        keys.clear();
+        freeList.clear();
+    }
+    void reserve(std::size_t) {} // el árbol no pre-reserva
+
+    iterator begin() { return m.begin(); }
+    iterator end() { return m.end(); }
+    const_iterator begin() const { return m.begin(); }
+    const_iterator end() const { return m.end(); }
+};
+
+// --- Tabla hash plana ---
+// Índice open addressing (sondeo lineal, borrado con desplazamiento hacia atrás)
+// sobre un almacenamiento denso. Cada ranura del índice guarda la posición densa
+// y 32 bits del hash, así que una búsqueda recorre un vector contiguo y sólo
+// compara strings cuando el hash coincide. El almacenamiento denso es un deque:
+// las referencias a valores siguen válidas al insertar (como en std::map).
+// El handle de un registro es su posición densa.
+template <class V>
+class FlatTable {
+public:
+    using key_type    = std::string;
+    using mapped_type = V;
+    using value_type  = std::pair<const std::string, V>;
+
+private:
+    struct Slot {
+        std::uint32_t pos1{0}; // posición densa + 1; 0 = ranura vacía
+        std::uint32_t hash{0};
+    };
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    std::pmr::vector<Slot> slots;                      // potencia de 2 (o vacío)
+    std::pmr::deque<std::optional<value_type>> dense;  // nullopt = hueco reutilizable
+    std::pmr::vector<std::uint32_t> freeList;
+    std::size_t live{0};
+
+    static std::uint32_t hashOf(std::string_view k) {
+        const std::uint64_t h = std::hash<std::string_view>{}(k);
+        return static_cast<std::uint32_t>(h ^ (h >> 32));
+    }
+
+    std::size_t probe(std::string_view k, std::uint32_t h) const {
+        if (slots.empty()) return npos;
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot& s = slots[i];
+            if (s.pos1 == 0) return npos;
+            if (s.hash == h && dense[s.pos1 - 1]->first == k) return i;
+        }
+    }
+
+    void place(Slot s) {
+        const std::size_t mask = slots.size() - 1;
+        std::size_t i = s.hash & mask;
+        while (slots[i].pos1 != 0) i = (i + 1) & mask;
+        slots[i] = s;
+    }
+
+    void rehash(std::size_t capacity) {
+        std::pmr::vector<Slot> old(slots.get_allocator());
+        old.swap(slots);
+        slots.assign(capacity, Slot{});
+        for (const Slot& s : old) if (s.pos1 != 0) place(s);
+    }
+
+    // Mantiene la carga <= 3/4
+    void growFor(std::size_t n) {
+        std::size_t cap = slots.empty() ? 16 : slots.size();
+        while (n * 4 > cap * 3) cap *= 2;
+        if (cap != slots.size()) rehash(cap);
+    }
+
+    void eraseSlot(std::size_t hole) {
+        const std::size_t mask = slots.size() - 1;
+        const std::size_t pos = slots[hole].pos1 - 1;
+        for (std::size_t j = (hole + 1) & mask; slots[j].pos1 != 0; j = (j + 1) & mask) {
+            const std::size_t home = slots[j].hash & mask;
+            // j puede ocupar el hueco si éste queda entre su ranura ideal y j
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = Slot{};
+        dense[pos].reset();
+        freeList.push_back(static_cast<std::uint32_t>(pos));
+        --live;
+    }
+
+    template <bool Const>
+    class Iter {
+        using Owner = std::conditional_t<Const, const FlatTable, FlatTable>;
+        Owner* t{nullptr};
+        std::size_t pos{0};
+        void skip() { while (pos < t->dense.size() && !t->dense[pos]) ++pos; }
+        friend class FlatTable;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = FlatTable::value_type;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer           = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iter() = default;
+        Iter(Owner* owner, std::size_t p) : t(owner), pos(p) { skip(); }
+        operator Iter<true>() const { return Iter<true>(t, pos); }
+
+        reference operator*() const { return *t->dense[pos]; }
+        pointer operator->() const { return &*t->dense[pos]; }
+        Iter& operator++() { ++pos; skip(); return *this; }
+        Iter operator++(int) { Iter tmp = *this; ++*this; return tmp; }
+        friend bool operator==(const Iter& a, const Iter& b) { return a.pos == b.pos; }
+    };
+
+public:
+    using iterator       = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    explicit FlatTable(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : slots(mr), dense(mr), freeList(mr) {}
+    FlatTable(const FlatTable&) = default;
+    FlatTable(FlatTable&&) = default;
+    // Las claves de `dense` son const: se copia reconstruyendo cada entrada en
+    // su misma posición (los handles no cambian) y con el recurso propio
+    FlatTable& operator=(const FlatTable& o) {
+        if (this == &o) return *this;
+        slots = o.slots;
+        freeList = o.freeList;
+        live = o.live;
+        dense.clear();
+        for (const auto& e : o.dense) dense.emplace_back(e);
+        return *this;
+    }
+
+    V& operator[](std::string_view k) { return try_emplace(k).first->second; }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(std::string_view k, Args&&... args) {
+        const std::uint32_t h = hashOf(k);
+        if (std::size_t i = probe(k, h); i != npos) return {iterator(this, slots[i].pos1 - 1), false};
+        growFor(live + 1);
+
+        std::size_t pos;
+        if (!freeList.empty()) {
+            pos = freeList.back();
+            freeList.pop_back();
+            dense[pos].emplace(std::piecewise_construct, std::forward_as_tuple(k),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+        } else {
+            pos = dense.size();
+            dense.emplace_back(std::in_place, std::piecewise_construct, std::forward_as_tuple(k),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+        place(Slot{static_cast<std::uint32_t>(pos + 1), h});
+        ++live;
+        return {iterator(this, pos), true};
+    }
+
+    template <class... Args>
+    std::pair<Handle, bool> tryEmplaceHandle(std::string_view k, Args&&... args) {
+        auto [it, inserted] = try_emplace(k, std::forward<Args>(args)...);
+        return {static_cast<Handle>(it.pos), inserted};
+    }
+    Handle handleOf(std::string_view k) const {
+        const std::size_t i = probe(k, hashOf(k));
+        return i == npos ? kNoHandle : slots[i].pos1 - 1;
+    }
+    V& byHandle(Handle h) { return dense[h]->second; }
+    const V& byHandle(Handle h) const { return dense[h]->second; }
+    const std::string& keyOf(Handle h) const { return dense[h]->first; }
+
+    V& at(std::string_view k) {
+        const std::size_t i = probe(k, hashOf(k));
+        if (i == npos) throw std::out_of_range("FlatTable::at");
+        return dense[slots[i].pos1 - 1]->second;
+    }
+    const V& at(std::string_view k) const {
+        const std::size_t i = probe(k, hashOf(k));
+        if (i == npos) throw std::out_of_range("FlatTable::at");
+        return dense[slots[i].pos1 - 1]->second;
+    }
+
+    iterator find(std::string_view k) {
+        const std::size_t i = probe(k, hashOf(k));
+        return i == npos ? end() : iterator(this, slots[i].pos1 - 1);
+    }
+    const_iterator find(std::string_view k) const {
+        const std::size_t i = probe(k, hashOf(k));
+        return i == npos ? end() : const_iterator(this, slots[i].pos1 - 1);
+    }
+    std::size_t count(std::string_view k) const { return probe(k, hashOf(k)) != npos ? 1 : 0; }
+    bool contains(std::string_view k) const { return probe(k, hashOf(k)) != npos; }
+
+    std::size_t erase(std::string_view k) {
+        const std::size_t i = probe(k, hashOf(k));
+        if (i == npos) return 0;
+        eraseSlot(i);
+        return 1;
+    }
+    iterator erase(iterator it) {
+        const std::size_t pos = it.pos;
+        erase(std::string_view(dense[pos]->first));
+        return iterator(this, pos + 1);
+    }
+
+    std::size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+    void clear() {
+        slots.clear();
+        dense.clear();
+        freeList.clear();
+        live = 0;
+    }
+    void reserve(std::size_t n) { growFor(n); }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, dense.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, dense.size()); }
+};
+
+static_assert(KeyedTable<MapTable<int>>);
+static_assert(KeyedTable<FlatTable<int>>);
+
+// Motor de almacenamiento de MemoryDb (elegido en compilación, ver BIBLIOTECA_STORAGE)
+#if defined(LIB_STORAGE_MAP)
+template <class V> using Table = MapTable<V>;
+#else
+template <class V> using Table = FlatTable<V>;
+#endif
+
+// Tabla con handles tipados: H es un enum class sobre Handle (BookHandle, ...),
+// así no se pueden mezclar handles de tablas distintas.
+template <class V, class H>
+class HandleTable : public Table<V> {
+    using Base = Table<V>;
+public:
+    using handle_type = H;
+    using Base::Base;
+    using Base::operator[];
+
+    std::optional<H> lookup(std::string_view k) const {
+        const Handle h = Base::handleOf(k);
+        if (h == kNoHandle) return std::nullopt;
+        return H{h};
+    }
+    V& operator[](H h) { return Base::byHandle(static_cast<Handle>(h)); }
+    const V& operator[](H h) const { return Base::byHandle(static_cast<Handle>(h)); }
+    const std::string& idOf(H h) const { return Base::keyOf(static_cast<Handle>(h)); }
+
+    template <class... Args>
+    std::pair<H, bool> add(std::string_view k, Args&&... args) {
+        auto [h, inserted] = Base::tryEmplaceHandle(k, std::forward<Args>(args)...);
+        return {H{h}, inserted};
+    }
+};
+
+} // namespace lib
@@ -0,0 +1,142 @@
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace lib {
+
+// Tarea de corrutina diferida (C++20): no empieza hasta que se la espera con
+// co_await, syncWait() o spawn(). Al terminar reanuda a quien la esperaba por
+// transferencia simétrica, en el hilo en que termina. Las excepciones que
+// escapan de la corrutina se relanzan en el co_await.
+template <class T = void>
+class [[nodiscard]] Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation{std::noop_coroutine()};
+    std::exception_ptr error;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <class P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) const noexcept {
+            return h.promise().continuation;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <class T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+    template <class U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+    T take() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    void return_void() const noexcept {}
+    void take() const {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+// Corrutina que arranca en el acto y se libera sola al acabar (base de
+// syncWait y spawn)
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+template <class T>
+class [[nodiscard]] Task {
+public:
+    struct promise_type : detail::TaskPromise<T> {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    Task(Task&& o) noexcept : h(std::exchange(o.h, {})) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o) {
+            if (h) h.destroy();
+            h = std::exchange(o.h, {});
+        }
+        return *this;
+    }
+    ~Task() {
+        if (h) h.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        h.promise().continuation = awaiting;
+        return h;
+    }
+    T await_resume() { return h.promise().take(); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : h(h) {}
+    std::coroutine_handle<promise_type> h;
+};
+
+// Ejecuta la tarea y bloquea el hilo hasta que termine (tests, main, puentes
+// con código síncrono). Relanza su excepción.
+template <class T>
+T syncWait(Task<T> task) {
+    std::mutex mu;
+    std::condition_variable cv;
+    bool done = false;
+    std::exception_ptr error;
+    std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> out;
+    // Se avisa con el candado tomado: cuando este hilo sigue, la corrutina ya
+    // no toca nada de este marco
+    [](Task<T> t, auto& mu, auto& cv, bool& done, auto& out, std::exception_ptr& error) -> detail::Detached {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                co_await std::move(t);
+                out.emplace(true);
+            } else {
+                out.emplace(co_await std::move(t));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard lk(mu);
+        done = true;
+        cv.notify_one();
+    }(std::move(task), mu, cv, done, out, error);
+
+    std::unique_lock lk(mu);
+    cv.wait(lk, [&] { return done; });
+    if (error) std::rethrow_exception(error);
+    if constexpr (!std::is_void_v<T>) return std::move(*out);
+}
+
+// Arranca la tarea sin esperarla; su marco se libera al terminar. Una
+// excepción que escape de ella llama a std::terminate.
+inline void spawn(Task<> task) {
+    [](Task<> t) -> detail::Detached { co_await std::move(t); }(std::move(task));
+}
+
+} // namespace lib
@@ -0,0 +1,120 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "library.hpp"
+
+namespace lib {
+
+// --- Write-ahead log de LibraryService ---
+// Fichero de sólo anexado: cabecera | registro | registro | ...
+// Cada registro: longitud (u32) | crc32 del cuerpo (u32) | cuerpo
+//   cuerpo: op (u8) | día (i32) | loanId, itemId, readerId (u16 longitud + bytes)
+// Un registro incompleto o con CRC erróneo marca el final del log (escritura
+// interrumpida por una caída): se descarta él y lo que le siga.
+
+inline constexpr std::uint32_t kWalVersion = 1;
+
+struct WalRecord {
+    using Op = LogOp;
+    Op op;
+    std::chrono::sys_days day;
+    std::string loanId;
+    std::string itemId;   // copyId o bookId (originales)
+    std::string readerId; // vacío en ReturnCopy
+};
+
+// Group commit: append() sólo copia el registro a un buffer en memoria y
+// devuelve un ticket; commit(ticket) espera a que sea durable. El primer hilo
+// que llega a commit escribe y sincroniza todo lo acumulado (un solo fsync)
+// mientras el resto espera, así N llamadas concurrentes comparten el flush.
+class WriteAheadLog {
+public:
+    using Ticket = WalTicket;
+
+    struct Options {
+        bool sync{true}; // fsync en cada commit; false sólo para pruebas/bench
+    };
+
+    struct Stats {
+        std::uint64_t records{0};
+        std::uint64_t syncs{0};   // flushes al fichero (cada uno cubre un grupo)
+        std::uint64_t bytes{0};
+    };
+
+    // Abre (o crea) el log para anexar. Si el final está roto lo recorta al
+    // último registro válido, así lo nuevo no queda detrás de basura.
+    explicit WriteAheadLog(const std::string& path);
+    WriteAheadLog(const std::string& path, Options opts);
+    ~WriteAheadLog(); // sincroniza lo pendiente
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Lo que append() rechazaría, sin anexar nada: WAL_WRITE_FAILED si una
+    // escritura anterior falló, WAL_RECORD_TOO_LARGE si algún ID no cabe. El
+    // servicio lo consulta antes de mutar, así un rechazo no cambia su estado.
+    Expected<void> check(std::string_view loanId, std::string_view itemId, std::string_view readerId) const;
+    // Un registro demasiado grande lanza WAL_RECORD_TOO_LARGE sin tocar el
+    // buffer. Con el log roto no lanza: devuelve un ticket que commit() rechaza.
+    Ticket append(WalRecord::Op op, std::chrono::sys_days day, std::string_view loanId,
+                  std::string_view itemId, std::string_view readerId);
+    // Bloquea hasta que el registro `t` (y todos los anteriores) estén en disco
+    void commit(Ticket t);
+    // Hace durable todo lo anexado hasta ahora
+    void sync();
+    // Vacía el log (tras un checkpoint). No debe haber append() concurrentes.
+    void truncate();
+
+    Stats stats() const;
+
+private:
+    struct File;
+    std::string path;
+    Options opts;
+    std::unique_ptr<File> file;
+
+    mutable std::mutex mu;
+    std::condition_variable cv;
+    std::vector<char> buffer, spare; // registros aún no escritos / buffer reciclado
+    Ticket appended{0};
+    Ticket durable{0};
+    bool flushing{false}; // hay un líder escribiendo fuera del candado
+    bool broken{false};   // falló una escritura: el log ya no es fiable
+    Stats st;
+
+    void flushLocked(std::unique_lock<std::mutex>& lk);
+};
+
+struct WalScan {
+    std::size_t records{0};
+    std::uint64_t validBytes{0};     // hasta el último registro íntegro
+    std::uint64_t discardedBytes{0}; // cola rota (escritura interrumpida)
+};
+
+// Recorre los registros válidos de `path` en orden
+WalScan readWal(const std::string& path, FunctionRef<void(const WalRecord&)> fn);
+
+struct RecoveryReport {
+    bool snapshotLoaded{false};
+    std::size_t applied{0};
+    std::size_t skipped{0};          // ya incluidos en el snapshot
+    std::uint64_t discardedBytes{0};
+};
+
+// Recuperación tras una caída: carga el snapshot (si existe; `db` debe estar
+// vacío) y reaplica el WAL encima. Sin snapshot, `db` ya debe tener el
+// catálogo. Reaplicar es idempotente, así que un checkpoint interrumpido
+// entre el snapshot y el vaciado del log no duplica operaciones.
+// El log guarda el día de cada operación, no su vencimiento ni la sanción:
+// se reaplica con `rules`, que deben ser las del servicio que lo escribió
+// (RuntimeLoanPolicy::of(svc.policy())); por defecto, las de DefaultLoanPolicy.
+RecoveryReport recover(MemoryDb& db, const std::string& snapshotPath, const std::string& walPath,
+                       RuntimeLoanPolicy rules = RuntimeLoanPolicy{});
+
+} // namespace lib
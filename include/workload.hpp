@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "library.hpp"
+
+namespace lib {
+
+// --- Carga sintética para perfilado y planificación de capacidad ---
+
+struct WorkloadConfig {
+    std::size_t books{1000};
+    std::size_t copiesPerBook{4};
+    std::size_t readers{5000};
+    std::size_t events{100000};
+    double zipfS{1.0};                  // popularidad de libros (Zipf, rango 1 = más pedido)
+    double newReleaseFraction{0.01};    // libros “nuevos sin copias” (se presta el original)
+    double lateReturnProb{0.05};        // devoluciones tardías
+    int maxLateDays{20};
+    double bannedReaderFraction{0.01};  // lectores que empiezan baneados
+    int days{365};                      // días simulados que cubre el flujo
+    std::chrono::sys_days start{makeDate(2025, 1, 1)};
+    std::uint64_t seed{42};
+};
+
+struct WorkloadEvent {
+    enum class Op : std::uint8_t { Borrow, Return, BorrowOriginal, ReturnOriginal };
+    Op op;
+    std::string itemId;   // copyId (Borrow/Return) o bookId (originales)
+    std::string readerId; // vacío en Return
+    std::chrono::sys_days day;
+    bool expectOk{true};  // resultado en la simulación de referencia (un hilo)
+};
+
+// Rellena `db` con el catálogo y los lectores de `cfg` (determinista según seed)
+void populateWorkload(MemoryDb& db, const WorkloadConfig& cfg);
+
+// Genera el flujo de eventos en orden cronológico. Se simula contra un
+// LibraryService propio, así que los préstamos rechazados (tope de 3, baneo,
+// original ya prestado, copia ocupada) aparecen igual que en tráfico real.
+std::vector<WorkloadEvent> generateWorkload(const WorkloadConfig& cfg);
+
+struct OpStats {
+    std::uint64_t count{0};
+    std::uint64_t errors{0};
+    std::chrono::nanoseconds p50{0}, p99{0}, p999{0}, max{0};
+};
+
+struct ReplayReport {
+    unsigned threads{1};
+    std::chrono::nanoseconds wall{0};
+    OpStats perOp[4];     // indexado por WorkloadEvent::Op
+    std::uint64_t mismatches{0}; // resultado distinto de expectOk
+    double throughput() const; // operaciones por segundo
+};
+
+// Reproduce `events` contra `svc`. Con varios hilos cada evento va al hilo de
+// su copia/libro, así se conserva el orden préstamo -> devolución por ítem.
+ReplayReport replayWorkload(LibraryService& svc, std::span<const WorkloadEvent> events, unsigned threads = 1);
+
+const char* opName(WorkloadEvent::Op op);
+
+} // namespace lib
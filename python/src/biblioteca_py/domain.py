@@ -10,6 +10,7 @@ class CopyStatus:
     RESERVED = "RESERVED"
     LATE = "LATE"
     REPAIR = "REPAIR"
+    TRANSFERRED = "TRANSFERRED"
 
 @dataclass
 class Author:
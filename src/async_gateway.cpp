@@ -0,0 +1,178 @@
+#include "async_gateway.hpp"
+#include <algorithm>
+
+namespace lib {
+
+AsyncEmailGateway::AsyncEmailGateway(NotificationGateway& inner)
+    : AsyncEmailGateway(inner, Options{}) {}
+
+AsyncEmailGateway::AsyncEmailGateway(NotificationGateway& inner, Options o)
+    : inner(inner), opts(o) {
+    if (opts.capacity == 0) opts.capacity = 1;
+    if (opts.maxBatch == 0) opts.maxBatch = 1;
+    if (opts.workers == 0) opts.workers = 1;
+    workers.reserve(opts.workers);
+    for (unsigned i = 0; i < opts.workers; ++i) workers.emplace_back([this]{ workerLoop(); });
+}
+
+AsyncEmailGateway::~AsyncEmailGateway() { stop(); }
+
+void AsyncEmailGateway::sendEmail(const std::string& to, const std::string& subject, const std::string& body) {
+    std::unique_lock lk(mu);
+    enqueueLocked(lk, EmailView{to, subject, body});
+    lk.unlock();
+    notEmpty.notify_one();
+}
+
+void AsyncEmailGateway::sendEmails(std::span<const EmailView> batch) {
+    std::unique_lock lk(mu);
+    for (auto& m : batch) enqueueLocked(lk, m);
+    lk.unlock();
+    notEmpty.notify_all();
+}
+
+// Con Block puede soltar el candado mientras espera hueco
+void AsyncEmailGateway::enqueueLocked(std::unique_lock<std::mutex>& lk, EmailView msg) {
+    if (stopping) { ++st.dropped; return; }
+    if (queue.size() >= opts.capacity) {
+        switch (opts.overflow) {
+        case OverflowPolicy::Block:
+            notEmpty.notify_all(); // que los workers avancen mientras esperamos
+            notFull.wait(lk, [&]{ return stopping || queue.size() < opts.capacity; });
+            if (stopping) { ++st.dropped; return; }
+            break;
+        case OverflowPolicy::DropNewest:
+            ++st.dropped;
+            return;
+        case OverflowPolicy::DropOldest:
+            queue.pop_front();
+            ++st.dropped;
+            break;
+        }
+    }
+    queue.push_back(EmailMessage{std::string(msg.to), std::string(msg.subject), std::string(msg.body)});
+    ++st.enqueued;
+}
+
+void AsyncEmailGateway::workerLoop() {
+    std::vector<EmailMessage> batch;
+    std::vector<EmailView> views;
+    batch.reserve(opts.maxBatch);
+    views.reserve(opts.maxBatch);
+    std::unique_lock lk(mu);
+    for (;;) {
+        notEmpty.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (queue.empty()) return; // stopping y sin pendientes
+
+        const std::size_t n = std::min(opts.maxBatch, queue.size());
+        for (std::size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        inFlight += n;
+        lk.unlock();
+        notFull.notify_all();
+
+        std::uint64_t failed = 0;
+        for (auto& m : batch) views.push_back(m.view());
+        try { inner.sendEmails(views); }
+        catch (...) { failed = n; }
+        views.clear();
+        batch.clear();
+
+        lk.lock();
+        inFlight -= n;
+        st.sent += n - failed;
+        st.failed += failed;
+        ++st.batches;
+        if (queue.empty() && inFlight == 0) idle.notify_all();
+    }
+}
+
+void AsyncEmailGateway::flush() {
+    std::unique_lock lk(mu);
+    idle.wait(lk, [&]{ return queue.empty() && inFlight == 0; });
+}
+
+void AsyncEmailGateway::stop() {
+    {
+        std::lock_guard lk(mu);
+        if (stopping) return;
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    notFull.notify_all();
+    for (auto& t : workers) t.join();
+    workers.clear();
+}
+
+AsyncEmailGateway::Stats AsyncEmailGateway::stats() const {
+    std::lock_guard lk(mu);
+    return st;
+}
+
+std::size_t AsyncEmailGateway::pending() const {
+    std::lock_guard lk(mu);
+    return queue.size() + inFlight;
+}
+
+// ----- AsyncGatewayAdapter -----
+AsyncGatewayAdapter::AsyncGatewayAdapter(NotificationGateway& inner, unsigned n) : inner(inner) {
+    if (n == 0) n = 1;
+    workers.reserve(n);
+    for (unsigned i = 0; i < n; ++i) workers.emplace_back([this]{ workerLoop(); });
+}
+
+AsyncGatewayAdapter::~AsyncGatewayAdapter() { stop(); }
+
+void AsyncGatewayAdapter::sendEmailsAsync(std::span<const EmailView> batch, SendCompletion done) {
+    bool accepted = false;
+    {
+        std::lock_guard lk(mu);
+        if (!stopping) {
+            queue.push_back(Job{batch, done});
+            ++inFlight;
+            accepted = true;
+        }
+    }
+    if (!accepted) { done(false); return; }
+    notEmpty.notify_one();
+}
+
+void AsyncGatewayAdapter::workerLoop() {
+    std::unique_lock lk(mu);
+    for (;;) {
+        notEmpty.wait(lk, [&]{ return stopping || !queue.empty(); });
+        if (queue.empty()) return; // stopping y sin pendientes
+        const Job job = queue.front();
+        queue.pop_front();
+        lk.unlock();
+
+        bool ok = true;
+        try { inner.sendEmails(job.batch); }
+        catch (...) { ok = false; }
+        // Aquí puede reanudarse quien esperaba: sin el candado tomado
+        job.done(ok);
+
+        lk.lock();
+        --inFlight;
+    }
+}
+
+void AsyncGatewayAdapter::stop() {
+    {
+        std::lock_guard lk(mu);
+        if (stopping) return;
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    for (auto& t : workers) t.join();
+    workers.clear();
+}
+
+std::size_t AsyncGatewayAdapter::pending() const {
+    std::lock_guard lk(mu);
+    return inFlight;
+}
+
+} // namespace lib
@@ -0,0 +1,32 @@
+#include "library.hpp"
+#include <algorithm>
+
+namespace lib {
+
+void BanWheel::add(ReaderHandle reader, std::chrono::sys_days until) {
+    // Un baneo que ya terminó respecto al cursor va al hueco del cursor: sale
+    // en el próximo avance en vez de esperar una vuelta entera
+    slots[slotOf(std::max(until, cursor))].push_back({reader, until});
+    live.insert(reader);
+}
+
+void BanWheel::collectExpired(std::chrono::sys_days today, std::vector<Entry>& out) {
+    if (today <= cursor) return;
+    // Los días [cursor, today) caen en a lo sumo kSlots huecos distintos
+    const auto span = std::min<std::size_t>(static_cast<std::size_t>((today - cursor).count()), kSlots);
+    for (std::size_t i = 0; i < span; ++i) {
+        auto& slot = slots[slotOf(cursor + std::chrono::days(i))];
+        const auto keep = std::partition(slot.begin(), slot.end(), [&](const Entry& e) { return e.until >= today; });
+        out.insert(out.end(), keep, slot.end());
+        slot.erase(keep, slot.end());
+    }
+    cursor = today;
+}
+
+void BanWheel::clear() {
+    for (auto& slot : slots) slot.clear();
+    live.clear();
+    cursor = {};
+}
+
+} // namespace lib
@@ -0,0 +1,368 @@
+#include "bulk_import.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <fstream>
+#include <future>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace lib {
+
+const char* importIssueCode(ImportIssue issue) {
+    switch (issue) {
+    case ImportIssue::Malformed:   return "MALFORMED_RECORD";
+    case ImportIssue::BadNumber:   return "BAD_NUMBER";
+    case ImportIssue::BadDate:     return "BAD_DATE";
+    case ImportIssue::BadStatus:   return "BAD_STATUS";
+    case ImportIssue::DuplicateId: return "DUPLICATE_ID";
+    case ImportIssue::UnknownBook: return "UNKNOWN_BOOK";
+    }
+    return "UNKNOWN";
+}
+
+namespace {
+
+constexpr std::size_t npos = std::string_view::npos;
+
+// Campo como vista sobre el buffer; `escaped` si lleva "" que hay que deshacer
+struct Field {
+    std::string_view text;
+    bool escaped{false};
+};
+
+std::string toString(Field f) {
+    if (!f.escaped) return std::string(f.text);
+    std::string s;
+    s.reserve(f.text.size());
+    for (std::size_t i = 0; i < f.text.size(); ++i) {
+        s.push_back(f.text[i]);
+        if (f.text[i] == '"') ++i; // "" -> "
+    }
+    return s;
+}
+
+// Parte una línea en campos; devuelve cuántos, o npos si trae más de N o
+// unas comillas sin cerrar
+template <std::size_t N>
+std::size_t splitFields(std::string_view line, std::array<Field, N>& out) {
+    std::size_t n = 0, i = 0;
+    for (;;) {
+        if (n == N) return npos;
+        Field& f = out[n++];
+        if (i < line.size() && line[i] == '"') {
+            std::size_t j = ++i;
+            f.escaped = false;
+            for (;; j += 2) {
+                j = line.find('"', j);
+                if (j == npos) return npos;
+                if (j + 1 >= line.size() || line[j + 1] != '"') break;
+                f.escaped = true;
+            }
+            f.text = line.substr(i, j - i);
+            i = j + 1;
+            if (i == line.size()) return n;
+            if (line[i] != ',') return npos;
+            ++i;
+        } else {
+            const std::size_t j = line.find(',', i);
+            f = {line.substr(i, j == npos ? npos : j - i), false};
+            if (j == npos) return n;
+            i = j + 1;
+        }
+    }
+}
+
+std::optional<int> parseInt(std::string_view s) {
+    int v = 0;
+    const auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc{} || p != s.data() + s.size()) return std::nullopt;
+    return v;
+}
+
+// YYYY-MM-DD
+std::optional<std::chrono::sys_days> parseDate(std::string_view s) {
+    if (s.size() != 10 || s[4] != '-' || s[7] != '-') return std::nullopt;
+    const auto y = parseInt(s.substr(0, 4)), m = parseInt(s.substr(5, 2)), d = parseInt(s.substr(8, 2));
+    if (!y || !m || !d) return std::nullopt;
+    const std::chrono::year_month_day ymd{std::chrono::year{*y}, std::chrono::month(unsigned(*m)),
+                                          std::chrono::day(unsigned(*d))};
+    if (!ymd.ok()) return std::nullopt;
+    return std::chrono::sys_days{ymd};
+}
+
+std::optional<CopyStatus> parseStatus(std::string_view s) {
+    static constexpr std::array<std::string_view, kCopyStatusCount> names{
+        "IN_LIBRARY", "LOANED", "RESERVED", "LATE", "REPAIR", "TRANSFERRED"};
+    for (std::size_t i = 0; i < names.size(); ++i)
+        if (s == names[i]) return static_cast<CopyStatus>(i);
+    return std::nullopt;
+}
+
+// --- Registros analizados (vistas sobre el bloque) ---
+struct BookRec {
+    Field id, title, author, birth, edition;
+    int year{};
+    bool newRelease{false};
+    std::size_t line{0};
+};
+struct ReaderRec {
+    Field id, email;
+    std::optional<std::chrono::sys_days> ban;
+    std::size_t line{0};
+};
+struct CopyRec {
+    Field id, book;
+    CopyStatus status{CopyStatus::IN_LIBRARY};
+    std::size_t line{0};
+};
+
+// Cada función devuelve el problema de la línea, o nullopt si vale
+std::optional<ImportIssue> parseBook(std::string_view line, BookRec& r) {
+    std::array<Field, 7> f;
+    if (splitFields(line, f) != f.size()) return ImportIssue::Malformed;
+    const auto year = parseInt(f[2].text);
+    if (!year) return ImportIssue::BadNumber;
+    const std::string_view nr = f[6].text;
+    if (nr != "0" && nr != "1" && nr != "true" && nr != "false") return ImportIssue::BadNumber;
+    r = {f[0], f[1], f[3], f[4], f[5], *year, nr == "1" || nr == "true"};
+    return std::nullopt;
+}
+
+std::optional<ImportIssue> parseReader(std::string_view line, ReaderRec& r) {
+    std::array<Field, 3> f;
+    const std::size_t n = splitFields(line, f);
+    if (n != 2 && n != 3) return ImportIssue::Malformed;
+    r = {f[0], f[1], std::nullopt};
+    if (n == 3 && !f[2].text.empty()) {
+        r.ban = parseDate(f[2].text);
+        if (!r.ban) return ImportIssue::BadDate;
+    }
+    return std::nullopt;
+}
+
+std::optional<ImportIssue> parseCopy(std::string_view line, CopyRec& r) {
+    std::array<Field, 3> f;
+    const std::size_t n = splitFields(line, f);
+    if (n != 2 && n != 3) return ImportIssue::Malformed;
+    r = {f[0], f[1]};
+    if (n == 3 && !f[2].text.empty()) {
+        const auto s = parseStatus(f[2].text);
+        // Una copia prestada necesita su préstamo: no se importa así
+        if (!s || *s == CopyStatus::LOANED || *s == CopyStatus::LATE) return ImportIssue::BadStatus;
+        r.status = *s;
+    }
+    return std::nullopt;
+}
+
+// --- Análisis por bloques ---
+template <class Rec>
+struct Parsed {
+    std::vector<Rec> recs;
+    std::vector<std::pair<std::size_t, ImportIssue>> bad; // línea, problema
+    std::size_t lines{0};
+};
+
+// Líneas numeradas desde 0 dentro del trozo; parseBlock las desplaza
+template <class Rec, class Parse>
+Parsed<Rec> parseRange(std::string_view text, Parse parse) {
+    Parsed<Rec> p;
+    p.recs.reserve(static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n')) + 1);
+    while (!text.empty()) {
+        const std::size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == npos ? text.size() : nl + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) {
+            Rec r{};
+            if (const auto issue = parse(line, r)) {
+                p.bad.emplace_back(p.lines, *issue);
+            } else {
+                r.line = p.lines;
+                p.recs.push_back(r);
+            }
+        }
+        ++p.lines;
+    }
+    return p;
+}
+
+// Parte el bloque en trozos alineados a fin de línea y los analiza en paralelo
+template <class Rec, class Parse>
+Parsed<Rec> parseBlock(std::string_view block, std::size_t firstLine, unsigned threads, Parse parse) {
+    constexpr std::size_t kMinChunk = 64u << 10; // por debajo no compensa lanzar hilos
+    const std::size_t parts = std::clamp<std::size_t>(block.size() / kMinChunk, 1, threads);
+    std::vector<std::string_view> chunks;
+    for (std::size_t i = 0, from = 0; i < parts; ++i) {
+        std::size_t to = i + 1 == parts ? block.size() : std::max(from, block.size() * (i + 1) / parts);
+        if (to < block.size()) {
+            const std::size_t nl = block.find('\n', to);
+            to = nl == npos ? block.size() : nl + 1;
+        }
+        chunks.push_back(block.substr(from, to - from));
+        from = to;
+    }
+    std::vector<Parsed<Rec>> out(chunks.size());
+    {
+        std::vector<std::jthread> ts;
+        for (std::size_t i = 1; i < chunks.size(); ++i)
+            ts.emplace_back([&, i] { out[i] = parseRange<Rec>(chunks[i], parse); });
+        out[0] = parseRange<Rec>(chunks[0], parse);
+    }
+
+    Parsed<Rec> all = std::move(out[0]);
+    std::size_t base = 0;
+    for (std::size_t i = 1; i < out.size(); ++i) {
+        base += out[i - 1].lines;
+        for (Rec& r : out[i].recs) { r.line += base; all.recs.push_back(r); }
+        for (auto& [l, issue] : out[i].bad) all.bad.emplace_back(l + base, issue);
+    }
+    all.lines = base + out.back().lines;
+    for (Rec& r : all.recs) r.line += firstLine;
+    for (auto& b : all.bad) b.first += firstLine;
+    return all;
+}
+
+// Lee unos `bytes` más lo que sobró del bloque anterior y corta tras el último
+// fin de línea; el resto queda en `carry`. false si ya no queda nada.
+bool readBlock(std::istream& in, std::string& buf, std::string& carry, std::size_t bytes) {
+    buf.swap(carry);
+    carry.clear();
+    while (in) {
+        const std::size_t old = buf.size();
+        buf.resize(old + bytes);
+        in.read(buf.data() + old, static_cast<std::streamsize>(bytes));
+        buf.resize(old + static_cast<std::size_t>(in.gcount()));
+        const std::size_t nl = buf.rfind('\n');
+        if (!in) break; // fin del flujo: el bloque se queda con todo
+        if (nl != npos) {
+            carry.assign(buf, nl + 1);
+            buf.resize(nl + 1);
+            break;
+        }
+        // Una línea más larga que el bloque: se sigue leyendo
+    }
+    return !buf.empty();
+}
+
+// Bytes que quedan en el flujo, si se puede saber (ficheros)
+std::optional<std::size_t> remainingBytes(std::istream& in) {
+    const auto pos = in.tellg();
+    if (pos == std::streampos(-1)) return std::nullopt;
+    in.seekg(0, std::ios::end);
+    const auto end = in.tellg();
+    in.seekg(pos);
+    if (end == std::streampos(-1) || end < pos) return std::nullopt;
+    return static_cast<std::size_t>(end - pos);
+}
+
+} // namespace
+
+BulkImporter::BulkImporter(MemoryDb& db, ImportOptions opts) : db(db), opts(opts) {
+    if (this->opts.blockBytes == 0) throw std::invalid_argument("ImportOptions: blockBytes == 0");
+}
+
+void BulkImporter::reject(ImportTable table, std::size_t line, ImportIssue issue) {
+    ++rep.rejected;
+    if (rep.errors.size() < opts.maxErrors) rep.errors.push_back({table, line, issue});
+}
+
+// Un bloque se analiza (en paralelo) mientras el llamador inserta el anterior
+template <class Rec, class Parse, class Insert>
+void BulkImporter::run(std::istream& in, ImportTable table, std::size_t expected, Parse parse, Insert insert) {
+    const unsigned threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::size_t line = 1;
+    if (std::string header; opts.header && std::getline(in, header)) ++line;
+    const auto remaining = remainingBytes(in);
+
+    std::string bufs[2], carry;
+    std::size_t cur = 0;
+    if (!readBlock(in, bufs[cur], carry, opts.blockBytes)) return;
+    auto parseAt = [&](std::string_view text, std::size_t first) {
+        return parseBlock<Rec>(text, first, threads, parse);
+    };
+    Parsed<Rec> parsed = parseAt(bufs[cur], line);
+
+    // Tamaño final estimado con la densidad de líneas del primer bloque
+    if (expected == 0 && remaining) expected = *remaining / bufs[cur].size() * parsed.lines +
+                                               *remaining % bufs[cur].size() * parsed.lines / bufs[cur].size();
+    switch (table) {
+    case ImportTable::Books:   db.books.reserve(db.books.size() + expected); break;
+    case ImportTable::Readers: db.readers.reserve(db.readers.size() + expected); break;
+    case ImportTable::Copies:
+        db.copies.reserve(db.copies.size() + expected);
+        db.copyStates.reserve(db.copies.size() + expected);
+        break;
+    }
+
+    for (;;) {
+        line += parsed.lines;
+        const std::size_t next = 1 - cur;
+        const bool more = readBlock(in, bufs[next], carry, opts.blockBytes);
+        std::future<Parsed<Rec>> ahead;
+        if (more) ahead = std::async(std::launch::async, parseAt, std::string_view(bufs[next]), line);
+
+        for (auto& [l, issue] : parsed.bad) reject(table, l, issue);
+        for (Rec& r : parsed.recs)
+            if (const auto issue = insert(r)) reject(table, r.line, *issue);
+        if (!more) break;
+        parsed = ahead.get();
+        cur = next;
+    }
+}
+
+void BulkImporter::importBooks(std::istream& in, std::size_t expected) {
+    run<BookRec>(in, ImportTable::Books, expected, parseBook, [&](BookRec& r) -> std::optional<ImportIssue> {
+        std::string id = toString(r.id);
+        Book b{id, toString(r.title), r.year, Author{toString(r.author), toString(r.birth)}, toString(r.edition),
+               r.newRelease};
+        if (!db.books.add(id, std::move(b)).second) return ImportIssue::DuplicateId;
+        ++rep.books;
+        return std::nullopt;
+    });
+}
+
+void BulkImporter::importReaders(std::istream& in, std::size_t expected) {
+    run<ReaderRec>(in, ImportTable::Readers, expected, parseReader, [&](ReaderRec& r) -> std::optional<ImportIssue> {
+        std::string id = toString(r.id);
+        const auto [h, inserted] = db.readers.add(id, Reader{id, toString(r.email), r.ban, {}});
+        if (!inserted) return ImportIssue::DuplicateId;
+        if (r.ban) db.bans.add(h, *r.ban);
+        ++rep.readers;
+        return std::nullopt;
+    });
+}
+
+void BulkImporter::importCopies(std::istream& in, std::size_t expected) {
+    run<CopyRec>(in, ImportTable::Copies, expected, parseCopy, [&](CopyRec& r) -> std::optional<ImportIssue> {
+        std::string book = toString(r.book);
+        if (!db.books.contains(book)) return ImportIssue::UnknownBook;
+        std::string id = toString(r.id);
+        const auto [h, inserted] = db.copies.add(id, Copy{id, std::move(book), r.status});
+        if (!inserted) return ImportIssue::DuplicateId;
+        db.trackCopy(h);
+        ++rep.copies;
+        return std::nullopt;
+    });
+}
+
+ImportReport importCatalog(MemoryDb& db, const std::string& booksPath, const std::string& readersPath,
+                           const std::string& copiesPath, const ImportOptions& opts) {
+    auto open = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("IMPORT_NOT_FOUND");
+        return in;
+    };
+    std::ifstream books = open(booksPath), readers = open(readersPath), copies = open(copiesPath);
+    BulkImporter importer(db, opts);
+    importer.importBooks(books);
+    importer.importReaders(readers);
+    importer.importCopies(copies);
+    return importer.report();
+}
+
+} // namespace lib
@@ -0,0 +1,76 @@
+#include "copy_states.hpp"
+#include <algorithm>
+
+namespace lib {
+
+namespace {
+// Los recuentos van por bloques de tamaño fijo con acumuladores de un byte
+// (240 < 256 no desborda): con el número de vueltas conocido, -O2 ya
+// vectoriza el bucle interno. La cola, menos de un bloque, va byte a byte.
+constexpr std::size_t kBlock = 240;
+} // namespace
+
+void CopyStateTable::track(CopyHandle h, BookHandle book, CopyStatus s) {
+    const auto i = static_cast<std::size_t>(h);
+    if (i >= states.size()) {
+        states.resize(i + 1, kUntracked);
+        books.resize(i + 1, BookHandle{kNoHandle});
+        freeSlots.resize(i + 1, kNotFree);
+    }
+    states[i] = static_cast<std::uint8_t>(s);
+    books[i] = book;
+    freeSlots[i] = kNotFree;
+}
+
+void CopyStateTable::reserve(std::size_t n) {
+    states.reserve(n);
+    books.reserve(n);
+    freeSlots.reserve(n);
+}
+
+void CopyStateTable::clear() {
+    states.clear();
+    books.clear();
+    freeSlots.clear();
+}
+
+std::size_t CopyStateTable::count(CopyStatus s) const {
+    const auto v = static_cast<std::uint8_t>(s);
+    const std::uint8_t* p = states.data();
+    const std::size_t size = states.size();
+    std::size_t total = 0, i = 0;
+    for (; i + kBlock <= size; i += kBlock) {
+        std::uint8_t acc = 0;
+        for (std::size_t j = 0; j < kBlock; ++j) acc += p[i + j] == v;
+        total += acc;
+    }
+    for (; i < size; ++i) total += p[i] == v;
+    return total;
+}
+
+std::array<std::size_t, kCopyStatusCount> CopyStateTable::countByStatus() const {
+    std::array<std::size_t, kCopyStatusCount> total{};
+    const std::uint8_t* p = states.data();
+    const std::size_t size = states.size();
+    std::size_t i = 0;
+    for (; i + kBlock <= size; i += kBlock) {
+        // Un pase por estado sobre el mismo bloque, que sigue en L1
+        for (std::size_t k = 0; k < kCopyStatusCount; ++k) {
+            const auto v = static_cast<std::uint8_t>(k);
+            std::uint8_t acc = 0;
+            for (std::size_t j = 0; j < kBlock; ++j) acc += p[i + j] == v;
+            total[k] += acc;
+        }
+    }
+    for (; i < size; ++i)
+        if (p[i] != kUntracked) ++total[p[i]];
+    return total;
+}
+
+void CopyStateTable::collect(CopyStatus s, std::vector<CopyHandle>& out) const {
+    const auto v = static_cast<std::uint8_t>(s);
+    for (std::size_t i = 0; i < states.size(); ++i)
+        if (states[i] == v) out.push_back(CopyHandle(i));
+}
+
+} // namespace lib
@@ -1,4 +1,9 @@
-#include "library.hpp"
+#include "library_service_impl.hpp"
+#include <cassert>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdio>
 
 namespace lib {
 
@@ -15,180 +20,493 @@ long Loan::lateDays() const {
 }
 
 // ----- Reader -----
+bool Reader::isBanned(std::chrono::sys_days today) const {
+    return activeBanUntil.has_value() && today <= activeBanUntil.value();
+}
+
 bool Reader::canBorrow(std::chrono::sys_days today) const {
-    bool banned = activeBanUntil.has_value() && today <= activeBanUntil.value();
-    return !banned && activeLoanIds.size() < 3;
+    return !isBanned(today) && activeLoanIds.size() < kMaxActiveLoans;
+}
+
+// ----- NotificationGateway -----
+void NotificationGateway::sendEmails(std::span<const EmailView> batch) {
+    for (auto& m : batch) sendEmail(std::string(m.to), std::string(m.subject), std::string(m.body));
 }
 
 // ----- ConsoleEmailGateway -----
 void ConsoleEmailGateway::sendEmail(const std::string& to, const std::string& subject, const std::string& body) {
     std::cout << "[EMAIL] To: " << to << " | " << subject << " | " << body << "\n";
 }
+void ConsoleEmailGateway::sendEmails(std::span<const EmailView> batch) {
+    for (auto& m : batch) std::cout << "[EMAIL] To: " << m.to << " | " << m.subject << " | " << m.body << "\n";
+}
 
 // ----- BioAlert -----
+BioAlert::BioAlert(std::size_t shardCount)
+    : mask(std::bit_ceil(shardCount == 0 ? 1 : shardCount) - 1),
+      shards(std::make_unique<Shard[]>(mask + 1)) {}
+
 BioAlert& BioAlert::getInstance() {
     static BioAlert instance;
     return instance;
 }
-void BioAlert::setGateway(NotificationGateway* g) { gateway = g; }
-void BioAlert::subscribe(const std::string& bookId, const std::string& readerId) {
-    subs[bookId].insert(readerId);
+void BioAlert::setGateway(NotificationGateway* g) {
+    gateway.store(g);
+}
+void BioAlert::setAsyncGateway(AsyncNotificationGateway* g) {
+    asyncGateway.store(g);
 }
-void BioAlert::notifyAvailable(const std::string& bookId,
-                         std::function<std::string(const std::string&)> getEmailByReaderId,
-                         std::function<std::string(const std::string&)> getBookTitleByBookId) {
-    if (!gateway) return;
-    auto it = subs.find(bookId);
-    if (it == subs.end()) return;
-    std::string title = getBookTitleByBookId(bookId);
-    for (auto& rid : it->second) {
-        gateway->sendEmail(getEmailByReaderId(rid),
-                           "Disponible: " + title,
-                           "Ya puedes solicitarlo");
+
+BioAlert::Shard& BioAlert::shardOf(std::string_view bookId) const {
+    return shards[std::hash<std::string_view>{}(bookId) & mask];
+}
+
+Handle BioAlert::internReader(std::string_view readerId) {
+    {
+        std::shared_lock lk(readersMu);
+        if (const Handle h = readerIds.handleOf(readerId); h != kNoHandle) return h;
     }
+    std::unique_lock lk(readersMu);
+    return readerIds.tryEmplaceHandle(readerId).first;
 }
-void BioAlert::reset() {
-    subs.clear();
-    gateway = nullptr;
+
+void BioAlert::setPolicy(const FanoutPolicy& p) {
+    for (std::size_t i = 0; i <= mask; ++i) {
+        std::lock_guard lk(shards[i].mu);
+        shards[i].policy = p;
+    }
+}
+FanoutPolicy BioAlert::policy() const {
+    std::lock_guard lk(shards[0].mu);
+    return shards[0].policy;
 }
 
-// ----- LibraryService -----
-LibraryService::LibraryService(MemoryDb& db) : db(db) {}
+void BioAlert::subscribe(std::string_view bookId, std::string_view readerId) {
+    const Handle reader = internReader(readerId);
+    Shard& sh = shardOf(bookId);
+    std::lock_guard lk(sh.mu);
+    auto& cur = sh.subs[bookId];
+    // La copia (copy-on-write) ya es O(n): buscar duplicados en línea no cambia el orden
+    if (cur && std::find(cur->begin(), cur->end(), reader) != cur->end()) return;
+    auto next = cur ? std::make_shared<std::vector<Handle>>(*cur) : std::make_shared<std::vector<Handle>>();
+    next->push_back(reader);
+    cur = std::move(next);
+}
 
-std::chrono::sys_days LibraryService::today_utc() {
-    using namespace std::chrono;
-    const auto now = floor<days>(system_clock::now());
-    return time_point_cast<days>(now);
+// Elige a quién avisar con el candado del shard tomado; con oneShot los
+// elegidos salen de la lista en el mismo tramo
+void BioAlert::select(Shard& sh, std::string_view bookId, std::optional<std::chrono::sys_days> day,
+                      std::vector<Handle>& out) {
+    const FanoutPolicy& p = sh.policy;
+    auto it = sh.subs.find(bookId);
+    if (it == sh.subs.end() || !it->second) return;
+    const std::vector<Handle>& subs = *it->second;
+
+    std::unique_lock rlk(rateMu, std::defer_lock);
+    if (p.maxPerReaderPerDay) {
+        using namespace std::chrono;
+        if (!day) day = floor<days>(system_clock::now());
+        rlk.lock();
+    }
+    for (Handle r : subs) {
+        if (p.maxPerEvent && out.size() == p.maxPerEvent) break;
+        if (p.maxPerReaderPerDay) {
+            if (r >= rate.size()) rate.resize(r + 1);
+            RateState& st = rate[r];
+            if (st.day != *day) st = {*day, 0};
+            if (st.sent >= p.maxPerReaderPerDay) continue;
+            ++st.sent;
+        }
+        out.push_back(r);
+    }
+    if (!p.oneShot || out.empty()) return;
+
+    // `out` es subsecuencia de `subs`: una pasada separa lo que queda
+    auto next = std::make_shared<std::vector<Handle>>();
+    next->reserve(subs.size() - out.size());
+    std::size_t k = 0;
+    for (Handle r : subs) {
+        if (k < out.size() && out[k] == r) ++k;
+        else next->push_back(r);
+    }
+    if (next->empty()) sh.subs.erase(bookId);
+    else it->second = std::move(next);
 }
-std::chrono::sys_days LibraryService::addDays(std::chrono::sys_days base, int d) {
-    return base + std::chrono::days(d);
+
+// Sin día explícito sólo se consulta el reloj si hay límite por lector
+std::size_t BioAlert::notifyAvailable(std::string_view bookId, EmailLookup emailByReaderId,
+                                      TitleLookup titleByBookId) {
+    return notify(bookId, emailByReaderId, titleByBookId, std::nullopt);
+}
+std::size_t BioAlert::notifyAvailable(std::string_view bookId, EmailLookup emailByReaderId,
+                                      TitleLookup titleByBookId, std::chrono::sys_days day) {
+    return notify(bookId, emailByReaderId, titleByBookId, day);
 }
 
-std::string LibraryService::borrowCopy(const std::string& copyId, const std::string& readerId,
-                                       std::chrono::sys_days today) {
-    if (!db.copies.count(copyId)) throw std::runtime_error("COPY_NOT_FOUND");
-    if (!db.readers.count(readerId)) throw std::runtime_error("READER_NOT_FOUND");
-    auto& c = db.copies[copyId];
-    auto& r = db.readers[readerId];
+std::size_t BioAlert::notify(std::string_view bookId, EmailLookup emailByReaderId, TitleLookup titleByBookId,
+                             std::optional<std::chrono::sys_days> day) {
+    NotificationGateway* gw = gateway.load();
+    if (!gw) return 0;
+    metrics::ScopedLatency timer(metrics::Op::Notify);
+    std::string subject;
+    thread_local std::vector<EmailView> batch; // se reutiliza entre eventos
+    collect(bookId, emailByReaderId, titleByBookId, day, subject, batch);
+    if (batch.empty()) return 0;
+    {
+        metrics::ScopedLatency send(metrics::Op::GatewaySend);
+        gw->sendEmails(batch);
+    }
+    return batch.size();
+}
 
-    if (!r.canBorrow(today)) throw std::runtime_error("BORROW_FORBIDDEN");
-    if (c.status != CopyStatus::IN_LIBRARY) throw std::runtime_error("COPY_NOT_AVAILABLE");
+void BioAlert::collect(std::string_view bookId, EmailLookup emailByReaderId, TitleLookup titleByBookId,
+                       std::optional<std::chrono::sys_days> day, std::string& subject,
+                       std::vector<EmailView>& batch) {
+    batch.clear();
+    // Bajo el candado del shard sólo se toma la lista (refcount) o, con una
+    // política acotada, se eligen los avisados; el envío va fuera
+    Subscribers all;
+    thread_local std::vector<Handle> chosen; // se reutiliza entre eventos
+    chosen.clear();
+    {
+        Shard& sh = shardOf(bookId);
+        std::lock_guard lk(sh.mu);
+        if (sh.policy.unlimited()) {
+            auto it = sh.subs.find(bookId);
+            if (it == sh.subs.end() || !it->second) { metrics::recordFanout(0); return; }
+            all = it->second;
+        } else {
+            select(sh, bookId, day, chosen);
+        }
+    }
+    const std::vector<Handle>& readers = all ? *all : chosen;
+    metrics::recordFanout(readers.size());
+    if (readers.empty()) return;
+
+    // Un solo lote por evento: asunto y cuerpo compartidos por todos los mensajes
+    subject = "Disponible: ";
+    subject += titleByBookId(bookId);
+    static constexpr std::string_view body = "Ya puedes solicitarlo";
+
+    batch.reserve(readers.size());
+    // keyOf() puede moverse al internar lectores nuevos: se resuelve bajo el candado
+    std::shared_lock lk(readersMu);
+    for (Handle r : readers) batch.push_back({emailByReaderId(readerIds.keyOf(r)), subject, body});
+}
 
-    Loan loan;
-    loan.copyId   = copyId;
-    loan.bookId   = c.bookId;
-    loan.readerId = readerId;
-    loan.start    = today;
-    loan.due      = addDays(today, 30);
+Task<std::size_t> BioAlert::notifyAvailableAsync(std::string bookId, EmailLookup emailByReaderId,
+                                                 TitleLookup titleByBookId, std::chrono::sys_days day) {
+    AsyncNotificationGateway* gw = asyncGateway.load();
+    if (!gw) co_return notify(bookId, emailByReaderId, titleByBookId, day);
+    metrics::ScopedLatency timer(metrics::Op::Notify);
+    std::string subject;
+    std::vector<EmailView> batch;
+    collect(bookId, emailByReaderId, titleByBookId, day, subject, batch);
+    if (batch.empty()) co_return 0;
+    // Las direcciones son de quien consulta: se copian antes de suspender
+    std::vector<std::string> to;
+    to.reserve(batch.size());
+    for (auto& m : batch) m.to = to.emplace_back(m.to);
+    {
+        metrics::ScopedLatency send(metrics::Op::GatewaySend);
+        co_await sendAsync(*gw, batch);
+    }
+    co_return batch.size();
+}
 
-    const std::string loanId = "L" + std::to_string(db.loans.size() + 1);
-    db.loans[loanId] = loan;
+namespace {
+std::string holdBody(std::chrono::sys_days until) {
+    const std::chrono::year_month_day ymd{until};
+    char date[24];
+    std::snprintf(date, sizeof date, "%04d-%02u-%02u", int(ymd.year()), unsigned(ymd.month()), unsigned(ymd.day()));
+    return std::string("Te lo guardamos hasta el ") + date;
+}
+} // namespace
+
+bool BioAlert::notifyHold(std::string_view email, std::string_view title, std::chrono::sys_days until) {
+    NotificationGateway* gw = gateway.load();
+    if (!gw) return false;
+    metrics::ScopedLatency timer(metrics::Op::Notify);
+    metrics::recordFanout(1);
+    std::string subject = "Apartado: ";
+    subject += title;
+    const std::string body = holdBody(until);
+    metrics::ScopedLatency send(metrics::Op::GatewaySend);
+    gw->sendEmail(std::string(email), subject, body);
+    return true;
+}
 
-    c.status = CopyStatus::LOANED;
-    r.activeLoanIds.push_back(loanId);
-    return loanId;
+Task<bool> BioAlert::notifyHoldAsync(std::string email, std::string title, std::chrono::sys_days until) {
+    AsyncNotificationGateway* gw = asyncGateway.load();
+    if (!gw) co_return notifyHold(email, title, until);
+    metrics::ScopedLatency timer(metrics::Op::Notify);
+    metrics::recordFanout(1);
+    const std::string subject = "Apartado: " + title;
+    const std::string body = holdBody(until);
+    const EmailView msg{email, subject, body};
+    {
+        metrics::ScopedLatency send(metrics::Op::GatewaySend);
+        co_await sendAsync(*gw, {&msg, 1});
+    }
+    co_return true;
 }
 
-std::string LibraryService::borrowOriginalNewRelease(const std::string& bookId, const std::string& readerId,
-                                                     std::chrono::sys_days today) {
-    if (!db.books.count(bookId))  throw std::runtime_error("BOOK_NOT_FOUND");
-    if (!db.readers.count(readerId)) throw std::runtime_error("READER_NOT_FOUND");
-    auto& b = db.books[bookId];
-    auto& r = db.readers[readerId];
+std::size_t BioAlert::subscriberCount(std::string_view bookId) const {
+    Shard& sh = shardOf(bookId);
+    std::lock_guard lk(sh.mu);
+    auto it = sh.subs.find(bookId);
+    return it == sh.subs.end() || !it->second ? 0 : it->second->size();
+}
 
-    if (!b.isNewRelease) throw std::runtime_error("NOT_NEW_RELEASE");
-    if (!r.canBorrow(today)) throw std::runtime_error("BORROW_FORBIDDEN");
-    if (db.newReleaseBorrowed.count(bookId)) throw std::runtime_error("ORIGINAL_ALREADY_BORROWED");
+void BioAlert::reset() {
+    for (std::size_t i = 0; i <= mask; ++i) {
+        std::lock_guard lk(shards[i].mu);
+        shards[i].subs.clear();
+        shards[i].policy = {};
+    }
+    {
+        std::unique_lock lk(readersMu);
+        readerIds.clear();
+    }
+    {
+        std::lock_guard lk(rateMu);
+        rate.clear();
+    }
+    gateway.store(nullptr);
+    asyncGateway.store(nullptr);
+}
 
-    Loan loan;
-    loan.copyId   = ""; // sin copia física
-    loan.bookId   = bookId;
-    loan.readerId = readerId;
-    loan.start    = today;
-    loan.due      = addDays(today, 30);
+// ----- IDs de préstamo -----
+LoanIdText formatLoanId(LoanNumber n) {
+    LoanIdText t;
+    t.buf[0] = 'L';
+    auto res = std::to_chars(t.buf + 1, t.buf + sizeof(t.buf), n);
+    t.len = static_cast<std::uint8_t>(res.ptr - t.buf);
+    return t;
+}
 
-    const std::string loanId = "L" + std::to_string(db.loans.size() + 1);
-    db.loans[loanId] = loan;
+std::optional<LoanNumber> parseLoanId(std::string_view id) {
+    if (id.size() < 2 || id[0] != 'L') return std::nullopt;
+    LoanNumber n{};
+    auto res = std::from_chars(id.data() + 1, id.data() + id.size(), n);
+    if (res.ec != std::errc{} || res.ptr != id.data() + id.size()) return std::nullopt;
+    return n;
+}
 
-    db.newReleaseBorrowed.insert(bookId);
-    r.activeLoanIds.push_back(loanId);
-    return loanId;
+void LoanIdAllocator::observe(LoanNumber n) {
+    LoanNumber cur = next.load(std::memory_order_relaxed);
+    while (cur <= n && !next.compare_exchange_weak(cur, n + 1, std::memory_order_relaxed)) {}
 }
 
-void LibraryService::returnCopy(const std::string& copyId, std::chrono::sys_days when) {
-    if (!db.copies.count(copyId)) throw std::runtime_error("COPY_NOT_FOUND");
-    auto& c = db.copies[copyId];
-    if (c.status != CopyStatus::LOANED && c.status != CopyStatus::LATE) {
-        throw std::runtime_error("COPY_NOT_LOANED");
+// ----- MemoryDb -----
+void MemoryDb::pushDue(LoanHandle h, std::chrono::sys_days due) {
+    dueIndex.push_back({due, h});
+    std::push_heap(dueIndex.begin(), dueIndex.end(), std::greater<>{});
+}
+
+// Una copia aún sin indexar entra con su estado actual
+bool MemoryDb::trackCopy(CopyHandle h) {
+    if (copyStates.tracked(h)) return true;
+    const Copy& c = copies[h];
+    const auto b = books.lookup(c.bookId);
+    if (!b) return false;
+    copyStates.track(h, *b, c.status);
+    auto& bc = copiesByBook[*b];
+    ++bc.byStatus[std::size_t(c.status)];
+    if (c.status == CopyStatus::IN_LIBRARY) {
+        copyStates.setFreePos(h, static_cast<std::uint32_t>(bc.free.size()));
+        bc.free.push_back(h);
     }
+    return true;
+}
 
-    std::string loanId;
-    for (auto& kv : db.loans) {
-        auto& L = kv.second;
-        if (L.copyId == copyId && !L.returned.has_value()) { loanId = kv.first; break; }
+void MemoryDb::setCopyStatus(CopyHandle h, CopyStatus s) {
+    copies[h].status = s;
+    if (!trackCopy(h)) return;
+    const CopyStatus old = copyStates.status(h);
+    if (old == s) return;
+    auto& bc = copiesByBook[copyStates.book(h)];
+    --bc.byStatus[std::size_t(old)];
+    ++bc.byStatus[std::size_t(s)];
+    if (old == CopyStatus::IN_LIBRARY) {
+        // Baja O(1): la última ocupa su hueco
+        const std::uint32_t pos = copyStates.freePos(h);
+        const CopyHandle last = bc.free.back();
+        bc.free[pos] = last;
+        copyStates.setFreePos(last, pos);
+        bc.free.pop_back();
+        copyStates.setFreePos(h, CopyStateTable::kNotFree);
+    }
+    if (s == CopyStatus::IN_LIBRARY) {
+        copyStates.setFreePos(h, static_cast<std::uint32_t>(bc.free.size()));
+        bc.free.push_back(h);
     }
-    if (loanId.empty()) throw std::runtime_error("LOAN_NOT_FOUND");
+    copyStates.setStatus(h, s);
+}
 
-    auto& L = db.loans[loanId];
-    auto& R = db.readers[L.readerId];
+std::optional<CopyHandle> MemoryDb::anyFreeCopy(BookHandle b) const {
+    auto it = copiesByBook.find(b);
+    if (it == copiesByBook.end() || it->second.free.empty()) return std::nullopt;
+    return it->second.free.back();
+}
 
-    L.returned = when;
-    const long late = L.lateDays();
-    if (late > 0) {
-        R.activeBanUntil = when + std::chrono::days(late * 2);
-    }
+bool MemoryDb::enqueueReservation(BookHandle b, ReaderHandle r) {
+    const auto [it, inserted] = queuedTurns.try_emplace(originalKey(b, r), nextTicket);
+    if (!inserted) return false;
+    auto& q = reservations[b];
+    q.line.push_back({r, nextTicket++});
+    ++q.live;
+    return true;
+}
 
-    c.status = CopyStatus::IN_LIBRARY;
+bool MemoryDb::cancelReservation(BookHandle b, ReaderHandle r) {
+    if (!queuedTurns.erase(originalKey(b, r))) return false;
+    --reservations[b].live; // su entrada en la cola queda obsoleta
+    return true;
+}
 
-    {
-        std::vector<std::string> tmp;
-        for (auto& id : R.activeLoanIds) if (id != loanId) tmp.push_back(id);
-        R.activeLoanIds.swap(tmp);
+std::optional<ReaderHandle> MemoryDb::nextReservation(BookHandle b) {
+    auto it = reservations.find(b);
+    if (it == reservations.end()) return std::nullopt;
+    auto& q = it->second;
+    while (!q.line.empty()) {
+        const Turn t = q.line.front();
+        q.line.pop_front();
+        auto turn = queuedTurns.find(originalKey(b, t.reader));
+        if (turn == queuedTurns.end() || turn->second != t.ticket) continue; // cancelado
+        queuedTurns.erase(turn);
+        --q.live;
+        if (q.line.empty()) reservations.erase(it);
+        return t.reader;
     }
+    reservations.erase(it);
+    return std::nullopt;
+}
 
-    BioAlert::getInstance().notifyAvailable(
-        L.bookId,
-        [&](const std::string& rid){ return db.readers.at(rid).email; },
-        [&](const std::string& bid){ return db.books.at(bid).title; }
-    );
+std::size_t MemoryDb::reservationCount(BookHandle b) const {
+    auto it = reservations.find(b);
+    return it == reservations.end() ? 0 : it->second.live;
 }
 
-void LibraryService::returnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
-                                              std::chrono::sys_days when) {
-    if (!db.books.count(bookId)) throw std::runtime_error("BOOK_NOT_FOUND");
-    if (!db.readers.count(readerId)) throw std::runtime_error("READER_NOT_FOUND");
-    if (!db.newReleaseBorrowed.count(bookId)) throw std::runtime_error("ORIGINAL_NOT_BORROWED");
+void MemoryDb::placeHold(CopyHandle c, BookHandle b, ReaderHandle r, std::chrono::sys_days until) {
+    holds[c] = Hold{b, r, until};
+    heldFor[originalKey(b, r)] = c;
+    holdExpiry.push_back({until, c});
+    std::push_heap(holdExpiry.begin(), holdExpiry.end(), std::greater<>{});
+}
 
-    std::string loanId;
-    for (auto& kv : db.loans) {
+std::optional<MemoryDb::Hold> MemoryDb::releaseHold(CopyHandle c) {
+    auto it = holds.find(c);
+    if (it == holds.end()) return std::nullopt;
+    const Hold h = it->second;
+    holds.erase(it);
+    heldFor.erase(originalKey(h.book, h.reader));
+    return h;
+}
+
+void MemoryDb::clearReservations() {
+    reservations.clear();
+    queuedTurns.clear();
+    holds.clear();
+    heldFor.clear();
+    holdExpiry.clear();
+}
+
+void MemoryDb::rebuildIndexes() {
+    openLoanByCopy.clear();
+    openOriginalLoan.clear();
+    dueIndex.clear();
+    for (auto& kv : loans) {
+        if (auto n = parseLoanId(kv.first)) loanIds.observe(*n);
         auto& L = kv.second;
-        if (L.bookId == bookId && L.readerId == readerId && !L.returned.has_value() && L.copyId.empty()) {
-            loanId = kv.first; break;
-        }
+        if (L.returned.has_value()) continue;
+        const LoanHandle h = *loans.lookup(kv.first);
+        if (L.isOriginal()) openOriginalLoan[originalKey(L.book, L.reader)] = h;
+        else                openLoanByCopy[L.copy] = h;
+        // Lo ya emitido como vencido no vuelve al índice
+        const bool seen = L.due < overdueScannedTo || (!L.isOriginal() && copies[L.copy].status == CopyStatus::LATE);
+        if (!seen) dueIndex.push_back({L.due, h});
     }
-    if (loanId.empty()) throw std::runtime_error("LOAN_NOT_FOUND");
+    std::make_heap(dueIndex.begin(), dueIndex.end(), std::greater<>{});
 
-    auto& L = db.loans[loanId];
-    auto& R = db.readers[readerId];
-    L.returned = when;
-    const long late = L.lateDays();
-    if (late > 0) R.activeBanUntil = when + std::chrono::days(late * 2);
+    copiesByBook.clear();
+    copyStates.clear();
+    copyStates.reserve(copies.size());
+    for (auto& kv : copies) trackCopy(*copies.lookup(kv.first));
 
-    db.newReleaseBorrowed.erase(bookId);
+    bans.clear();
+    for (auto& kv : readers)
+        if (kv.second.activeBanUntil) bans.add(*readers.lookup(kv.first), *kv.second.activeBanUntil);
+}
 
-    {
-        std::vector<std::string> tmp;
-        for (auto& id : R.activeLoanIds) if (id != loanId) tmp.push_back(id);
-        R.activeLoanIds.swap(tmp);
+bool MemoryDb::checkIndexes() const {
+    std::size_t openCopies = 0, openOriginals = 0;
+    for (auto& kv : loans) {
+        auto& L = kv.second;
+        if (L.returned.has_value()) continue;
+        const LoanHandle h = *loans.lookup(kv.first);
+        if (L.isOriginal()) {
+            auto it = openOriginalLoan.find(originalKey(L.book, L.reader));
+            if (it == openOriginalLoan.end() || it->second != h) return false;
+            ++openOriginals;
+        } else {
+            auto it = openLoanByCopy.find(L.copy);
+            if (it == openLoanByCopy.end() || it->second != h) return false;
+            ++openCopies;
+        }
+    }
+    if (openCopies != openLoanByCopy.size() || openOriginals != openOriginalLoan.size() ||
+        !std::is_heap(dueIndex.begin(), dueIndex.end(), std::greater<>{}))
+        return false;
+
+    // Disponibilidad: cada copia indexada está en la lista libre de su libro
+    // sólo si está IN_LIBRARY, y los contadores cuadran
+    std::unordered_map<BookHandle, std::array<std::uint32_t, kCopyStatusCount>> counts;
+    for (std::size_t i = 0; i < copyStates.size(); ++i) {
+        const auto h = CopyHandle(i);
+        if (!copyStates.tracked(h)) continue;
+        const CopyStatus status = copyStates.status(h);
+        if (copies[h].status != status) return false;
+        ++counts[copyStates.book(h)][std::size_t(status)];
+        auto it = copiesByBook.find(copyStates.book(h));
+        if (it == copiesByBook.end()) return false;
+        const auto& free = it->second.free;
+        const std::uint32_t pos = copyStates.freePos(h);
+        if ((status == CopyStatus::IN_LIBRARY) != (pos != CopyStateTable::kNotFree)) return false;
+        if (pos != CopyStateTable::kNotFree && (pos >= free.size() || free[pos] != h)) return false;
     }
+    for (auto& [b, bc] : copiesByBook)
+        if (bc.byStatus != counts[b] || bc.free.size() != bc.byStatus[std::size_t(CopyStatus::IN_LIBRARY)])
+            return false;
+
+    // Reservas: cada apartado es una copia RESERVED y los turnos vigentes cuadran
+    if (holds.size() != heldFor.size()) return false;
+    for (auto& [c, h] : holds) {
+        if (copies[c].status != CopyStatus::RESERVED) return false;
+        auto it = heldFor.find(originalKey(h.book, h.reader));
+        if (it == heldFor.end() || it->second != c) return false;
+    }
+    std::size_t live = 0;
+    for (auto& [b, q] : reservations) live += q.live;
+    return live == queuedTurns.size();
+}
 
-    BioAlert::getInstance().notifyAvailable(
-        bookId,
-        [&](const std::string& rid){ return db.readers.at(rid).email; },
-        [&](const std::string& bid){ return db.books.at(bid).title; }
-    );
+bool MemoryDb::checkBans() const {
+    std::size_t banned = 0;
+    for (auto& kv : readers) {
+        if (!kv.second.activeBanUntil) continue;
+        if (!bans.contains(*readers.lookup(kv.first))) return false;
+        ++banned;
+    }
+    return banned == bans.size();
 }
 
+// ----- BasicLibraryService -----
+// Las definiciones están en library_service_impl.hpp; aquí se instancian
+// las políticas que trae la librería.
+template class BasicLibraryService<DefaultLoanPolicy>;
+template class BasicLibraryService<RuntimeLoanPolicy>;
+
 // ----- utils -----
 std::chrono::sys_days makeDate(int y, unsigned m, unsigned d) {
     using namespace std::chrono;
@@ -0,0 +1,119 @@
+#include "library.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace lib {
+
+namespace {
+std::int32_t toDay(std::chrono::sys_days d) { return static_cast<std::int32_t>(d.time_since_epoch().count()); }
+std::chrono::sys_days fromDay(std::int32_t d) { return std::chrono::sys_days{std::chrono::days{d}}; }
+} // namespace
+
+int LoanArchive::monthOf(std::chrono::sys_days d) {
+    const std::chrono::year_month_day ymd{d};
+    return (int(ymd.year()) - 1970) * 12 + int(unsigned(ymd.month())) - 1;
+}
+
+void LoanArchive::appendSegment(std::vector<Row> rows) {
+    if (rows.empty()) return;
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.number < b.number; });
+    const auto first = static_cast<std::uint32_t>(size());
+    segments.push_back(first);
+    const std::size_t n = size() + rows.size();
+    for (auto* col : {&copy, &book, &reader}) col->reserve(n);
+    for (auto* col : {&start, &due, &returned}) col->reserve(n);
+    number.reserve(n);
+    late.reserve(n);
+    month.reserve(n);
+
+    for (const Row& r : rows) {
+        if (r.number == 0) odd.emplace(static_cast<std::uint32_t>(size()), std::string(r.oddId));
+        number.push_back(r.number);
+        copy.push_back(Handle(r.copy));
+        book.push_back(Handle(r.book));
+        reader.push_back(Handle(r.reader));
+        start.push_back(toDay(r.start));
+        due.push_back(toDay(r.due));
+        returned.push_back(toDay(r.returned));
+        const auto lateDays = std::max<std::int64_t>(0, (r.returned - r.due).count());
+        late.push_back(static_cast<std::uint16_t>(std::min<std::int64_t>(lateDays, std::numeric_limits<std::uint16_t>::max())));
+        month.push_back(static_cast<std::uint16_t>(std::clamp(monthOf(r.start), 0, int(std::numeric_limits<std::uint16_t>::max()))));
+    }
+}
+
+void LoanArchive::clear() {
+    number.clear();
+    copy.clear(); book.clear(); reader.clear();
+    start.clear(); due.clear(); returned.clear();
+    late.clear(); month.clear();
+    segments.clear();
+    odd.clear();
+}
+
+LoanArchive::Row LoanArchive::row(std::size_t i) const {
+    std::string_view oddId;
+    if (number[i] == 0) oddId = odd.at(static_cast<std::uint32_t>(i));
+    return {number[i], oddId, CopyHandle(copy[i]), BookHandle(book[i]), ReaderHandle(reader[i]),
+            fromDay(start[i]), fromDay(due[i]), fromDay(returned[i])};
+}
+
+std::string LoanArchive::idOf(std::size_t i) const {
+    if (number[i] == 0) return odd.at(static_cast<std::uint32_t>(i));
+    return std::string(formatLoanId(number[i]).view());
+}
+
+std::optional<std::size_t> LoanArchive::find(std::string_view loanId) const {
+    const auto n = parseLoanId(loanId);
+    if (!n || *n == 0) {
+        for (auto& [r, id] : odd) if (id == loanId) return r;
+        return std::nullopt;
+    }
+    // Búsqueda binaria en cada segmento (pocos: uno por pasada de archivado)
+    for (std::size_t s = 0; s < segments.size(); ++s) {
+        const auto b = number.begin() + segments[s];
+        const auto e = s + 1 < segments.size() ? number.begin() + segments[s + 1] : number.end();
+        const auto it = std::lower_bound(b, e, *n);
+        if (it != e && *it == *n) return static_cast<std::size_t>(it - number.begin());
+    }
+    return std::nullopt;
+}
+
+// --- Agregados: bucles planos sobre una o dos columnas ---
+std::uint64_t LoanArchive::totalLateDays() const {
+    std::uint64_t sum = 0;
+    for (std::uint16_t d : late) sum += d;
+    return sum;
+}
+
+std::size_t LoanArchive::countLate() const {
+    std::size_t n = 0;
+    for (std::uint16_t d : late) n += d != 0;
+    return n;
+}
+
+std::vector<std::uint64_t> LoanArchive::lateDaysHistogram(std::size_t buckets) const {
+    std::vector<std::uint64_t> h(buckets, 0);
+    if (buckets == 0) return h;
+    const auto top = static_cast<std::uint16_t>(std::min<std::size_t>(buckets - 1, std::numeric_limits<std::uint16_t>::max()));
+    for (std::uint16_t d : late) ++h[std::min(d, top)];
+    return h;
+}
+
+std::size_t LoanArchive::countByBook(BookHandle b) const {
+    const Handle key = Handle(b);
+    std::size_t n = 0;
+    for (Handle h : book) n += h == key;
+    return n;
+}
+
+std::vector<std::uint32_t> LoanArchive::monthlyLoans(BookHandle b, int first, std::size_t months) const {
+    std::vector<std::uint32_t> out(months, 0);
+    const Handle key = Handle(b);
+    for (std::size_t i = 0; i < size(); ++i) {
+        const auto m = static_cast<std::size_t>(month[i] - first); // negativo da un valor enorme: fuera de rango
+        if (book[i] == key && m < months) ++out[m];
+    }
+    return out;
+}
+
+} // namespace lib
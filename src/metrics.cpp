@@ -0,0 +1,122 @@
+#include "metrics.hpp"
+
+#ifdef LIB_METRICS
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace lib::metrics {
+
+namespace {
+
+// Contadores vivos de cada hilo y lo que dejaron los que ya terminaron.
+// El candado sólo se toma al registrar/retirar un hilo y al leer.
+struct Registry {
+    std::mutex mu;
+    std::vector<const ThreadCounters*> live;
+    Snapshot retired;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+void addInto(Snapshot& out, const ThreadCounters& t) {
+    constexpr auto rx = std::memory_order_relaxed;
+    for (std::size_t op = 0; op < kOpCount; ++op) {
+        auto& L = out.latency[op];
+        L.count += t.latencyCount[op].load(rx);
+        L.sumNs += t.latencySumNs[op].load(rx);
+        for (std::size_t k = 0; k < kLatencyBuckets; ++k) L.buckets[k] += t.latency[op][k].load(rx);
+        for (std::size_t e = 0; e < kLibErrorCount; ++e) out.rejected[op][e] += t.rejected[op][e].load(rx);
+    }
+    out.fanoutEvents += t.fanoutEvents.load(rx);
+    out.fanoutSum += t.fanoutSum.load(rx);
+    for (std::size_t k = 0; k < kFanoutBuckets; ++k) out.fanout[k] += t.fanout[k].load(rx);
+}
+
+// Se registra en el primer uso del hilo; al terminar éste, sus cuentas pasan a `retired`
+struct ThreadSlot {
+    ThreadCounters counters;
+    ThreadSlot() {
+        auto& r = registry();
+        std::lock_guard lk(r.mu);
+        r.live.push_back(&counters);
+    }
+    ~ThreadSlot() {
+        auto& r = registry();
+        std::lock_guard lk(r.mu);
+        addInto(r.retired, counters);
+        r.live.erase(std::find(r.live.begin(), r.live.end(), &counters));
+    }
+};
+
+void appendf(std::string& out, const char* fmt, auto... args) {
+    char buf[160];
+    const int n = std::snprintf(buf, sizeof buf, fmt, args...);
+    if (n > 0) out.append(buf, std::min<std::size_t>(std::size_t(n), sizeof buf - 1));
+}
+
+} // namespace
+
+ThreadCounters& local() {
+    thread_local ThreadSlot slot;
+    return slot.counters;
+}
+
+Snapshot snapshot() {
+    auto& r = registry();
+    std::lock_guard lk(r.mu);
+    Snapshot out = r.retired;
+    for (const ThreadCounters* t : r.live) addInto(out, *t);
+    return out;
+}
+
+std::string prometheusText() {
+    const Snapshot s = snapshot();
+    using ull = unsigned long long;
+    std::string out;
+
+    out += "# HELP biblioteca_op_duration_seconds Latencia de las operaciones del servicio y del gateway\n";
+    out += "# TYPE biblioteca_op_duration_seconds histogram\n";
+    for (std::size_t op = 0; op < kOpCount; ++op) {
+        const char* name = opName(static_cast<Op>(op));
+        const auto& L = s.latency[op];
+        std::uint64_t cum = 0;
+        for (std::size_t k = 0; k + 1 < kLatencyBuckets; ++k) {
+            cum += L.buckets[k];
+            appendf(out, "biblioteca_op_duration_seconds_bucket{op=\"%s\",le=\"%g\"} %llu\n", name,
+                    double(latencyBound(k)) * 1e-9, ull(cum));
+        }
+        appendf(out, "biblioteca_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", name, ull(L.count));
+        appendf(out, "biblioteca_op_duration_seconds_sum{op=\"%s\"} %.9f\n", name, double(L.sumNs) * 1e-9);
+        appendf(out, "biblioteca_op_duration_seconds_count{op=\"%s\"} %llu\n", name, ull(L.count));
+    }
+
+    out += "# HELP biblioteca_rejections_total Operaciones rechazadas por código de error\n";
+    out += "# TYPE biblioteca_rejections_total counter\n";
+    for (std::size_t op = 0; op < kOpCount; ++op) {
+        for (std::size_t e = 0; e < kLibErrorCount; ++e) {
+            if (!s.rejected[op][e]) continue;
+            appendf(out, "biblioteca_rejections_total{op=\"%s\",code=\"%s\"} %llu\n", opName(static_cast<Op>(op)),
+                    errorCode(static_cast<LibError>(e)), ull(s.rejected[op][e]));
+        }
+    }
+
+    out += "# HELP biblioteca_notify_fanout Emails enviados por aviso\n";
+    out += "# TYPE biblioteca_notify_fanout histogram\n";
+    std::uint64_t cum = 0;
+    for (std::size_t k = 0; k + 1 < kFanoutBuckets; ++k) {
+        cum += s.fanout[k];
+        appendf(out, "biblioteca_notify_fanout_bucket{le=\"%llu\"} %llu\n", ull(fanoutBound(k)), ull(cum));
+    }
+    appendf(out, "biblioteca_notify_fanout_bucket{le=\"+Inf\"} %llu\n", ull(s.fanoutEvents));
+    appendf(out, "biblioteca_notify_fanout_sum %llu\n", ull(s.fanoutSum));
+    appendf(out, "biblioteca_notify_fanout_count %llu\n", ull(s.fanoutEvents));
+    return out;
+}
+
+} // namespace lib::metrics
+#endif
@@ -0,0 +1,256 @@
+#include "read_views.hpp"
+#include <bit>
+#include <utility>
+
+namespace lib {
+
+ReadViews::ReadViews() : ReadViews(Options{}) {}
+
+ReadViews::ReadViews(Options opts) : opts(opts), shared(std::make_shared<Shared>()) {}
+
+ReadViews::~ReadViews() {
+    if (unhook) unhook();
+    detach();
+    {
+        std::lock_guard lk(viewMu);
+        published.reset();
+    }
+    std::vector<const View*> dead;
+    {
+        std::lock_guard lk(shared->mu);
+        shared->stopped = true; // las versiones que aún tenga alguien se liberan al soltarlas
+        dead.swap(shared->graveyard);
+    }
+    reclaim(dead, *shared);
+}
+
+ReadViews::ViewPtr ReadViews::current() const {
+    std::lock_guard lk(viewMu);
+    return published;
+}
+
+ReadViews::ViewPtr ReadViews::latest() {
+    {
+        std::unique_lock lk(shared->mu);
+        if (!worker.joinable()) return current();
+        const std::uint64_t target = received;
+        if (publishedVersion < target) {
+            wantVersion = std::max(wantVersion, target);
+            shared->cv.notify_all();
+            publishedCv.wait(lk, [&] { return publishedVersion >= target || stop; });
+        }
+    }
+    return current();
+}
+
+ReadViews::Stats ReadViews::stats() const {
+    return {applied.load(), publishCount.load(), shared->reclaimed.load(), tablesCopied.load()};
+}
+
+MemoryDb ReadViews::View::materialize() const {
+    MemoryDb db;
+    db.books = books->table;
+    db.copies = copies->table;
+    db.copiesByBook = copies->byBook;
+    db.copyStates = copies->states;
+    db.readers = readers->table;
+    db.bans = readers->bans;
+    db.loans = loans->table;
+    db.newReleaseBorrowed = loans->newReleaseBorrowed;
+    db.openLoanByCopy = loans->openLoanByCopy;
+    db.openOriginalLoan = loans->openOriginalLoan;
+    db.dueIndex = loans->dueIndex;
+    db.overdueScannedTo = loans->overdueScannedTo;
+    db.loanIds = loans->loanIds;
+    return db;
+}
+
+void ReadViews::start(const MemoryDb& primary, RuntimeLoanPolicy rules, std::function<void()> unhookOwner) {
+    detach();
+    unhook = std::move(unhookOwner);
+    replicaSvc.reset();
+    replica = std::make_unique<MemoryDb>(primary);
+    replica->archive.clear(); // las vistas no llevan el histórico
+    replica->clearReservations(); // ni colas: los apartados les llegan como cambios de estado
+    replicaSvc.emplace(*replica, quiet, rules);
+    touched = kAllTables; // nada que compartir con las versiones de un enganche anterior
+    {
+        std::lock_guard lk(shared->mu);
+        pending.clear();
+        received = wantVersion = publishedVersion = 0;
+    }
+    applied.store(0);
+    publish(0);
+    worker = std::thread([this] { run(); });
+}
+
+void ReadViews::detach() {
+    unhook = nullptr;
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard lk(shared->mu);
+        stop = true;
+    }
+    shared->cv.notify_all();
+    worker.join();
+    std::lock_guard lk(shared->mu);
+    stop = false;
+    publishedCv.notify_all();
+}
+
+void ReadViews::push(Change c) {
+    {
+        std::lock_guard lk(shared->mu);
+        pending.push_back(std::move(c));
+        ++received;
+    }
+    shared->cv.notify_one();
+}
+
+void ReadViews::logged(WalRecord::Op op, std::chrono::sys_days day, std::string_view loanId,
+                       std::string_view itemId, std::string_view readerId) {
+    push({Change::Kind::Log, WalRecord{op, day, std::string(loanId), std::string(itemId), std::string(readerId)},
+          {}, {}});
+}
+
+void ReadViews::markedLate(std::string_view copyId) {
+    push({Change::Kind::MarkLate, {}, std::string(copyId), {}});
+}
+
+void ReadViews::statusChanged(std::string_view copyId, CopyStatus status) {
+    push({Change::Kind::SetStatus, {}, std::string(copyId), {}, status});
+}
+
+void ReadViews::banLifted(std::string_view readerId, std::chrono::sys_days until) {
+    push({Change::Kind::LiftBan, {}, std::string(readerId), until});
+}
+
+void ReadViews::archived(std::chrono::sys_days before) {
+    push({Change::Kind::Archive, {}, {}, before});
+}
+
+// Aplica en lotes lo que llegue y publica como mucho una versión por
+// intervalo, o antes si latest() la pide. También libera las versiones soltadas.
+void ReadViews::run() {
+    using clock = std::chrono::steady_clock;
+    std::vector<Change> batch;
+    std::vector<const View*> dead;
+    std::uint64_t version = 0;
+    bool dirty = false; // hay mutaciones aplicadas sin publicar
+    auto lastPublish = clock::now();
+
+    std::unique_lock lk(shared->mu);
+    for (;;) {
+        const bool asked = wantVersion > publishedVersion;
+        const bool due = dirty && (asked || stop || clock::now() >= lastPublish + opts.interval);
+        if (pending.empty() && shared->graveyard.empty() && !due) {
+            if (stop) break;
+            if (dirty) shared->cv.wait_until(lk, lastPublish + opts.interval);
+            else shared->cv.wait(lk);
+            continue;
+        }
+        batch.swap(pending);
+        dead.swap(shared->graveyard);
+        lk.unlock();
+
+        reclaim(dead, *shared);
+        for (const Change& c : batch) apply(c);
+        version += batch.size();
+        dirty |= !batch.empty();
+        batch.clear();
+        applied.store(version);
+        if (dirty && (due || clock::now() >= lastPublish + opts.interval)) {
+            publish(version);
+            dirty = false;
+            lastPublish = clock::now();
+        }
+
+        lk.lock();
+        if (!dirty && publishedVersion < version) publishedVersion = version;
+        publishedCv.notify_all();
+    }
+}
+
+void ReadViews::apply(const Change& c) {
+    MemoryDb& db = *replica;
+    switch (c.kind) {
+    case Change::Kind::Log:
+        replicaSvc->applyLogRecord(c.rec);
+        touched |= kReaderTable | kLoanTable;
+        if (c.rec.op == LogOp::BorrowCopy || c.rec.op == LogOp::ReturnCopy) touched |= kCopyTable;
+        break;
+    case Change::Kind::MarkLate:
+        touched |= kCopyTable;
+        if (const auto h = db.copies.lookup(c.id); h && db.copies[*h].status == CopyStatus::LOANED)
+            db.setCopyStatus(*h, CopyStatus::LATE);
+        break;
+    case Change::Kind::LiftBan:
+        touched |= kReaderTable;
+        if (const auto h = db.readers.lookup(c.id); h && db.readers[*h].activeBanUntil == c.day) {
+            db.readers[*h].activeBanUntil.reset();
+            db.bans.release(*h);
+        }
+        break;
+    case Change::Kind::Archive:
+        replicaSvc->archiveReturned(c.day);
+        db.archive.clear();
+        touched |= kLoanTable;
+        break;
+    case Change::Kind::SetStatus:
+        touched |= kCopyTable;
+        if (const auto h = db.copies.lookup(c.id)) db.setCopyStatus(*h, c.status);
+        break;
+    }
+}
+
+// Versión nueva: copia de la réplica las tablas tocadas y comparte las demás
+// con la versión anterior. Soltar la última referencia no la destruye allí
+// mismo: la deja en el cementerio para el hilo (o la libera si ReadViews ya
+// no existe).
+void ReadViews::publish(std::uint64_t version) {
+    const MemoryDb& db = *replica;
+    auto* next = new View{};
+    next->version = version;
+    {
+        std::lock_guard lk(viewMu);
+        if (published) *next = View{published->books, published->copies, published->readers, published->loans, version};
+    }
+    if (touched & kBookTable) next->books = std::make_shared<const Books>(Books{db.books});
+    if (touched & kCopyTable)
+        next->copies = std::make_shared<const Copies>(Copies{db.copies, db.copiesByBook, db.copyStates});
+    if (touched & kReaderTable) next->readers = std::make_shared<const Readers>(Readers{db.readers, db.bans});
+    if (touched & kLoanTable)
+        next->loans = std::make_shared<const Loans>(Loans{db.loans, db.newReleaseBorrowed, db.openLoanByCopy,
+                                                          db.openOriginalLoan, db.dueIndex, db.overdueScannedTo,
+                                                          db.loanIds});
+    tablesCopied.fetch_add(std::popcount(unsigned(touched)), std::memory_order_relaxed);
+    touched = 0;
+
+    const std::shared_ptr<Shared> s = shared;
+    ViewPtr v(next, [s](const View* p) {
+        {
+            std::lock_guard lk(s->mu);
+            if (!s->stopped) {
+                s->graveyard.push_back(p);
+                s->cv.notify_one();
+                return;
+            }
+        }
+        delete p;
+        s->reclaimed.fetch_add(1, std::memory_order_relaxed);
+    });
+    {
+        std::lock_guard lk(viewMu);
+        published.swap(v);
+    }
+    v.reset(); // la anterior, ya fuera del candado
+    publishCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ReadViews::reclaim(std::vector<const View*>& views, Shared& s) {
+    for (const View* p : views) delete p;
+    s.reclaimed.fetch_add(views.size(), std::memory_order_relaxed);
+    views.clear();
+}
+
+} // namespace lib
@@ -0,0 +1,349 @@
+#include "sharded_library.hpp"
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+namespace lib {
+
+namespace {
+
+std::int32_t dayNumber(std::chrono::sys_days d) {
+    return static_cast<std::int32_t>(d.time_since_epoch().count());
+}
+
+bool isLent(CopyStatus s) { return s == CopyStatus::LOANED || s == CopyStatus::LATE; }
+
+} // namespace
+
+ShardedLibrary::ShardedLibrary(std::size_t shardCount, RuntimeLoanPolicy rules)
+    : ShardedLibrary(shardCount, BioAlert::getInstance(), rules) {}
+
+ShardedLibrary::ShardedLibrary(std::size_t shardCount, BioAlert& alerts, RuntimeLoanPolicy rules) : rules(rules) {
+    if (shardCount == 0) throw std::invalid_argument("ShardedLibrary: sin shards");
+    shards.reserve(shardCount);
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        auto& sh = *shards.emplace_back(std::make_unique<Shard>(alerts, rules));
+        // Cada sede numera sus préstamos en su propio rango: los IDs no chocan
+        sh.db.loanIds.observe(LoanNumber(i) << 40);
+        sh.svc.setBanHook([this](ReaderHandle r, std::chrono::sys_days until) { raiseBan(r, until); });
+    }
+}
+
+std::size_t ShardedLibrary::shardByHash(std::string_view id) const {
+    return std::hash<std::string_view>{}(id) % shards.size();
+}
+
+std::size_t ShardedLibrary::shardOfBook(const std::string& bookId) const { return shardByHash(bookId); }
+
+std::optional<std::size_t> ShardedLibrary::shardOfCopy(const std::string& copyId) const {
+    if (!copyIndex.contains(copyId)) return std::nullopt;
+    return directory[copyIndex.at(copyId)].shard.load(std::memory_order_acquire);
+}
+
+// ----- Carga del catálogo -----
+void ShardedLibrary::addBook(const Book& book) {
+    for (auto& sh : shards)
+        if (!sh->db.books.add(book.id, book).second) throw std::invalid_argument("addBook: libro repetido");
+}
+
+void ShardedLibrary::addReader(const Reader& reader) {
+    if (!reader.activeLoanIds.empty()) throw std::invalid_argument("addReader: el lector trae préstamos");
+    std::optional<ReaderHandle> handle;
+    for (auto& sh : shards) {
+        const auto [h, inserted] = sh->db.readers.add(reader.id, reader);
+        if (!inserted) throw std::invalid_argument("addReader: lector repetido");
+        // Las cuotas se indexan por handle: tiene que ser el mismo en todas las sedes
+        if (handle && *handle != h) throw std::logic_error("addReader: handles distintos entre shards");
+        handle = h;
+        if (reader.activeBanUntil) sh->db.bans.add(h, *reader.activeBanUntil);
+    }
+    while (quotas.size() <= Handle(*handle)) quotas.emplace_back();
+    quotas[Handle(*handle)].banUntil.store(reader.activeBanUntil ? dayNumber(*reader.activeBanUntil) : kNoBan);
+}
+
+void ShardedLibrary::addCopy(const Copy& copy, std::optional<std::size_t> branch) {
+    if (isLent(copy.status)) throw std::invalid_argument("addCopy: la copia viene prestada");
+    const std::size_t s = branch ? *branch : shardByHash(copy.id);
+    if (s >= shards.size()) throw std::out_of_range("addCopy: shard inexistente");
+    if (copyIndex.contains(copy.id)) throw std::invalid_argument("addCopy: copia repetida");
+    MemoryDb& db = shards[s]->db;
+    const CopyHandle h = db.copies.add(copy.id, copy).first;
+    db.trackCopy(h);
+    copyIndex.try_emplace(copy.id, static_cast<std::uint32_t>(directory.size()));
+    directory.emplace_back().shard.store(static_cast<std::uint32_t>(s));
+}
+
+// ----- Cuotas -----
+std::optional<ReaderHandle> ShardedLibrary::readerOf(const std::string& readerId) const {
+    return shards.front()->db.readers.lookup(readerId);
+}
+
+ShardedLibrary::CopyEntry* ShardedLibrary::entryOf(const std::string& copyId) {
+    auto it = copyIndex.find(copyId);
+    return it == copyIndex.end() ? nullptr : &directory[it->second];
+}
+
+// Reserva un préstamo de la cuota global; BORROW_FORBIDDEN si está baneado o lleno
+Expected<void> ShardedLibrary::reserve(ReaderHandle reader, std::chrono::sys_days today) {
+    ReaderQuota& q = quotas[Handle(reader)];
+    if (dayNumber(today) <= q.banUntil.load(std::memory_order_acquire)) return Unexpected{LibError::BorrowForbidden};
+    std::uint32_t n = q.loans.load(std::memory_order_relaxed);
+    do {
+        if (n >= rules.maxActiveLoans()) return Unexpected{LibError::BorrowForbidden};
+    } while (!q.loans.compare_exchange_weak(n, n + 1, std::memory_order_acq_rel));
+    return {};
+}
+
+void ShardedLibrary::release(ReaderHandle reader) {
+    quotas[Handle(reader)].loans.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Desde el banReader de un shard (con el candado del lector de esa sede): se
+// queda el baneo que acabe más tarde
+void ShardedLibrary::raiseBan(ReaderHandle reader, std::chrono::sys_days until) {
+    auto& ban = quotas[Handle(reader)].banUntil;
+    std::int32_t cur = ban.load(std::memory_order_relaxed);
+    while (cur < dayNumber(until) && !ban.compare_exchange_weak(cur, dayNumber(until), std::memory_order_acq_rel)) {}
+}
+
+// ----- Operaciones -----
+Expected<std::string> ShardedLibrary::tryBorrowCopy(const std::string& copyId, const std::string& readerId,
+                                                    std::chrono::sys_days today) {
+    CopyEntry* e = entryOf(copyId);
+    if (!e) return Unexpected{LibError::CopyNotFound};
+    const auto reader = readerOf(readerId);
+    if (!reader) return Unexpected{LibError::ReaderNotFound};
+    if (auto ok = reserve(*reader, today); !ok) return Unexpected{ok.error()};
+
+    // La copia queda reservada (kBusy) mientras el shard decide: ni se
+    // transfiere ni se devuelve a medias
+    std::uint32_t holder = kFree;
+    if (!e->holder.compare_exchange_strong(holder, kBusy, std::memory_order_acquire)) {
+        release(*reader);
+        return Unexpected{LibError::CopyNotAvailable};
+    }
+    Shard& sh = *shards[e->shard.load(std::memory_order_relaxed)];
+    Expected<std::string> id = [&] {
+        std::shared_lock lk(sh.structure);
+        return sh.svc.tryBorrowCopy(copyId, readerId, today);
+    }();
+    if (!id) {
+        release(*reader);
+        e->holder.store(kFree, std::memory_order_release);
+        return id;
+    }
+    e->holder.store(Handle(*reader), std::memory_order_release);
+    return id;
+}
+
+Expected<std::string> ShardedLibrary::tryBorrowOriginalNewRelease(const std::string& bookId,
+                                                                  const std::string& readerId,
+                                                                  std::chrono::sys_days today) {
+    const MemoryDb& any = shards.front()->db; // libros y lectores, iguales en todas las sedes
+    const auto book = any.books.lookup(bookId);
+    if (!book) return Unexpected{LibError::BookNotFound};
+    const auto reader = readerOf(readerId);
+    if (!reader) return Unexpected{LibError::ReaderNotFound};
+    if (!any.books[*book].isNewRelease) return Unexpected{LibError::NotNewRelease};
+    if (auto ok = reserve(*reader, today); !ok) return Unexpected{ok.error()};
+
+    Shard& sh = *shards[shardOfBook(bookId)];
+    Expected<std::string> id = [&] {
+        std::shared_lock lk(sh.structure);
+        return sh.svc.tryBorrowOriginalNewRelease(bookId, readerId, today);
+    }();
+    if (!id) release(*reader);
+    return id;
+}
+
+Expected<void> ShardedLibrary::tryReturnCopy(const std::string& copyId, std::chrono::sys_days when) {
+    CopyEntry* e = entryOf(copyId);
+    if (!e) return Unexpected{LibError::CopyNotFound};
+    // Se toma la copia del lector que la tiene; kBusy es un préstamo o una
+    // devolución en curso, que terminan sin esperar a nadie
+    std::uint32_t holder = e->holder.load(std::memory_order_acquire);
+    for (;;) {
+        if (holder == kFree) return Unexpected{LibError::CopyNotLoaned};
+        if (holder == kBusy) {
+            std::this_thread::yield();
+            holder = e->holder.load(std::memory_order_acquire);
+            continue;
+        }
+        if (e->holder.compare_exchange_weak(holder, kBusy, std::memory_order_acquire)) break;
+    }
+    Shard& sh = *shards[e->shard.load(std::memory_order_relaxed)];
+    Expected<void> done = [&] {
+        std::shared_lock lk(sh.structure);
+        return sh.svc.tryReturnCopy(copyId, when);
+    }();
+    if (!done) {
+        e->holder.store(holder, std::memory_order_release);
+        return done;
+    }
+    release(ReaderHandle(holder));
+    e->holder.store(kFree, std::memory_order_release);
+    return {};
+}
+
+Expected<void> ShardedLibrary::tryReturnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                                           std::chrono::sys_days when) {
+    const auto reader = readerOf(readerId);
+    if (!reader) return Unexpected{LibError::ReaderNotFound};
+    Shard& sh = *shards[shardOfBook(bookId)];
+    Expected<void> done = [&] {
+        std::shared_lock lk(sh.structure);
+        return sh.svc.tryReturnOriginalNewRelease(bookId, readerId, when);
+    }();
+    if (done) release(*reader);
+    return done;
+}
+
+Expected<void> ShardedLibrary::tryTransferCopy(const std::string& copyId, std::size_t toShard,
+                                              std::chrono::sys_days today) {
+    if (toShard >= shards.size()) throw std::out_of_range("transferCopy: shard inexistente");
+    CopyEntry* e = entryOf(copyId);
+    if (!e) return Unexpected{LibError::CopyNotFound};
+    std::uint32_t holder = kFree;
+    if (!e->holder.compare_exchange_strong(holder, kBusy, std::memory_order_acquire))
+        return Unexpected{LibError::CopyNotAvailable};
+    const std::size_t from = e->shard.load(std::memory_order_relaxed);
+    Shard& src = *shards[from];
+    Shard& dst = *shards[toShard];
+
+    if (from != toShard) {
+        Copy moved;
+        CopyHandle srcCopy{};
+        {
+            std::shared_lock lk(src.structure);
+            srcCopy = *src.db.copies.lookup(copyId);
+            if (auto ok = src.svc.tryChangeCopyStatus(srcCopy, CopyStatus::IN_LIBRARY, CopyStatus::TRANSFERRED, today);
+                !ok) {
+                e->holder.store(kFree, std::memory_order_release);
+                return ok;
+            }
+            moved = src.db.copies[srcCopy];
+        }
+        // Si ya estuvo en la sede de destino vuelve a su fila; si no, la fila
+        // nueva cambia la estructura de db.copies y se añade con la sede parada.
+        // Si su fila allí no está TRANSFERRED (la cambió alguien por service()),
+        // la copia se queda en el origen tal como estaba.
+        bool back = false;
+        {
+            std::shared_lock lk(dst.structure);
+            if (const auto h = dst.db.copies.lookup(copyId)) {
+                if (auto ok = dst.svc.tryChangeCopyStatus(*h, CopyStatus::TRANSFERRED, CopyStatus::IN_LIBRARY, today);
+                    !ok) {
+                    lk.unlock();
+                    std::shared_lock srcLk(src.structure);
+                    (void)src.svc.tryChangeCopyStatus(srcCopy, CopyStatus::TRANSFERRED, CopyStatus::IN_LIBRARY, today);
+                    e->holder.store(kFree, std::memory_order_release);
+                    return ok;
+                }
+                back = true;
+            }
+        }
+        if (!back) {
+            std::unique_lock lk(dst.structure);
+            moved.status = CopyStatus::IN_LIBRARY;
+            dst.db.trackCopy(dst.db.copies.add(copyId, std::move(moved)).first);
+        }
+        e->shard.store(static_cast<std::uint32_t>(toShard), std::memory_order_relaxed);
+    }
+    e->holder.store(kFree, std::memory_order_release);
+    return {};
+}
+
+// --- API que lanza ---
+std::string ShardedLibrary::borrowCopy(const std::string& copyId, const std::string& readerId,
+                                       std::chrono::sys_days today) {
+    return tryBorrowCopy(copyId, readerId, today).value();
+}
+
+std::string ShardedLibrary::borrowOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                                     std::chrono::sys_days today) {
+    return tryBorrowOriginalNewRelease(bookId, readerId, today).value();
+}
+
+void ShardedLibrary::returnCopy(const std::string& copyId, std::chrono::sys_days when) {
+    tryReturnCopy(copyId, when).value();
+}
+
+void ShardedLibrary::returnOriginalNewRelease(const std::string& bookId, const std::string& readerId,
+                                              std::chrono::sys_days when) {
+    tryReturnOriginalNewRelease(bookId, readerId, when).value();
+}
+
+void ShardedLibrary::transferCopy(const std::string& copyId, std::size_t toShard, std::chrono::sys_days today) {
+    tryTransferCopy(copyId, toShard, today).value();
+}
+
+// ----- Consultas -----
+std::size_t ShardedLibrary::activeLoanCount(const std::string& readerId) const {
+    const auto r = readerOf(readerId);
+    return r ? quotas[Handle(*r)].loans.load(std::memory_order_acquire) : 0;
+}
+
+bool ShardedLibrary::isBanned(const std::string& readerId, std::chrono::sys_days today) const {
+    const auto r = readerOf(readerId);
+    return r && dayNumber(today) <= quotas[Handle(*r)].banUntil.load(std::memory_order_acquire);
+}
+
+std::size_t ShardedLibrary::advanceClock(std::chrono::sys_days today,
+                                         FunctionRef<void(std::size_t, const OverdueLoan&)> sink) {
+    std::vector<std::vector<OverdueLoan>> due(shards.size());
+    auto run = [&](std::size_t i) {
+        std::shared_lock lk(shards[i]->structure);
+        shards[i]->svc.advanceClock(today, [&](const OverdueLoan& o) { due[i].push_back(o); });
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(shards.size() - 1);
+    for (std::size_t i = 1; i < shards.size(); ++i) workers.emplace_back(run, i);
+    run(0);
+    for (auto& t : workers) t.join();
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < due.size(); ++i) {
+        for (const OverdueLoan& o : due[i]) sink(i, o);
+        total += due[i].size();
+    }
+    return total;
+}
+
+bool ShardedLibrary::checkQuotas() const {
+    // Préstamos por lector: la cuota es la suma de las sedes, y el baneo
+    // global cubre el de cada sede
+    for (std::size_t r = 0; r < quotas.size(); ++r) {
+        std::size_t loans = 0;
+        for (auto& sh : shards) {
+            const Reader& R = sh->db.readers[ReaderHandle(Handle(r))];
+            loans += R.activeLoanIds.size();
+            if (R.activeBanUntil && dayNumber(*R.activeBanUntil) > quotas[r].banUntil.load()) return false;
+        }
+        if (loans != quotas[r].loans.load()) return false;
+    }
+    // Directorio: cada copia vive en una sola sede (en las demás, TRANSFERRED
+    // o ausente) y `holder` es quien tiene su préstamo abierto
+    for (auto& kv : copyIndex) {
+        const CopyEntry& e = directory[kv.second];
+        const std::uint32_t holder = e.holder.load();
+        for (std::size_t s = 0; s < shards.size(); ++s) {
+            const MemoryDb& db = shards[s]->db;
+            const auto h = db.copies.lookup(kv.first);
+            if (s != e.shard.load()) {
+                if (h && db.copies[*h].status != CopyStatus::TRANSFERRED) return false;
+                continue;
+            }
+            if (!h || db.copies[*h].status == CopyStatus::TRANSFERRED) return false;
+            if (!isLent(db.copies[*h].status)) {
+                if (holder != kFree) return false;
+                continue;
+            }
+            auto open = db.openLoanByCopy.find(*h);
+            if (open == db.openLoanByCopy.end() || Handle(db.loans[open->second].reader) != holder) return false;
+        }
+    }
+    return true;
+}
+
+} // namespace lib
@@ -0,0 +1,549 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LIB_SNAPSHOT_MMAP 1
+#endif
+
+namespace lib {
+
+namespace {
+
+constexpr char kMagic[8] = {'B','I','B','S','N','A','P','\0'};
+constexpr std::uint32_t kByteOrder = 0x01020304;
+constexpr std::int32_t kNoDay = std::numeric_limits<std::int32_t>::min();
+constexpr std::uint32_t kNone = static_cast<std::uint32_t>(-1);
+
+enum Section : int {
+    Strings, Books, Copies, Readers, Loans, ReaderLoans, NewReleases,
+    BookIndex, CopyIndex, ReaderIndex, LoanIndex,
+    // v2: histórico columnar (una sección por columna)
+    ArchiveNumbers, ArchiveCopies, ArchiveBooks, ArchiveReaders,
+    ArchiveStart, ArchiveDue, ArchiveReturned, ArchiveSegments, ArchiveOddIds,
+    SectionCount
+};
+constexpr int kSectionsV1 = LoanIndex + 1;
+
+int sectionsIn(std::uint32_t version) { return version == 1 ? kSectionsV1 : SectionCount; }
+
+struct SectionRef { std::uint64_t offset, count; };
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t nextLoanNumber;
+    SectionRef sections[SectionCount];
+};
+
+struct StrRef { std::uint32_t off, len; };
+
+struct BookRec {
+    StrRef id, title, authorName, authorBirth, edition;
+    std::int32_t year;
+    std::uint32_t isNewRelease;
+};
+struct CopyRec {
+    StrRef id, bookId;
+    std::uint32_t status;
+    std::uint32_t pad;
+};
+struct ReaderRec {
+    StrRef id, email;
+    std::int32_t banUntil;
+    std::uint32_t loansBegin, loansCount;
+    std::uint32_t pad;
+};
+struct LoanRec {
+    StrRef id;
+    std::uint32_t copy, book, reader; // posiciones de registro; copy = kNone en originales
+    std::int32_t start, due, returned;
+};
+struct OddIdRec {
+    std::uint32_t row;
+    StrRef id;
+};
+
+static_assert(sizeof(BookRec) == 48 && sizeof(CopyRec) == 24 && sizeof(ReaderRec) == 32 && sizeof(LoanRec) == 32);
+static_assert(sizeof(OddIdRec) == 12);
+
+// Tamaño de la cabecera de una versión (v1 tiene menos secciones)
+std::size_t headerSize(std::uint32_t version) {
+    return offsetof(Header, sections) + sizeof(SectionRef) * std::size_t(sectionsIn(version));
+}
+
+std::size_t recordSize(int s) {
+    switch (s) {
+    case Strings:  return 1;
+    case Books:    return sizeof(BookRec);
+    case Copies:   return sizeof(CopyRec);
+    case Readers:  return sizeof(ReaderRec);
+    case Loans:    return sizeof(LoanRec);
+    case ArchiveNumbers: return sizeof(LoanNumber);
+    case ArchiveOddIds:  return sizeof(OddIdRec);
+    default:       return sizeof(std::uint32_t);
+    }
+}
+
+// FNV-1a: estable entre plataformas y compiladores (std::hash no lo es)
+std::uint64_t stableHash(std::string_view s) {
+    std::uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+std::int32_t toDay(std::chrono::sys_days d) { return static_cast<std::int32_t>(d.time_since_epoch().count()); }
+std::int32_t toDay(const std::optional<std::chrono::sys_days>& d) { return d ? toDay(*d) : kNoDay; }
+std::chrono::sys_days fromDay(std::int32_t d) { return std::chrono::sys_days{std::chrono::days{d}}; }
+std::optional<std::chrono::sys_days> fromOptDay(std::int32_t d) {
+    if (d == kNoDay) return std::nullopt;
+    return fromDay(d);
+}
+
+// --- Escritura ---
+class Writer {
+    std::vector<char> strings;
+    std::unordered_map<std::string_view, StrRef> dedup; // IDs repetidos (bookId de cada copia)
+public:
+    StrRef str(std::string_view s) {
+        if (auto it = dedup.find(s); it != dedup.end()) return it->second;
+        if (strings.size() + s.size() > std::numeric_limits<std::uint32_t>::max())
+            throw std::runtime_error("SNAPSHOT_TOO_LARGE");
+        StrRef r{static_cast<std::uint32_t>(strings.size()), static_cast<std::uint32_t>(s.size())};
+        strings.insert(strings.end(), s.begin(), s.end());
+        dedup.emplace(s, r);
+        return r;
+    }
+    const std::vector<char>& pool() const { return strings; }
+};
+
+template <class Rec>
+std::vector<std::uint32_t> buildIndex(const std::vector<Rec>& recs, const std::vector<char>& pool) {
+    std::size_t cap = 16;
+    while (recs.size() * 2 > cap) cap *= 2; // carga <= 1/2
+    std::vector<std::uint32_t> slots(cap, 0);
+    for (std::size_t i = 0; i < recs.size(); ++i) {
+        const std::string_view id(pool.data() + recs[i].id.off, recs[i].id.len);
+        std::size_t j = stableHash(id) & (cap - 1);
+        while (slots[j] != 0) j = (j + 1) & (cap - 1);
+        slots[j] = static_cast<std::uint32_t>(i + 1);
+    }
+    return slots;
+}
+
+template <class H, class V>
+std::unordered_map<Handle, std::uint32_t> positions(const HandleTable<V, H>& t) {
+    std::unordered_map<Handle, std::uint32_t> m;
+    m.reserve(t.size());
+    std::uint32_t i = 0;
+    for (auto& kv : t) m.emplace(static_cast<Handle>(*t.lookup(kv.first)), i++);
+    return m;
+}
+
+} // namespace
+
+void writeSnapshot(const MemoryDb& db, const std::string& path) {
+    Writer w;
+    const auto bookPos = positions(db.books);
+    const auto copyPos = positions(db.copies);
+    const auto readerPos = positions(db.readers);
+    const auto loanPos = positions(db.loans);
+
+    std::vector<BookRec> books;
+    books.reserve(db.books.size());
+    for (auto& kv : db.books) {
+        const Book& b = kv.second;
+        books.push_back({w.str(kv.first), w.str(b.title), w.str(b.author.fullName), w.str(b.author.birthDate),
+                         w.str(b.edition), b.year, b.isNewRelease ? 1u : 0u});
+    }
+    std::vector<CopyRec> copies;
+    copies.reserve(db.copies.size());
+    for (auto& kv : db.copies) {
+        // Los apartados de la cola de reservas no se guardan: su copia va IN_LIBRARY
+        const bool held = !db.holds.empty() && db.holds.count(*db.copies.lookup(kv.first)) != 0;
+        const CopyStatus status = held ? CopyStatus::IN_LIBRARY : kv.second.status;
+        copies.push_back({w.str(kv.first), w.str(kv.second.bookId), static_cast<std::uint32_t>(status), 0});
+    }
+
+    std::vector<ReaderRec> readers;
+    std::vector<std::uint32_t> readerLoans;
+    readers.reserve(db.readers.size());
+    for (auto& kv : db.readers) {
+        const Reader& r = kv.second;
+        ReaderRec rec{w.str(kv.first), w.str(r.email), toDay(r.activeBanUntil),
+                      static_cast<std::uint32_t>(readerLoans.size()), 0, 0};
+        for (LoanHandle h : r.activeLoanIds) readerLoans.push_back(loanPos.at(Handle(h)));
+        rec.loansCount = static_cast<std::uint32_t>(readerLoans.size() - rec.loansBegin);
+        readers.push_back(rec);
+    }
+
+    std::vector<LoanRec> loans;
+    loans.reserve(db.loans.size());
+    for (auto& kv : db.loans) {
+        const Loan& L = kv.second;
+        loans.push_back({w.str(kv.first), L.isOriginal() ? kNone : copyPos.at(Handle(L.copy)),
+                         bookPos.at(Handle(L.book)), readerPos.at(Handle(L.reader)),
+                         toDay(L.start), toDay(L.due), toDay(L.returned)});
+    }
+
+    std::vector<std::uint32_t> newReleases;
+    for (BookHandle b : db.newReleaseBorrowed) newReleases.push_back(bookPos.at(Handle(b)));
+    std::sort(newReleases.begin(), newReleases.end());
+
+    // Histórico: las columnas van tal cual, con los handles pasados a posiciones
+    const LoanArchive& ar = db.archive;
+    auto toPos = [](const std::unordered_map<Handle, std::uint32_t>& pos, std::span<const Handle> col) {
+        std::vector<std::uint32_t> out;
+        out.reserve(col.size());
+        for (Handle h : col) out.push_back(h == kNoHandle ? kNone : pos.at(h));
+        return out;
+    };
+    const auto arCopies = toPos(copyPos, ar.copies());
+    const auto arBooks = toPos(bookPos, ar.books());
+    const auto arReaders = toPos(readerPos, ar.readers());
+    std::vector<OddIdRec> arOdd;
+    for (auto& [row, id] : ar.oddIds()) arOdd.push_back({row, w.str(id)});
+    std::sort(arOdd.begin(), arOdd.end(), [](auto& a, auto& b) { return a.row < b.row; });
+
+    const auto bookIdx = buildIndex(books, w.pool());
+    const auto copyIdx = buildIndex(copies, w.pool());
+    const auto readerIdx = buildIndex(readers, w.pool());
+    const auto loanIdx = buildIndex(loans, w.pool());
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof kMagic);
+    h.version = kSnapshotVersion;
+    h.byteOrder = kByteOrder;
+    h.nextLoanNumber = db.loanIds.peek();
+
+    std::vector<std::pair<const void*, std::size_t>> parts(SectionCount);
+    parts[Strings]     = {w.pool().data(), w.pool().size()};
+    parts[Books]       = {books.data(), books.size()};
+    parts[Copies]      = {copies.data(), copies.size()};
+    parts[Readers]     = {readers.data(), readers.size()};
+    parts[Loans]       = {loans.data(), loans.size()};
+    parts[ReaderLoans] = {readerLoans.data(), readerLoans.size()};
+    parts[NewReleases] = {newReleases.data(), newReleases.size()};
+    parts[BookIndex]   = {bookIdx.data(), bookIdx.size()};
+    parts[CopyIndex]   = {copyIdx.data(), copyIdx.size()};
+    parts[ReaderIndex] = {readerIdx.data(), readerIdx.size()};
+    parts[LoanIndex]   = {loanIdx.data(), loanIdx.size()};
+    parts[ArchiveNumbers]  = {ar.numbers().data(), ar.size()};
+    parts[ArchiveCopies]   = {arCopies.data(), arCopies.size()};
+    parts[ArchiveBooks]    = {arBooks.data(), arBooks.size()};
+    parts[ArchiveReaders]  = {arReaders.data(), arReaders.size()};
+    parts[ArchiveStart]    = {ar.startDays().data(), ar.size()};
+    parts[ArchiveDue]      = {ar.dueDays().data(), ar.size()};
+    parts[ArchiveReturned] = {ar.returnedDays().data(), ar.size()};
+    parts[ArchiveSegments] = {ar.segmentStarts().data(), ar.segmentStarts().size()};
+    parts[ArchiveOddIds]   = {arOdd.data(), arOdd.size()};
+
+    std::uint64_t off = sizeof(Header);
+    for (int s = 0; s < SectionCount; ++s) {
+        off = (off + 7) & ~std::uint64_t(7); // secciones alineadas a 8
+        h.sections[s] = {off, parts[s].second};
+        off += parts[s].second * recordSize(s);
+    }
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("SNAPSHOT_WRITE_FAILED");
+        out.write(reinterpret_cast<const char*>(&h), sizeof h);
+        std::uint64_t pos = sizeof h;
+        static constexpr char zeros[8] = {};
+        for (int s = 0; s < SectionCount; ++s) {
+            out.write(zeros, static_cast<std::streamsize>(h.sections[s].offset - pos));
+            const auto bytes = parts[s].second * recordSize(s);
+            if (bytes) out.write(static_cast<const char*>(parts[s].first), static_cast<std::streamsize>(bytes));
+            pos = h.sections[s].offset + bytes;
+        }
+        out.flush();
+        if (!out) throw std::runtime_error("SNAPSHOT_WRITE_FAILED");
+    }
+#if defined(LIB_SNAPSHOT_MMAP)
+    // Durable antes del rename: un checkpoint vacía el WAL justo después
+    if (int fd = ::open(tmp.c_str(), O_RDONLY); fd >= 0) {
+        const bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        if (!synced) throw std::runtime_error("SNAPSHOT_WRITE_FAILED");
+    }
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("SNAPSHOT_WRITE_FAILED");
+    }
+}
+
+// --- Lectura ---
+struct SnapshotView::Mapping {
+    const char* base{nullptr};
+    std::size_t size{0};
+#if defined(LIB_SNAPSHOT_MMAP)
+    int fd{-1};
+#else
+    std::vector<char> buffer; // sin mmap: se lee el fichero entero
+#endif
+    Mapping() = default;
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    ~Mapping() {
+#if defined(LIB_SNAPSHOT_MMAP)
+        if (base) ::munmap(const_cast<char*>(base), size);
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    const Header* header() const { return reinterpret_cast<const Header*>(base); }
+    template <class T> const T* section(int s) const {
+        return reinterpret_cast<const T*>(base + header()->sections[s].offset);
+    }
+    // Las secciones que la versión del fichero no tiene cuentan como vacías
+    std::uint64_t count(int s) const {
+        return s < sectionsIn(header()->version) ? header()->sections[s].count : 0;
+    }
+    std::string_view str(StrRef r) const {
+        const std::uint64_t n = count(Strings);
+        if (r.off > n || r.len > n - r.off) throw std::runtime_error("SNAPSHOT_CORRUPT");
+        return {section<char>(Strings) + r.off, r.len};
+    }
+    // Posición de registro leída del fichero (en otra sección): fuera de la
+    // sección `s`, el fichero está corrupto
+    std::uint32_t pos(int s, std::uint32_t p) const {
+        if (p >= count(s)) throw std::runtime_error("SNAPSHOT_CORRUPT");
+        return p;
+    }
+};
+
+SnapshotView::SnapshotView(const std::string& path) : map(std::make_unique<Mapping>()) {
+#if defined(LIB_SNAPSHOT_MMAP)
+    map->fd = ::open(path.c_str(), O_RDONLY);
+    if (map->fd < 0) throw std::runtime_error("SNAPSHOT_NOT_FOUND");
+    struct stat st{};
+    if (::fstat(map->fd, &st) != 0) throw std::runtime_error("SNAPSHOT_READ_FAILED");
+    map->size = static_cast<std::size_t>(st.st_size);
+    if (map->size >= sizeof(Header)) {
+        void* p = ::mmap(nullptr, map->size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+        if (p == MAP_FAILED) throw std::runtime_error("SNAPSHOT_READ_FAILED");
+        map->base = static_cast<const char*>(p);
+    }
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("SNAPSHOT_NOT_FOUND");
+    map->buffer.assign(std::istreambuf_iterator<char>(in), {});
+    map->size = map->buffer.size();
+    map->base = map->buffer.data();
+#endif
+    // Validación: cabecera y que cada sección quepa en el fichero
+    const Header* h = map->header();
+    bool ok = map->size >= headerSize(1) && map->base
+           && std::memcmp(h->magic, kMagic, sizeof kMagic) == 0
+           && h->byteOrder == kByteOrder;
+    if (ok && h->version != kSnapshotVersion && h->version != 1)
+        throw std::runtime_error("SNAPSHOT_VERSION_UNSUPPORTED");
+    ok = ok && map->size >= headerSize(h->version);
+    for (int s = 0; ok && s < sectionsIn(h->version); ++s) {
+        const auto& sec = h->sections[s];
+        ok = sec.offset % 8 == 0 && sec.offset <= map->size
+          && sec.count <= (map->size - sec.offset) / recordSize(s);
+    }
+    if (!ok) throw std::runtime_error("SNAPSHOT_CORRUPT");
+}
+
+SnapshotView::~SnapshotView() = default;
+
+std::size_t SnapshotView::bookCount() const   { return map->count(Books); }
+std::size_t SnapshotView::copyCount() const   { return map->count(Copies); }
+std::size_t SnapshotView::readerCount() const { return map->count(Readers); }
+std::size_t SnapshotView::loanCount() const   { return map->count(Loans); }
+std::size_t SnapshotView::archivedLoanCount() const { return map->count(ArchiveNumbers); }
+LoanNumber SnapshotView::nextLoanNumber() const { return map->header()->nextLoanNumber; }
+
+BookView SnapshotView::book(std::size_t i) const {
+    const BookRec& r = map->section<BookRec>(Books)[i];
+    return {map->str(r.id), map->str(r.title), map->str(r.authorName), map->str(r.authorBirth),
+            map->str(r.edition), r.year, r.isNewRelease != 0};
+}
+CopyView SnapshotView::copy(std::size_t i) const {
+    const CopyRec& r = map->section<CopyRec>(Copies)[i];
+    if (r.status >= kCopyStatusCount) throw std::runtime_error("SNAPSHOT_CORRUPT");
+    return {map->str(r.id), map->str(r.bookId), static_cast<CopyStatus>(r.status)};
+}
+ReaderView SnapshotView::reader(std::size_t i) const {
+    const ReaderRec& r = map->section<ReaderRec>(Readers)[i];
+    return {map->str(r.id), map->str(r.email), fromOptDay(r.banUntil), r.loansCount};
+}
+LoanView SnapshotView::loan(std::size_t i) const {
+    const LoanRec& r = map->section<LoanRec>(Loans)[i];
+    const std::string_view copyId =
+        r.copy == kNone ? std::string_view{} : map->str(map->section<CopyRec>(Copies)[map->pos(Copies, r.copy)].id);
+    return {map->str(r.id), copyId, map->str(map->section<BookRec>(Books)[map->pos(Books, r.book)].id),
+            map->str(map->section<ReaderRec>(Readers)[map->pos(Readers, r.reader)].id),
+            fromDay(r.start), fromDay(r.due), fromOptDay(r.returned)};
+}
+
+std::optional<std::size_t> SnapshotView::findIn(int section, std::string_view id) const {
+    const int idx = section == Books ? BookIndex : section == Copies ? CopyIndex
+                  : section == Readers ? ReaderIndex : LoanIndex;
+    const std::uint64_t cap = map->count(idx);
+    if (cap == 0) return std::nullopt;
+    const std::uint32_t* slots = map->section<std::uint32_t>(idx);
+    for (std::uint64_t j = stableHash(id) & (cap - 1);; j = (j + 1) & (cap - 1)) {
+        const std::uint32_t s = slots[j];
+        if (s == 0 || s > map->count(section)) return std::nullopt;
+        StrRef key;
+        switch (section) {
+        case Books:   key = map->section<BookRec>(Books)[s - 1].id; break;
+        case Copies:  key = map->section<CopyRec>(Copies)[s - 1].id; break;
+        case Readers: key = map->section<ReaderRec>(Readers)[s - 1].id; break;
+        default:      key = map->section<LoanRec>(Loans)[s - 1].id; break;
+        }
+        if (map->str(key) == id) return s - 1;
+    }
+}
+
+std::optional<BookView> SnapshotView::findBook(std::string_view id) const {
+    if (auto i = findIn(Books, id)) return book(*i);
+    return std::nullopt;
+}
+std::optional<CopyView> SnapshotView::findCopy(std::string_view id) const {
+    if (auto i = findIn(Copies, id)) return copy(*i);
+    return std::nullopt;
+}
+std::optional<ReaderView> SnapshotView::findReader(std::string_view id) const {
+    if (auto i = findIn(Readers, id)) return reader(*i);
+    return std::nullopt;
+}
+std::optional<LoanView> SnapshotView::findLoan(std::string_view id) const {
+    if (auto i = findIn(Loans, id)) return loan(*i);
+    return std::nullopt;
+}
+bool SnapshotView::isOriginalBorrowed(std::string_view bookId) const {
+    auto i = findIn(Books, bookId);
+    if (!i) return false;
+    const std::uint32_t* nr = map->section<std::uint32_t>(NewReleases);
+    return std::binary_search(nr, nr + map->count(NewReleases), static_cast<std::uint32_t>(*i));
+}
+
+void SnapshotView::materialize(MemoryDb& db) const {
+    if (!db.books.empty() || !db.copies.empty() || !db.readers.empty() || !db.loans.empty())
+        throw std::runtime_error("SNAPSHOT_TARGET_NOT_EMPTY");
+    // clear() también descarta huecos reutilizables: los handles empiezan en 0
+    db.books.clear();
+    db.copies.clear();
+    db.readers.clear();
+    db.loans.clear();
+    db.books.reserve(bookCount());
+    db.copies.reserve(copyCount());
+    db.readers.reserve(readerCount());
+    db.loans.reserve(loanCount());
+
+    // En un MemoryDb vacío el handle asignado coincide con la posición del
+    // registro. Un ID repetido correría una posición todos los siguientes (y
+    // las referencias a ellos apuntarían a otra fila): el fichero está corrupto.
+    const auto placed = [](const auto& added, std::size_t i) {
+        if (!added.second || Handle(added.first) != i) throw std::runtime_error("SNAPSHOT_CORRUPT");
+    };
+    for (std::size_t i = 0; i < bookCount(); ++i) {
+        const BookView b = book(i);
+        placed(db.books.add(b.id, Book{std::string(b.id), std::string(b.title), b.year,
+                                       Author{std::string(b.authorName), std::string(b.authorBirthDate)},
+                                       std::string(b.edition), b.isNewRelease}),
+               i);
+    }
+    for (std::size_t i = 0; i < copyCount(); ++i) {
+        const CopyView c = copy(i);
+        placed(db.copies.add(c.id, Copy{std::string(c.id), std::string(c.bookId), c.status}), i);
+    }
+    const std::uint32_t* readerLoans = map->section<std::uint32_t>(ReaderLoans);
+    const std::uint64_t readerLoanCount = map->count(ReaderLoans);
+    for (std::size_t i = 0; i < readerCount(); ++i) {
+        const ReaderRec& r = map->section<ReaderRec>(Readers)[i];
+        if (r.loansCount > ActiveLoans::capacity() || r.loansBegin > readerLoanCount ||
+            r.loansCount > readerLoanCount - r.loansBegin)
+            throw std::runtime_error("SNAPSHOT_CORRUPT");
+        Reader reader{std::string(map->str(r.id)), std::string(map->str(r.email)), fromOptDay(r.banUntil), {}};
+        for (std::uint32_t k = 0; k < r.loansCount; ++k)
+            reader.activeLoanIds.push_back(LoanHandle(map->pos(Loans, readerLoans[r.loansBegin + k])));
+        placed(db.readers.add(map->str(r.id), std::move(reader)), i); // clave del fichero: reader.id se mueve
+    }
+    for (std::size_t i = 0; i < loanCount(); ++i) {
+        const LoanRec& r = map->section<LoanRec>(Loans)[i];
+        Loan L;
+        L.copy = r.copy == kNone ? kNoCopy : CopyHandle(map->pos(Copies, r.copy));
+        L.book = BookHandle(map->pos(Books, r.book));
+        L.reader = ReaderHandle(map->pos(Readers, r.reader));
+        L.start = fromDay(r.start);
+        L.due = fromDay(r.due);
+        L.returned = fromOptDay(r.returned);
+        placed(db.loans.add(map->str(r.id), L), i);
+    }
+    const std::uint32_t* nr = map->section<std::uint32_t>(NewReleases);
+    for (std::uint64_t k = 0; k < map->count(NewReleases); ++k)
+        db.newReleaseBorrowed.insert(BookHandle(map->pos(Books, nr[k])));
+
+    materializeArchive(db);
+
+    db.rebuildIndexes();
+    if (nextLoanNumber() > 0) db.loanIds.observe(nextLoanNumber() - 1);
+}
+
+void SnapshotView::materializeArchive(MemoryDb& db) const {
+    db.archive.clear();
+    const std::size_t n = map->count(ArchiveNumbers);
+    for (int s : {ArchiveCopies, ArchiveBooks, ArchiveReaders, ArchiveStart, ArchiveDue, ArchiveReturned})
+        if (map->count(s) != n) throw std::runtime_error("SNAPSHOT_CORRUPT");
+    if (n == 0) return;
+
+    const auto* numbers = map->section<LoanNumber>(ArchiveNumbers);
+    const auto* copies = map->section<std::uint32_t>(ArchiveCopies);
+    const auto* books = map->section<std::uint32_t>(ArchiveBooks);
+    const auto* readers = map->section<std::uint32_t>(ArchiveReaders);
+    const auto* start = map->section<std::int32_t>(ArchiveStart);
+    const auto* due = map->section<std::int32_t>(ArchiveDue);
+    const auto* returned = map->section<std::int32_t>(ArchiveReturned);
+    const auto* segs = map->section<std::uint32_t>(ArchiveSegments);
+    const auto* odd = map->section<OddIdRec>(ArchiveOddIds);
+    const std::size_t segCount = map->count(ArchiveSegments), oddCount = map->count(ArchiveOddIds);
+    if (segCount == 0 || segs[0] != 0) throw std::runtime_error("SNAPSHOT_CORRUPT");
+
+    std::size_t k = 0; // siguiente ID raro (ordenados por fila)
+    for (std::size_t sgm = 0; sgm < segCount; ++sgm) {
+        const std::size_t b = segs[sgm], e = sgm + 1 < segCount ? segs[sgm + 1] : n;
+        if (b >= e || e > n) throw std::runtime_error("SNAPSHOT_CORRUPT");
+        std::vector<LoanArchive::Row> rows;
+        rows.reserve(e - b);
+        for (std::size_t i = b; i < e; ++i) {
+            if ((copies[i] != kNone && copies[i] >= copyCount()) || books[i] >= bookCount() ||
+                readers[i] >= readerCount())
+                throw std::runtime_error("SNAPSHOT_CORRUPT");
+            std::string_view oddId;
+            if (numbers[i] == 0) {
+                if (k >= oddCount || odd[k].row != i) throw std::runtime_error("SNAPSHOT_CORRUPT");
+                oddId = map->str(odd[k++].id);
+            }
+            rows.push_back({numbers[i], oddId, copies[i] == kNone ? kNoCopy : CopyHandle(copies[i]),
+                            BookHandle(books[i]), ReaderHandle(readers[i]),
+                            fromDay(start[i]), fromDay(due[i]), fromDay(returned[i])});
+        }
+        db.archive.appendSegment(std::move(rows));
+    }
+}
+
+void loadSnapshot(MemoryDb& db, const std::string& path) {
+    SnapshotView(path).materialize(db);
+}
+
+} // namespace lib
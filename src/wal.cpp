@@ -0,0 +1,315 @@
+#include "wal.hpp"
+#include "snapshot.hpp"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LIB_WAL_POSIX 1
+#endif
+
+namespace lib {
+
+namespace {
+
+constexpr char kMagic[8] = {'B','I','B','W','A','L','\0','\0'};
+constexpr std::uint32_t kByteOrder = 0x01020304;
+constexpr std::size_t kHeaderSize = sizeof kMagic + 2 * sizeof(std::uint32_t);
+constexpr std::size_t kFrameSize = 2 * sizeof(std::uint32_t); // longitud + crc
+constexpr std::uint32_t kMaxBody = 1u << 20;                   // cota de cordura al leer
+
+constexpr std::array<std::uint32_t, 256> makeCrcTable() {
+    std::array<std::uint32_t, 256> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        t[i] = c;
+    }
+    return t;
+}
+constexpr auto kCrcTable = makeCrcTable();
+
+std::uint32_t crc32(const char* p, std::size_t n) {
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < n; ++i) c = kCrcTable[(c ^ static_cast<unsigned char>(p[i])) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+template <class T> void put(std::vector<char>& out, T v) {
+    const auto at = out.size();
+    out.resize(at + sizeof v);
+    std::memcpy(out.data() + at, &v, sizeof v);
+}
+bool fits(std::string_view s) { return s.size() <= std::numeric_limits<std::uint16_t>::max(); }
+void putStr(std::vector<char>& out, std::string_view s) {
+    put(out, static_cast<std::uint16_t>(s.size()));
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+// Lector acotado de un cuerpo; ok == false si algo se sale de rango
+struct Cursor {
+    const char* p;
+    const char* end;
+    bool ok{true};
+
+    template <class T> T get() {
+        T v{};
+        if (static_cast<std::size_t>(end - p) < sizeof v) { ok = false; return v; }
+        std::memcpy(&v, p, sizeof v);
+        p += sizeof v;
+        return v;
+    }
+    std::string str() {
+        const auto n = get<std::uint16_t>();
+        if (!ok || static_cast<std::size_t>(end - p) < n) { ok = false; return {}; }
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+};
+
+bool validOp(std::uint8_t op) {
+    return op >= std::uint8_t(WalRecord::Op::BorrowCopy) && op <= std::uint8_t(WalRecord::Op::ReturnOriginal);
+}
+
+std::vector<char> headerBytes() {
+    std::vector<char> h(kMagic, kMagic + sizeof kMagic);
+    put(h, kWalVersion);
+    put(h, kByteOrder);
+    return h;
+}
+
+} // namespace
+
+// --- Fichero de anexado ---
+struct WriteAheadLog::File {
+#if defined(LIB_WAL_POSIX)
+    int fd{-1};
+    explicit File(const std::string& path) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) throw std::runtime_error("WAL_OPEN_FAILED");
+    }
+    ~File() { if (fd >= 0) ::close(fd); }
+    void write(const char* p, std::size_t n) {
+        while (n > 0) {
+            const auto w = ::write(fd, p, n);
+            if (w < 0) throw std::runtime_error("WAL_WRITE_FAILED");
+            p += w;
+            n -= static_cast<std::size_t>(w);
+        }
+    }
+    void sync() {
+#if defined(__linux__)
+        if (::fdatasync(fd) != 0) throw std::runtime_error("WAL_WRITE_FAILED");
+#else
+        if (::fsync(fd) != 0) throw std::runtime_error("WAL_WRITE_FAILED");
+#endif
+    }
+    void truncate(std::uint64_t size) {
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) throw std::runtime_error("WAL_WRITE_FAILED");
+    }
+#else
+    std::FILE* f{nullptr};
+    std::string path;
+    explicit File(const std::string& p) : path(p) {
+        f = std::fopen(p.c_str(), "ab");
+        if (!f) throw std::runtime_error("WAL_OPEN_FAILED");
+    }
+    ~File() { if (f) std::fclose(f); }
+    void write(const char* p, std::size_t n) {
+        if (std::fwrite(p, 1, n, f) != n) throw std::runtime_error("WAL_WRITE_FAILED");
+    }
+    void sync() {
+        if (std::fflush(f) != 0) throw std::runtime_error("WAL_WRITE_FAILED");
+    }
+    void truncate(std::uint64_t size) {
+        std::fclose(f);
+        std::filesystem::resize_file(path, size);
+        f = std::fopen(path.c_str(), "ab");
+        if (!f) throw std::runtime_error("WAL_OPEN_FAILED");
+    }
+#endif
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+};
+
+WriteAheadLog::WriteAheadLog(const std::string& path) : WriteAheadLog(path, Options{}) {}
+
+WriteAheadLog::WriteAheadLog(const std::string& p, Options o) : path(p), opts(o) {
+    std::error_code ec;
+    const bool exists = std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) > 0;
+    std::uint64_t keep = 0;
+    if (exists) {
+        const WalScan scan = readWal(path, [](const WalRecord&) {});
+        if (scan.discardedBytes > 0) std::filesystem::resize_file(path, scan.validBytes);
+        keep = scan.validBytes;
+    }
+    file = std::make_unique<File>(path);
+    if (keep == 0) {
+        const auto h = headerBytes();
+        file->write(h.data(), h.size());
+        file->sync();
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try { sync(); } catch (...) {} // sin vía para informar: lo no escrito se pierde como en una caída
+}
+
+Expected<void> WriteAheadLog::check(std::string_view loanId, std::string_view itemId,
+                                    std::string_view readerId) const {
+    if (!fits(loanId) || !fits(itemId) || !fits(readerId)) return Unexpected{LibError::WalRecordTooLarge};
+    std::lock_guard lk(mu);
+    if (broken) return Unexpected{LibError::WalWriteFailed};
+    return {};
+}
+
+WriteAheadLog::Ticket WriteAheadLog::append(WalRecord::Op op, std::chrono::sys_days day, std::string_view loanId,
+                                            std::string_view itemId, std::string_view readerId) {
+    // Antes de tocar el buffer: un marco a medias (len = 0, crc = 0) pasaría
+    // por válido al leer y desalinearía todo lo que le sigue
+    if (!fits(loanId) || !fits(itemId) || !fits(readerId)) throwError(LibError::WalRecordTooLarge);
+    std::lock_guard lk(mu);
+    if (broken) return ++appended; // nunca será durable: commit() lo rechaza
+    const auto frame = buffer.size();
+    buffer.resize(frame + kFrameSize);
+    put(buffer, static_cast<std::uint8_t>(op));
+    put(buffer, static_cast<std::int32_t>(day.time_since_epoch().count()));
+    putStr(buffer, loanId);
+    putStr(buffer, itemId);
+    putStr(buffer, readerId);
+
+    const auto len = static_cast<std::uint32_t>(buffer.size() - frame - kFrameSize);
+    const std::uint32_t crc = crc32(buffer.data() + frame + kFrameSize, len);
+    std::memcpy(buffer.data() + frame, &len, sizeof len);
+    std::memcpy(buffer.data() + frame + sizeof len, &crc, sizeof crc);
+
+    ++st.records;
+    st.bytes += kFrameSize + len;
+    return ++appended;
+}
+
+// Líder del grupo: escribe todo lo acumulado fuera del candado; lo que se
+// anexa mientras tanto espera al siguiente flush
+void WriteAheadLog::flushLocked(std::unique_lock<std::mutex>& lk) {
+    flushing = true;
+    buffer.swap(spare);
+    const Ticket upTo = appended;
+    lk.unlock();
+    bool ok = true;
+    try {
+        file->write(spare.data(), spare.size());
+        if (opts.sync) file->sync();
+    } catch (...) {
+        ok = false;
+    }
+    lk.lock();
+    spare.clear();
+    flushing = false;
+    if (ok) { durable = upTo; ++st.syncs; }
+    else broken = true;
+    cv.notify_all();
+}
+
+void WriteAheadLog::commit(Ticket t) {
+    std::unique_lock lk(mu);
+    while (durable < t) {
+        if (broken) throw std::runtime_error("WAL_WRITE_FAILED");
+        if (flushing) cv.wait(lk);
+        else flushLocked(lk);
+    }
+}
+
+void WriteAheadLog::sync() {
+    Ticket t;
+    {
+        std::lock_guard lk(mu);
+        t = appended;
+    }
+    commit(t);
+}
+
+void WriteAheadLog::truncate() {
+    std::unique_lock lk(mu);
+    cv.wait(lk, [&] { return !flushing; });
+    if (broken) throw std::runtime_error("WAL_WRITE_FAILED");
+    buffer.clear();
+    file->truncate(kHeaderSize);
+    file->sync();
+    durable = appended; // lo descartado ya está en el snapshot
+    cv.notify_all();
+}
+
+WriteAheadLog::Stats WriteAheadLog::stats() const {
+    std::lock_guard lk(mu);
+    return st;
+}
+
+WalScan readWal(const std::string& path, FunctionRef<void(const WalRecord&)> fn) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("WAL_NOT_FOUND");
+    const std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    WalScan scan;
+    if (data.size() < kHeaderSize || std::memcmp(data.data(), kMagic, sizeof kMagic) != 0)
+        throw std::runtime_error("WAL_CORRUPT");
+    std::uint32_t version, order;
+    std::memcpy(&version, data.data() + sizeof kMagic, sizeof version);
+    std::memcpy(&order, data.data() + sizeof kMagic + sizeof version, sizeof order);
+    if (order != kByteOrder) throw std::runtime_error("WAL_CORRUPT");
+    if (version != kWalVersion) throw std::runtime_error("WAL_VERSION_UNSUPPORTED");
+
+    std::size_t pos = kHeaderSize;
+    while (data.size() - pos >= kFrameSize) {
+        std::uint32_t len, crc;
+        std::memcpy(&len, data.data() + pos, sizeof len);
+        std::memcpy(&crc, data.data() + pos + sizeof len, sizeof crc);
+        if (len > kMaxBody || data.size() - pos - kFrameSize < len) break;
+        const char* body = data.data() + pos + kFrameSize;
+        if (crc32(body, len) != crc) break;
+
+        Cursor c{body, body + len};
+        const auto op = c.get<std::uint8_t>();
+        const auto day = c.get<std::int32_t>();
+        WalRecord rec{static_cast<WalRecord::Op>(op), std::chrono::sys_days{std::chrono::days{day}},
+                      c.str(), c.str(), c.str()};
+        if (!c.ok || c.p != c.end || !validOp(op)) break;
+
+        fn(rec);
+        ++scan.records;
+        pos += kFrameSize + len;
+    }
+    scan.validBytes = pos;
+    scan.discardedBytes = data.size() - pos;
+    return scan;
+}
+
+RecoveryReport recover(MemoryDb& db, const std::string& snapshotPath, const std::string& walPath,
+                       RuntimeLoanPolicy rules) {
+    RecoveryReport rep;
+    std::error_code ec;
+    if (!snapshotPath.empty() && std::filesystem::exists(snapshotPath, ec)) {
+        loadSnapshot(db, snapshotPath);
+        rep.snapshotLoaded = true;
+    }
+    if (!std::filesystem::exists(walPath, ec)) return rep;
+
+    // Sin WAL: reaplicar no vuelve a registrar. Con las reglas del que lo escribió,
+    // para que vencimientos, sanciones y el tope de préstamos coincidan
+    ConfigurableLibraryService svc(db, BioAlert::getInstance(), rules);
+    const WalScan scan = readWal(walPath, [&](const WalRecord& rec) {
+        if (svc.applyLogRecord(rec)) ++rep.applied;
+        else ++rep.skipped;
+    });
+    rep.discardedBytes = scan.discardedBytes;
+    return rep;
+}
+
+} // namespace lib
@@ -0,0 +1,229 @@
+#include "workload.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <latch>
+#include <queue>
+#include <random>
+#include <thread>
+
+namespace lib {
+
+namespace {
+
+std::string bookIdOf(std::size_t i)   { return "B" + std::to_string(i); }
+std::string readerIdOf(std::size_t i) { return "R" + std::to_string(i); }
+
+// Misma decisión en populate y generate: ¿el libro i es new release?
+bool isNewReleaseBook(std::size_t i, const WorkloadConfig& cfg) {
+    if (cfg.newReleaseFraction <= 0) return false;
+    const auto every = static_cast<std::size_t>(std::max(1.0, std::round(1.0 / cfg.newReleaseFraction)));
+    return i % every == every - 1;
+}
+
+std::string copyIdOf(std::size_t book, std::size_t k, const WorkloadConfig& cfg) {
+    return "C" + std::to_string(book * cfg.copiesPerBook + k);
+}
+
+struct PendingReturn {
+    std::chrono::sys_days when;
+    WorkloadEvent ev;
+    bool operator>(const PendingReturn& o) const { return when > o.when; }
+};
+
+bool apply(LibraryService& svc, const WorkloadEvent& e) {
+    switch (e.op) {
+    case WorkloadEvent::Op::Borrow:         return svc.tryBorrowCopy(e.itemId, e.readerId, e.day).has_value();
+    case WorkloadEvent::Op::Return:         return svc.tryReturnCopy(e.itemId, e.day).has_value();
+    case WorkloadEvent::Op::BorrowOriginal: return svc.tryBorrowOriginalNewRelease(e.itemId, e.readerId, e.day).has_value();
+    case WorkloadEvent::Op::ReturnOriginal: return svc.tryReturnOriginalNewRelease(e.itemId, e.readerId, e.day).has_value();
+    }
+    return false;
+}
+
+} // namespace
+
+const char* opName(WorkloadEvent::Op op) {
+    switch (op) {
+    case WorkloadEvent::Op::Borrow:         return "borrowCopy";
+    case WorkloadEvent::Op::Return:         return "returnCopy";
+    case WorkloadEvent::Op::BorrowOriginal: return "borrowOriginalNewRelease";
+    case WorkloadEvent::Op::ReturnOriginal: return "returnOriginalNewRelease";
+    }
+    return "?";
+}
+
+void populateWorkload(MemoryDb& db, const WorkloadConfig& cfg) {
+    std::mt19937_64 rng(cfg.seed);
+    db.books.reserve(db.books.size() + cfg.books);
+    db.copies.reserve(db.copies.size() + cfg.books * cfg.copiesPerBook);
+    db.readers.reserve(db.readers.size() + cfg.readers);
+
+    for (std::size_t b = 0; b < cfg.books; ++b) {
+        const bool nr = isNewReleaseBook(b, cfg);
+        db.books[bookIdOf(b)] = Book{ bookIdOf(b), "Title " + std::to_string(b), 1990 + int(b % 35),
+                                      Author{"Author " + std::to_string(b % 997), "1970-01-01"}, "1st", nr };
+        if (nr) continue; // sin copias: se presta el original
+        for (std::size_t k = 0; k < cfg.copiesPerBook; ++k) {
+            const std::string id = copyIdOf(b, k, cfg);
+            db.copies[id] = Copy{ id, bookIdOf(b), CopyStatus::IN_LIBRARY };
+        }
+    }
+
+    std::bernoulli_distribution banned(cfg.bannedReaderFraction);
+    for (std::size_t r = 0; r < cfg.readers; ++r) {
+        Reader reader{ readerIdOf(r), readerIdOf(r) + "@example.com", {}, {} };
+        if (banned(rng)) reader.activeBanUntil = cfg.start + std::chrono::days(30);
+        const auto ban = reader.activeBanUntil;
+        db.readers[reader.id] = std::move(reader);
+        if (ban) db.bans.add(*db.readers.lookup(readerIdOf(r)), *ban);
+    }
+}
+
+std::vector<WorkloadEvent> generateWorkload(const WorkloadConfig& cfg) {
+    // Simulación de referencia con las reglas reales
+    MemoryDb sim;
+    populateWorkload(sim, cfg);
+    BioAlert quiet; // sin gateway: la simulación no avisa a nadie
+    LibraryService svc(sim, quiet);
+
+    std::mt19937_64 rng(cfg.seed ^ 0x9E3779B97F4A7C15ull);
+
+    // Zipf sobre rangos; una permutación decide qué libro ocupa cada rango
+    std::vector<double> weights(cfg.books);
+    for (std::size_t k = 0; k < cfg.books; ++k) weights[k] = 1.0 / std::pow(double(k + 1), cfg.zipfS);
+    std::discrete_distribution<std::size_t> rankDist(weights.begin(), weights.end());
+    std::vector<std::size_t> bookOfRank(cfg.books);
+    for (std::size_t k = 0; k < cfg.books; ++k) bookOfRank[k] = k;
+    std::shuffle(bookOfRank.begin(), bookOfRank.end(), rng);
+
+    std::uniform_int_distribution<std::size_t> readerDist(0, cfg.readers - 1);
+    std::bernoulli_distribution late(cfg.lateReturnProb);
+    std::uniform_int_distribution<int> onTimeDays(1, 30);
+    std::uniform_int_distribution<int> lateDays(1, std::max(1, cfg.maxLateDays));
+    std::uniform_int_distribution<std::size_t> anyCopy(0, cfg.copiesPerBook > 0 ? cfg.copiesPerBook - 1 : 0);
+
+    std::priority_queue<PendingReturn, std::vector<PendingReturn>, std::greater<>> returns;
+    std::vector<WorkloadEvent> out;
+    out.reserve(cfg.events);
+
+    auto emit = [&](WorkloadEvent e) {
+        e.expectOk = apply(svc, e);
+        out.push_back(std::move(e));
+        return out.back().expectOk;
+    };
+    auto scheduleReturn = [&](WorkloadEvent::Op op, const std::string& item, const std::string& reader,
+                              std::chrono::sys_days borrowed) {
+        const int d = late(rng) ? 30 + lateDays(rng) : onTimeDays(rng);
+        returns.push({borrowed + std::chrono::days(d), WorkloadEvent{op, item, reader, {}, true}});
+    };
+
+    while (out.size() < cfg.events) {
+        const auto day = cfg.start + std::chrono::days(
+            static_cast<int>(std::uint64_t(cfg.days) * out.size() / cfg.events));
+
+        // Primero las devoluciones que ya tocan
+        while (!returns.empty() && returns.top().when <= day && out.size() < cfg.events) {
+            WorkloadEvent e = returns.top().ev;
+            e.day = returns.top().when;
+            returns.pop();
+            emit(std::move(e));
+        }
+        if (out.size() >= cfg.events) break;
+
+        const std::size_t book = bookOfRank[rankDist(rng)];
+        const std::string reader = readerIdOf(readerDist(rng));
+        if (isNewReleaseBook(book, cfg)) {
+            const std::string bid = bookIdOf(book);
+            if (emit({WorkloadEvent::Op::BorrowOriginal, bid, reader, day, true}))
+                scheduleReturn(WorkloadEvent::Op::ReturnOriginal, bid, reader, day);
+            continue;
+        }
+        if (cfg.copiesPerBook == 0) continue;
+
+        // Una copia libre si la hay; si no, una cualquiera (contención: se rechaza)
+        std::string copy;
+        for (std::size_t k = 0; k < cfg.copiesPerBook && copy.empty(); ++k) {
+            std::string id = copyIdOf(book, k, cfg);
+            if (sim.copies.at(id).status == CopyStatus::IN_LIBRARY) copy = std::move(id);
+        }
+        if (copy.empty()) copy = copyIdOf(book, anyCopy(rng), cfg);
+        if (emit({WorkloadEvent::Op::Borrow, copy, reader, day, true}))
+            scheduleReturn(WorkloadEvent::Op::Return, copy, {}, day);
+    }
+    return out;
+}
+
+double ReplayReport::throughput() const {
+    std::uint64_t total = 0;
+    for (auto& s : perOp) total += s.count;
+    const double secs = std::chrono::duration<double>(wall).count();
+    return secs > 0 ? double(total) / secs : 0.0;
+}
+
+ReplayReport replayWorkload(LibraryService& svc, std::span<const WorkloadEvent> events, unsigned threads) {
+    if (threads == 0) threads = 1;
+    using Clock = std::chrono::steady_clock;
+
+    // Reparto por ítem: el préstamo y la devolución de una copia van al mismo hilo
+    std::vector<std::vector<std::size_t>> work(threads);
+    for (std::size_t i = 0; i < events.size(); ++i)
+        work[std::hash<std::string>{}(events[i].itemId) % threads].push_back(i);
+
+    struct Local {
+        std::vector<std::uint32_t> samples[4];
+        std::uint64_t errors[4]{};
+        std::uint64_t mismatches{0};
+    };
+    std::vector<Local> locals(threads);
+    std::latch go(threads + 1);
+
+    auto run = [&](unsigned t) {
+        Local& L = locals[t];
+        for (auto& s : L.samples) s.reserve(work[t].size());
+        go.arrive_and_wait();
+        for (std::size_t i : work[t]) {
+            const WorkloadEvent& e = events[i];
+            const auto t0 = Clock::now();
+            const bool ok = apply(svc, e);
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+            const auto op = static_cast<std::size_t>(e.op);
+            L.samples[op].push_back(static_cast<std::uint32_t>(std::min<long long>(ns, UINT32_MAX)));
+            if (!ok) ++L.errors[op];
+            if (ok != e.expectOk) ++L.mismatches;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(run, t);
+    go.arrive_and_wait();
+    const auto start = Clock::now();
+    for (auto& th : pool) th.join();
+
+    ReplayReport rep;
+    rep.threads = threads;
+    rep.wall = Clock::now() - start;
+    for (std::size_t op = 0; op < 4; ++op) {
+        std::vector<std::uint32_t> all;
+        for (auto& L : locals) {
+            all.insert(all.end(), L.samples[op].begin(), L.samples[op].end());
+            rep.perOp[op].errors += L.errors[op];
+        }
+        OpStats& s = rep.perOp[op];
+        s.count = all.size();
+        if (all.empty()) continue;
+        std::sort(all.begin(), all.end());
+        auto pct = [&](double p) {
+            const auto idx = std::min(all.size() - 1, static_cast<std::size_t>(p * double(all.size())));
+            return std::chrono::nanoseconds(all[idx]);
+        };
+        s.p50 = pct(0.50);
+        s.p99 = pct(0.99);
+        s.p999 = pct(0.999);
+        s.max = std::chrono::nanoseconds(all.back());
+    }
+    for (auto& L : locals) rep.mismatches += L.mismatches;
+    return rep;
+}
+
+} // namespace lib
@@ -1,6 +1,23 @@
 #include <catch2/catch_all.hpp>
 #include "library.hpp"
+#include "async_gateway.hpp"
+#include "workload.hpp"
+#include "snapshot.hpp"
+#include "wal.hpp"
+#include "read_views.hpp"
+#include "sharded_library.hpp"
+#include "bulk_import.hpp"
+#include "library_service_impl.hpp"
+#include "metrics.hpp"
+#include <filesystem>
+#include <fstream>
 #include <vector>
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <latch>
+#include <memory_resource>
 
 using namespace lib;
 using namespace std;
@@ -14,6 +31,39 @@ struct TestEmailGateway : NotificationGateway {
     }
 };
 
+// Versión asíncrona del de prueba: captura los emails y deja cada envío en
+// vuelo (sin hilos) hasta que el test lo completa
+struct TestAsyncEmailGateway : AsyncNotificationGateway {
+    std::mutex mu;
+    vector<TestEmailGateway::Msg> out;
+    vector<SendCompletion> inFlight;
+    void sendEmailsAsync(std::span<const EmailView> batch, SendCompletion done) override {
+        std::lock_guard lk(mu);
+        for (auto& m : batch) out.push_back({string(m.to), string(m.subject), string(m.body)});
+        inFlight.push_back(done);
+    }
+    size_t pending() { std::lock_guard lk(mu); return inFlight.size(); }
+    // Completa los envíos en vuelo en [from, to) del orden de llegada
+    void complete(size_t from, size_t to, bool ok = true) {
+        vector<SendCompletion> done;
+        {
+            std::lock_guard lk(mu);
+            done.assign(inFlight.begin() + from, inFlight.begin() + to);
+        }
+        for (auto& d : done) d(ok);
+    }
+};
+
+// Gateway que retiene cada envío hasta que el test lo libera
+struct BlockingEmailGateway : NotificationGateway {
+    std::latch release{1};
+    std::atomic<int> sent{0};
+    void sendEmail(const string&, const string&, const string&) override {
+        release.wait();
+        sent++;
+    }
+};
+
 static void seedMinimal(MemoryDb& db) {
     db.books["B1"] = Book{ "B1","Software Engineering",2020, Author{"Ian Sommerville","1951-08-23"},"10th", false };
     db.books["B2"] = Book{ "B2","Clean C++ (New Release)",2025, Author{"Some Author","1980-01-01"},"1st", true };
@@ -136,3 +186,2221 @@ TEST_CASE("COPY_NOT_AVAILABLE cuando la copia no está en IN_LIBRARY") {
     REQUIRE_THROWS(libsvc.borrowCopy("C1","R1", d));
 }
 
+
+TEST_CASE("Índices de préstamos abiertos: se mantienen en borrow/return") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+    string L2 = libsvc.borrowOriginalNewRelease("B2","R2", d);
+    REQUIRE(db.openLoanByCopy.at(*db.copies.lookup("C1")) == *db.loans.lookup(L1));
+    REQUIRE(db.openOriginalLoan.at(MemoryDb::originalKey(*db.books.lookup("B2"), *db.readers.lookup("R2")))
+            == *db.loans.lookup(L2));
+    REQUIRE(db.checkIndexes());
+
+    libsvc.returnCopy("C1", makeDate(2025,10,5));
+    libsvc.returnOriginalNewRelease("B2","R2", makeDate(2025,10,5));
+    REQUIRE(db.openLoanByCopy.empty());
+    REQUIRE(db.openOriginalLoan.empty());
+    REQUIRE(db.checkIndexes());
+
+    // Historial grande: la devolución sigue encontrando el préstamo abierto
+    for (int i = 0; i < 50; ++i) {
+        libsvc.borrowCopy("C2","R2", d);
+        libsvc.returnCopy("C2", d);
+    }
+    string L3 = libsvc.borrowCopy("C1","R1", d);
+    REQUIRE_NOTHROW(libsvc.returnCopy("C1", d));
+    REQUIRE(db.loans.at(L3).returned.has_value());
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("rebuildIndexes reconstruye desde loans") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+
+    db.openLoanByCopy.clear();
+    REQUIRE_FALSE(db.checkIndexes());
+    db.rebuildIndexes();
+    REQUIRE(db.checkIndexes());
+    REQUIRE(db.openLoanByCopy.at(*db.copies.lookup("C1")) == *db.loans.lookup(L1));
+}
+
+TEMPLATE_TEST_CASE("Tablas: FlatTable se comporta como MapTable", "[storage]",
+                   FlatTable<int>, MapTable<int>) {
+    TestType t;
+    std::map<string, int> ref;
+    // Inserciones, sobrescrituras y borrados intercalados
+    for (int i = 0; i < 2000; ++i) {
+        const string k = "K" + std::to_string((i * 7919) % 613);
+        if (i % 3 == 2) {
+            REQUIRE(t.erase(k) == ref.erase(k));
+        } else {
+            t[k] = i;
+            ref[k] = i;
+        }
+    }
+    REQUIRE(t.size() == ref.size());
+    for (auto& kv : ref) {
+        REQUIRE(t.count(kv.first) == 1);
+        REQUIRE(t.at(kv.first) == kv.second);
+    }
+    std::size_t seen = 0;
+    for (auto& kv : t) { REQUIRE(ref.at(kv.first) == kv.second); ++seen; }
+    REQUIRE(seen == ref.size());
+    REQUIRE(t.find("NO") == t.end());
+    REQUIRE_THROWS_AS(t.at("NO"), std::out_of_range);
+}
+
+TEST_CASE("FlatTable: referencias estables al insertar") {
+    FlatTable<string> t;
+    auto& first = t["A"];
+    first = "valor";
+    for (int i = 0; i < 10000; ++i) t["K" + std::to_string(i)] = "x";
+    REQUIRE(&first == &t.at("A"));
+    REQUIRE(first == "valor");
+}
+
+TEST_CASE("IDs internados: el préstamo guarda handles y la API string es un envoltorio") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    const CopyHandle c1 = *db.copies.lookup("C1");
+    const ReaderHandle r1 = *db.readers.lookup("R1");
+    const LoanHandle h = libsvc.borrowCopy(c1, r1, d);
+
+    const Loan& L = db.loans[h];
+    REQUIRE(L.copy == c1);
+    REQUIRE(L.reader == r1);
+    REQUIRE(db.books.idOf(L.book) == "B1");
+    REQUIRE(db.readers[r1].activeLoanIds == ActiveLoans{h});
+    REQUIRE_FALSE(db.copies.lookup("NO").has_value());
+    REQUIRE_THROWS(libsvc.returnCopy("NO", d));
+
+    libsvc.returnCopy(db.copies.idOf(c1), d);
+    REQUIRE(db.loans.at(db.loans.idOf(h)).returned == d);
+    REQUIRE(sizeof(Loan) < 3 * sizeof(std::string));
+}
+
+TEST_CASE("IDs de préstamo: monótonos aunque se archiven préstamos") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+    string L2 = libsvc.borrowCopy("C2","R1", d);
+    libsvc.returnCopy("C1", d);
+    db.loans.erase(L1); // archivado: antes el siguiente ID chocaba con L2
+
+    string L3 = libsvc.borrowCopy("C1","R2", d);
+    REQUIRE(L3 != L2);
+    REQUIRE(db.loans.size() == 2);
+    REQUIRE(parseLoanId(L3).value() > parseLoanId(L2).value());
+
+    // Un préstamo cargado a mano con el siguiente número no se sobrescribe
+    const string manual(formatLoanId(db.loanIds.peek()).view());
+    Loan archived{};
+    archived.returned = d; // cerrado: no entra en los índices de préstamos abiertos
+    db.loans[manual] = archived;
+    libsvc.returnCopy("C2", d);
+    string L4 = libsvc.borrowCopy("C2","R2", d);
+    REQUIRE(L4 != manual);
+}
+
+TEST_CASE("formatLoanId / parseLoanId") {
+    REQUIRE(formatLoanId(1).view() == "L1");
+    REQUIRE(formatLoanId(18446744073709551615ull).view() == "L18446744073709551615");
+    REQUIRE(parseLoanId("L42") == LoanNumber{42});
+    REQUIRE_FALSE(parseLoanId("X42").has_value());
+    REQUIRE_FALSE(parseLoanId("L").has_value());
+    REQUIRE_FALSE(parseLoanId("L4x").has_value());
+
+    LoanIdAllocator a;
+    a.observe(99);
+    REQUIRE(a.allocate() == 100);
+    REQUIRE(a.allocateRange(10) == 101);
+    REQUIRE(a.allocate() == 111);
+}
+
+TEST_CASE("Concurrencia: préstamos/devoluciones en paralelo respetan las invariantes", "[concurrency]") {
+    BioAlert::getInstance().reset();
+    MemoryDb db;
+    constexpr int kCopies = 64, kReaders = 16, kThreads = 8, kOpsPerThread = 4000;
+    db.books["B1"] = Book{ "B1","Software Engineering",2020, Author{"Ian Sommerville","1951-08-23"},"10th", false };
+    for (int i = 0; i < kCopies; ++i) {
+        const string id = "C" + std::to_string(i);
+        db.copies[id] = Copy{ id, "B1", CopyStatus::IN_LIBRARY };
+    }
+    for (int i = 0; i < kReaders; ++i) {
+        const string id = "R" + std::to_string(i);
+        db.readers[id] = Reader{ id, id + "@example.com", {}, {} };
+    }
+
+    LibraryService libsvc(db);
+    const auto d = makeDate(2025,10,1);
+    // Contadores propios del test: se incrementan tras un préstamo exitoso y se
+    // decrementan antes de devolver, así nunca superan el valor real.
+    std::vector<std::atomic<int>> holders(kCopies), perReader(kReaders);
+    std::atomic<int> copyViolations{0}, readerViolations{0}, borrows{0};
+
+    auto worker = [&](unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<std::pair<int,int>> mine; // (copia, lector)
+        for (int op = 0; op < kOpsPerThread; ++op) {
+            if (!mine.empty() && (rng() % 2 == 0 || mine.size() >= 3)) {
+                const std::size_t k = rng() % mine.size();
+                auto [c, r] = mine[k];
+                mine.erase(mine.begin() + static_cast<std::ptrdiff_t>(k));
+                holders[c]--; perReader[r]--;
+                libsvc.returnCopy("C" + std::to_string(c), d);
+                continue;
+            }
+            const int c = static_cast<int>(rng() % kCopies);
+            const int r = static_cast<int>(rng() % kReaders);
+            try {
+                libsvc.borrowCopy("C" + std::to_string(c), "R" + std::to_string(r), d);
+            } catch (const std::runtime_error&) {
+                continue; // copia prestada o lector en el tope: esperado
+            }
+            if (++holders[c] > 1) copyViolations++;
+            if (++perReader[r] > 3) readerViolations++;
+            borrows++;
+            mine.emplace_back(c, r);
+        }
+        for (auto [c, r] : mine) {
+            holders[c]--; perReader[r]--;
+            libsvc.returnCopy("C" + std::to_string(c), d);
+        }
+    };
+
+    // A la vez, un escáner de vencimientos pasa copias a LATE (se devuelven igual)
+    std::atomic<bool> done{false};
+    std::thread scanner([&] {
+        while (!done) libsvc.advanceClock(LibraryService::addDays(d, 31), [](const OverdueLoan&) {});
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) threads.emplace_back(worker, 1234u + static_cast<unsigned>(t));
+    for (auto& t : threads) t.join();
+    done = true;
+    scanner.join();
+
+    REQUIRE(copyViolations == 0);
+    REQUIRE(readerViolations == 0);
+    REQUIRE(borrows > 0);
+    REQUIRE(db.loans.size() == static_cast<std::size_t>(borrows.load()));
+    REQUIRE(db.openLoanByCopy.empty());
+    for (auto& kv : db.copies) REQUIRE(kv.second.status == CopyStatus::IN_LIBRARY);
+    for (auto& kv : db.readers) REQUIRE(kv.second.activeLoanIds.empty());
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("BioAlert asíncrono: flush entrega todo al gateway de prueba") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    TestEmailGateway gw;
+    AsyncEmailGateway async(gw);
+    BioAlert::getInstance().setGateway(&async);
+    BioAlert::getInstance().subscribe("B1","R1");
+    BioAlert::getInstance().subscribe("B1","R2");
+
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.returnCopy("C1", d);
+    async.flush();
+    REQUIRE(gw.out.size() == 2);
+    REQUIRE(async.stats().sent == 2);
+    REQUIRE(async.pending() == 0);
+    BioAlert::getInstance().reset();
+}
+
+TEST_CASE("BioAlert asíncrono: la devolución no espera al gateway") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    BlockingEmailGateway slow;
+    AsyncEmailGateway async(slow, {.capacity = 1024, .maxBatch = 16});
+    BioAlert::getInstance().setGateway(&async);
+    for (int i = 0; i < 100; ++i) {
+        const string id = "S" + std::to_string(i);
+        db.readers[id] = Reader{ id, id + "@example.com", {}, {} };
+        BioAlert::getInstance().subscribe("B1", id);
+    }
+
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.returnCopy("C1", d);     // el gateway sigue bloqueado: no debe colgarse aquí
+    REQUIRE(slow.sent == 0);
+    REQUIRE(async.pending() == 100);
+
+    slow.release.count_down();
+    async.flush();
+    REQUIRE(slow.sent == 100);
+    REQUIRE(async.stats().batches < 100);
+    BioAlert::getInstance().reset();
+}
+
+TEST_CASE("BioAlert asíncrono: cola llena con política DropNewest") {
+    BlockingEmailGateway slow;
+    AsyncEmailGateway async(slow, {.capacity = 2, .maxBatch = 1,
+                                   .overflow = AsyncEmailGateway::OverflowPolicy::DropNewest});
+    for (int i = 0; i < 10; ++i) async.sendEmail("x@example.com", "s", "b");
+    slow.release.count_down();
+    async.flush();
+    auto st = async.stats();
+    REQUIRE(st.sent + st.dropped == 10);
+    REQUIRE(st.sent <= 3); // capacidad + el lote en vuelo
+}
+
+TEST_CASE("BioAlert: un lote por evento de disponibilidad") {
+    struct BatchGateway : NotificationGateway {
+        int singleCalls = 0, batchCalls = 0;
+        vector<EmailMessage> out;
+        void sendEmail(const string&, const string&, const string&) override { singleCalls++; }
+        void sendEmails(std::span<const EmailView> batch) override {
+            batchCalls++;
+            for (auto& m : batch) out.push_back({string(m.to), string(m.subject), string(m.body)});
+        }
+    };
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    BatchGateway gw;
+    BioAlert::getInstance().setGateway(&gw);
+    BioAlert::getInstance().subscribe("B1","R1");
+    BioAlert::getInstance().subscribe("B1","R2");
+
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.returnCopy("C1", d);
+    REQUIRE(gw.batchCalls == 1);
+    REQUIRE(gw.singleCalls == 0);
+    REQUIRE(gw.out.size() == 2);
+    REQUIRE(gw.out[0].subject == "Disponible: Software Engineering");
+    REQUIRE(gw.out[1].body == "Ya puedes solicitarlo");
+    BioAlert::getInstance().reset();
+}
+
+TEST_CASE("BioAlert: suscripciones sin duplicados y consultas por string_view") {
+    BioAlert::getInstance().reset();
+    TestEmailGateway gw;
+    BioAlert::getInstance().setGateway(&gw);
+    BioAlert::getInstance().subscribe("B1","R2");
+    BioAlert::getInstance().subscribe("B1","R1");
+    BioAlert::getInstance().subscribe("B1","R2"); // repetida: se ignora
+
+    const std::map<string, string> emails{{"R1","alice@example.com"},{"R2","bob@example.com"}};
+    int lookups = 0;
+    BioAlert::getInstance().notifyAvailable("B1",
+        [&](std::string_view rid) -> std::string_view { ++lookups; return emails.at(string(rid)); },
+        [](std::string_view) -> std::string_view { return "Software Engineering"; });
+    REQUIRE(lookups == 2);
+    REQUIRE(gw.out.size() == 2);
+    REQUIRE(gw.out[0].to == "bob@example.com"); // orden de suscripción: R2 primero
+    REQUIRE(gw.out[1].subject == "Disponible: Software Engineering");
+    BioAlert::getInstance().reset();
+}
+
+TEST_CASE("BioAlert inyectado: cada servicio avisa sólo a sus suscriptores") {
+    BioAlert::getInstance().reset();
+    MemoryDb db1; seedMinimal(db1);
+    MemoryDb db2; seedMinimal(db2);
+    BioAlert alerts1, alerts2(1);
+    TestEmailGateway gw1, gw2, global;
+    alerts1.setGateway(&gw1);
+    alerts2.setGateway(&gw2);
+    BioAlert::getInstance().setGateway(&global);
+    alerts1.subscribe("B1","R2");
+    alerts2.subscribe("B1","R1");
+    alerts2.subscribe("B1","R2");
+    BioAlert::getInstance().subscribe("B1","R1");
+    REQUIRE(alerts2.subscriberCount("B1") == 2);
+    REQUIRE(alerts2.subscriberCount("B9") == 0);
+
+    LibraryService svc1(db1, alerts1), svc2(db2, alerts2);
+    auto d = makeDate(2025,10,1);
+    svc1.borrowCopy("C1","R1", d);
+    svc1.returnCopy("C1", d);
+    REQUIRE(gw1.out.size() == 1);
+    REQUIRE(gw1.out[0].to == "bob@example.com");
+    REQUIRE(gw2.out.empty());
+    REQUIRE(global.out.empty());
+
+    svc2.borrowCopy("C1","R1", d);
+    svc2.returnCopy("C1", d);
+    REQUIRE(gw2.out.size() == 2);
+    REQUIRE(global.out.empty());
+    BioAlert::getInstance().reset();
+}
+
+TEST_CASE("BioAlert: suscripciones concurrentes en shards distintos") {
+    BioAlert alerts(8);
+    constexpr int kThreads = 4, kBooks = 32, kReaders = 50;
+    vector<thread> ts;
+    for (int t = 0; t < kThreads; ++t) {
+        ts.emplace_back([&, t] {
+            // Todos los hilos suscriben lo mismo en órdenes distintos: sin duplicados
+            for (int i = 0; i < kBooks * kReaders; ++i) {
+                const int k = (i * 7 + t * 13) % (kBooks * kReaders);
+                alerts.subscribe("B" + to_string(k % kBooks), "R" + to_string(k / kBooks));
+            }
+        });
+    }
+    for (auto& th : ts) th.join();
+    for (int b = 0; b < kBooks; ++b) REQUIRE(alerts.subscriberCount("B" + to_string(b)) == kReaders);
+}
+
+TEST_CASE("BioAlert: política de fan-out (FIFO, un solo uso, límite por lector)") {
+    BioAlert alerts(4);
+    TestEmailGateway gw;
+    alerts.setGateway(&gw);
+    for (const char* r : {"R3","R1","R4","R2"}) alerts.subscribe("B1", r);
+    auto email = [](std::string_view rid) -> std::string_view { return rid; };
+    auto title = [](std::string_view) -> std::string_view { return "T"; };
+    auto d = makeDate(2025,10,1);
+
+    // Los dos primeros en orden de llegada, sin consumirlos
+    alerts.setPolicy({.maxPerEvent = 2});
+    REQUIRE(alerts.notifyAvailable("B1", email, title, d) == 2);
+    REQUIRE(gw.out[0].to == "R3");
+    REQUIRE(gw.out[1].to == "R1");
+    REQUIRE(alerts.subscriberCount("B1") == 4);
+
+    // Un solo uso: los avisados salen de la cola y el siguiente aviso sigue por R4
+    gw.out.clear();
+    alerts.setPolicy({.maxPerEvent = 2, .oneShot = true});
+    REQUIRE(alerts.notifyAvailable("B1", email, title, d) == 2);
+    REQUIRE(alerts.subscriberCount("B1") == 2);
+    REQUIRE(alerts.notifyAvailable("B1", email, title, d) == 2);
+    REQUIRE(gw.out[2].to == "R4");
+    REQUIRE(gw.out[3].to == "R2");
+    REQUIRE(alerts.subscriberCount("B1") == 0);
+    REQUIRE(alerts.notifyAvailable("B1", email, title, d) == 0);
+
+    // Límite por lector y día: quien lo alcanza se salta sin perder su sitio
+    gw.out.clear();
+    alerts.setPolicy({.maxPerReaderPerDay = 1});
+    alerts.subscribe("B1","R1");
+    alerts.subscribe("B2","R1");
+    alerts.subscribe("B2","R2");
+    REQUIRE(alerts.notifyAvailable("B1", email, title, d) == 1);
+    REQUIRE(alerts.notifyAvailable("B2", email, title, d) == 1); // R1 ya recibió hoy
+    REQUIRE(gw.out[1].to == "R2");
+    REQUIRE(alerts.notifyAvailable("B2", email, title, LibraryService::addDays(d,1)) == 2);
+    REQUIRE(alerts.policy().maxPerReaderPerDay == 1);
+}
+
+TEST_CASE("BioAlert: con un solo uso cada devolución avisa a un lector distinto") {
+    MemoryDb db; seedMinimal(db);
+    db.readers["R3"] = Reader{ "R3","carol@example.com", {}, {} };
+    BioAlert alerts;
+    TestEmailGateway gw;
+    alerts.setGateway(&gw);
+    alerts.setPolicy({.maxPerEvent = 1, .oneShot = true});
+    alerts.subscribe("B1","R2");
+    alerts.subscribe("B1","R3");
+
+    LibraryService libsvc(db, alerts);
+    auto d = makeDate(2025,10,1);
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.borrowCopy("C2","R1", d);
+    const std::vector<std::string> both{"C1","C2"};
+    REQUIRE(libsvc.returnBatch(both, d).committed); // un aviso por libro, no por copia
+    REQUIRE(gw.out.size() == 1);
+    REQUIRE(gw.out[0].to == "bob@example.com");
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.returnCopy("C1", d);
+    REQUIRE(gw.out.size() == 2);
+    REQUIRE(gw.out[1].to == "carol@example.com");
+    REQUIRE(alerts.subscriberCount("B1") == 0);
+}
+
+TEST_CASE("Workload: generación determinista y replay coherente con la simulación") {
+    BioAlert::getInstance().reset();
+    WorkloadConfig cfg;
+    cfg.books = 50; cfg.copiesPerBook = 2; cfg.readers = 40; cfg.events = 3000;
+    cfg.newReleaseFraction = 0.1; cfg.lateReturnProb = 0.2; cfg.days = 120;
+
+    const auto events = generateWorkload(cfg);
+    REQUIRE(events.size() == cfg.events);
+    REQUIRE(generateWorkload(cfg).size() == events.size());
+    for (std::size_t i = 1; i < events.size(); ++i) REQUIRE(events[i - 1].day <= events[i].day);
+
+    std::size_t ops[4]{}, rejected = 0;
+    for (auto& e : events) { ops[static_cast<int>(e.op)]++; if (!e.expectOk) ++rejected; }
+    REQUIRE(ops[0] > 0); REQUIRE(ops[1] > 0); REQUIRE(ops[2] > 0); REQUIRE(ops[3] > 0);
+    REQUIRE(rejected > 0); // contención, baneos, tope de préstamos
+
+    // Un hilo: mismo resultado que la simulación de referencia
+    MemoryDb db; populateWorkload(db, cfg);
+    LibraryService libsvc(db);
+    auto rep = replayWorkload(libsvc, events, 1);
+    REQUIRE(rep.mismatches == 0);
+    REQUIRE(rep.perOp[0].count == ops[0]);
+    REQUIRE(rep.perOp[0].p50 <= rep.perOp[0].p99);
+    REQUIRE(db.checkIndexes());
+
+    // Varios hilos: las invariantes se mantienen aunque cambie el orden
+    MemoryDb db2; populateWorkload(db2, cfg);
+    LibraryService libsvc2(db2);
+    auto rep4 = replayWorkload(libsvc2, events, 4);
+    REQUIRE(rep4.threads == 4);
+    for (auto& kv : db2.readers) REQUIRE(kv.second.activeLoanIds.size() <= 3);
+    REQUIRE(db2.checkIndexes());
+}
+
+TEST_CASE("Snapshot: escribir, consultar con mmap y materializar") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+    string L2 = libsvc.borrowCopy("C2","R1", d);
+    libsvc.returnCopy("C2", makeDate(2025,11,5)); // tarde: deja a R1 baneado
+    libsvc.borrowOriginalNewRelease("B2","R2", d);
+
+    const auto path = (std::filesystem::temp_directory_path() / "biblioteca_snapshot_test.bin").string();
+    libsvc.writeSnapshot(path);
+
+    {
+        SnapshotView view(path);
+        REQUIRE(view.bookCount() == 2);
+        REQUIRE(view.copyCount() == 2);
+        REQUIRE(view.loanCount() == 3);
+        REQUIRE(view.findCopy("C1")->status == CopyStatus::LOANED);
+        REQUIRE(view.findBook("B1")->title == "Software Engineering");
+        REQUIRE(view.findReader("R1")->activeBanUntil == db.readers.at("R1").activeBanUntil);
+        REQUIRE(view.findReader("R1")->activeLoans == 1);
+        REQUIRE(view.findLoan(L1)->copyId == "C1");
+        REQUIRE(view.findLoan(L2)->returned == makeDate(2025,11,5));
+        REQUIRE(view.isOriginalBorrowed("B2"));
+        REQUIRE_FALSE(view.findCopy("NO").has_value());
+    }
+
+    MemoryDb restored;
+    loadSnapshot(restored, path);
+    REQUIRE(restored.checkIndexes());
+    REQUIRE(restored.loans.size() == 3);
+    REQUIRE(restored.readers.at("R1").activeLoanIds.size() == 1);
+    REQUIRE(restored.loans[restored.readers.at("R1").activeLoanIds[0]].due == LibraryService::addDays(d,30));
+
+    // El servicio sigue funcionando sobre el estado restaurado
+    LibraryService svc2(restored);
+    REQUIRE_NOTHROW(svc2.returnCopy("C1", d));
+    REQUIRE_NOTHROW(svc2.returnOriginalNewRelease("B2","R2", d));
+    string L4 = svc2.borrowCopy("C1","R2", d);
+    REQUIRE(parseLoanId(L4).value() > 3);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Snapshot: ficheros inválidos se rechazan") {
+    const auto path = (std::filesystem::temp_directory_path() / "biblioteca_snapshot_bad.bin").string();
+    { std::ofstream(path, std::ios::binary) << "no es un snapshot"; }
+    REQUIRE_THROWS_AS(SnapshotView(path), std::runtime_error);
+    std::filesystem::remove(path);
+    REQUIRE_THROWS_AS(SnapshotView(path), std::runtime_error);
+
+    MemoryDb notEmpty; seedMinimal(notEmpty);
+    writeSnapshot(notEmpty, path);
+    REQUIRE_THROWS(loadSnapshot(notEmpty, path));
+    std::filesystem::remove(path);
+}
+
+namespace {
+// Resumen comparable del estado mutable de MemoryDb
+std::vector<std::string> dbState(const MemoryDb& db) {
+    std::vector<std::string> out;
+    for (auto& kv : db.copies) out.push_back(kv.first + ":" + std::to_string(int(kv.second.status)));
+    for (auto& kv : db.readers) {
+        const auto ban = kv.second.activeBanUntil ? kv.second.activeBanUntil->time_since_epoch().count() : 0;
+        out.push_back(kv.first + ":" + std::to_string(kv.second.activeLoanIds.size()) + ":" + std::to_string(ban));
+    }
+    for (auto& kv : db.loans)
+        out.push_back(kv.first + ":" + db.readers.idOf(kv.second.reader) + ":" + (kv.second.returned ? "R" : "A"));
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::string tempPath(const char* name) {
+    const auto p = (std::filesystem::temp_directory_path() / name).string();
+    std::filesystem::remove(p);
+    return p;
+}
+} // namespace
+
+TEST_CASE("WAL: recuperar reaplica las mutaciones sobre el catálogo") {
+    BioAlert::getInstance().reset();
+    const auto walPath = tempPath("biblioteca_wal_test.log");
+    MemoryDb db; seedMinimal(db);
+    auto d = makeDate(2025,10,1);
+    {
+        WriteAheadLog wal(walPath);
+        LibraryService libsvc(db, &wal);
+        libsvc.borrowCopy("C1","R1", d);
+        libsvc.borrowCopy("C2","R1", d);
+        libsvc.returnCopy("C2", makeDate(2025,11,5)); // tarde: baneo
+        libsvc.borrowOriginalNewRelease("B2","R2", d);
+        REQUIRE_THROWS(libsvc.borrowCopy("C1","R2", d)); // rechazada: no se registra
+        REQUIRE(wal.stats().records == 4);
+    }
+
+    MemoryDb restored; seedMinimal(restored);
+    const RecoveryReport rep = recover(restored, "", walPath);
+    REQUIRE_FALSE(rep.snapshotLoaded);
+    REQUIRE(rep.applied == 4);
+    REQUIRE(rep.discardedBytes == 0);
+    REQUIRE(dbState(restored) == dbState(db));
+    REQUIRE(restored.checkIndexes());
+
+    // Cola rota (caída a mitad de escritura): se descarta y el log sigue usable
+    { std::ofstream(walPath, std::ios::binary | std::ios::app).write("\x10\x00\x00", 3); }
+    MemoryDb again; seedMinimal(again);
+    const RecoveryReport torn = recover(again, "", walPath);
+    REQUIRE(torn.applied == 4);
+    REQUIRE(torn.discardedBytes == 3);
+    {
+        WriteAheadLog wal(walPath); // recorta la cola
+        LibraryService libsvc(again, &wal);
+        libsvc.returnCopy("C1", d);
+    }
+    MemoryDb third; seedMinimal(third);
+    REQUIRE(recover(third, "", walPath).applied == 5);
+    REQUIRE(third.copies.at("C1").status == CopyStatus::IN_LIBRARY);
+    std::filesystem::remove(walPath);
+}
+
+TEST_CASE("WAL: checkpoint + log, recuperación idempotente") {
+    BioAlert::getInstance().reset();
+    const auto walPath = tempPath("biblioteca_wal_ckpt.log");
+    const auto snapPath = tempPath("biblioteca_wal_ckpt.snap");
+    MemoryDb db; seedMinimal(db);
+    auto d = makeDate(2025,10,1);
+    {
+        WriteAheadLog wal(walPath);
+        LibraryService libsvc(db, &wal);
+        libsvc.borrowCopy("C1","R1", d);
+        libsvc.borrowOriginalNewRelease("B2","R2", d);
+        libsvc.checkpoint(snapPath);
+        libsvc.returnCopy("C1", d);
+        libsvc.borrowCopy("C2","R2", d);
+    }
+    MemoryDb restored;
+    const RecoveryReport rep = recover(restored, snapPath, walPath);
+    REQUIRE(rep.snapshotLoaded);
+    REQUIRE(rep.applied == 2);
+    REQUIRE(dbState(restored) == dbState(db));
+
+    // Caída entre el snapshot y el vaciado del log: todo el log se reaplica encima
+    MemoryDb replayed;
+    loadSnapshot(replayed, snapPath);
+    LibraryService svc(replayed);
+    readWal(walPath, [&](const WalRecord& r) { svc.applyLogRecord(r); });
+    REQUIRE_FALSE(svc.applyLogRecord(WalRecord{WalRecord::Op::ReturnCopy, d, db.loans.idOf(LoanHandle{0}), "C1", ""}));
+    REQUIRE(dbState(replayed) == dbState(db));
+
+    // Los IDs nuevos siguen tras los recuperados
+    LibraryService after(restored);
+    after.returnCopy("C2", d);
+    REQUIRE(parseLoanId(after.borrowCopy("C2","R1", d)).value() == 4);
+    std::filesystem::remove(walPath);
+    std::filesystem::remove(snapPath);
+}
+
+TEST_CASE("WAL: group commit comparte el fsync entre hilos") {
+    BioAlert::getInstance().reset();
+    const auto walPath = tempPath("biblioteca_wal_group.log");
+    MemoryDb db;
+    WorkloadConfig cfg;
+    cfg.books = 64; cfg.copiesPerBook = 2; cfg.readers = 256; cfg.events = 4000; cfg.newReleaseFraction = 0.05;
+    populateWorkload(db, cfg);
+    const auto events = generateWorkload(cfg);
+    std::uint64_t okOps = 0;
+    {
+        WriteAheadLog wal(walPath);
+        LibraryService libsvc(db, &wal);
+        const ReplayReport rep = replayWorkload(libsvc, events, 4);
+        for (auto& s : rep.perOp) okOps += s.count - s.errors;
+        const auto st = wal.stats();
+        REQUIRE(st.records == okOps);
+        REQUIRE(st.syncs <= st.records);
+    }
+    MemoryDb restored;
+    populateWorkload(restored, cfg);
+    REQUIRE(recover(restored, "", walPath).applied == okOps);
+    REQUIRE(dbState(restored) == dbState(db));
+    std::filesystem::remove(walPath);
+}
+
+TEST_CASE("Lotes: borrowBatch todo o nada con resultado por ítem") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    db.copies["C3"] = Copy{ "C3","B1", CopyStatus::IN_LIBRARY };
+    db.copies["C4"] = Copy{ "C4","B1", CopyStatus::IN_LIBRARY };
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    libsvc.borrowCopy("C3","R2", d);
+
+    // Una copia desconocida: no se aplica nada y el resto queda como abortado
+    const vector<string> mixed{"C1","C3","NO"};
+    BatchResult bad = libsvc.borrowBatch("R1", mixed, d);
+    REQUIRE_FALSE(bad.committed);
+    REQUIRE(bad.items[0].error == LibError::BatchAborted);
+    REQUIRE(bad.items[1].error == LibError::BatchAborted); // con una copia desconocida no se mira el estado
+    REQUIRE(bad.items[2].error == LibError::CopyNotFound);
+    REQUIRE(db.copies.at("C1").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(db.readers.at("R1").activeLoanIds.empty());
+
+    const vector<string> busy{"C1","C3"};
+    BatchResult taken = libsvc.borrowBatch("R1", busy, d);
+    REQUIRE_FALSE(taken.committed);
+    REQUIRE(taken.items[0].error == LibError::BatchAborted);
+    REQUIRE(taken.items[1].error == LibError::CopyNotAvailable);
+    REQUIRE(db.copies.at("C1").status == CopyStatus::IN_LIBRARY);
+
+    // Tope de 3 contando los que ya tiene
+    const vector<string> four{"C1","C2","C4"};
+    BatchResult over = libsvc.borrowBatch("R2", four, d);
+    REQUIRE_FALSE(over.committed);
+    REQUIRE(over.items[2].error == LibError::BorrowForbidden);
+
+    const vector<string> dup{"C1","C1"};
+    REQUIRE(libsvc.borrowBatch("R1", dup, d).items[1].error == LibError::DuplicateInBatch);
+
+    const vector<string> three{"C1","C2","C4"};
+    BatchResult good = libsvc.borrowBatch("R1", three, d);
+    REQUIRE(good.committed);
+    for (auto& it : good.items) REQUIRE(it.ok());
+    REQUIRE(db.readers.at("R1").activeLoanIds.size() == 3);
+    REQUIRE(db.loans.at(good.items[2].loanId).due == LibraryService::addDays(d,30));
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Lotes: returnBatch aplica baneos y avisa una vez por libro") {
+    BioAlert::getInstance().reset();
+    TestEmailGateway gw;
+    BioAlert::getInstance().setGateway(&gw);
+    BioAlert::getInstance().subscribe("B1","R2");
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    const vector<string> both{"C1","C2"};
+    REQUIRE(libsvc.borrowBatch("R1", both, d).committed);
+
+    const vector<string> withFree{"C1","C2","C1"};
+    REQUIRE_FALSE(libsvc.returnBatch(withFree, d).committed);
+    REQUIRE(gw.out.empty());
+
+    BatchResult res = libsvc.returnBatch(both, makeDate(2025,11,5)); // 5 días tarde
+    REQUIRE(res.committed);
+    REQUIRE(db.loans.at(res.items[0].loanId).returned == makeDate(2025,11,5));
+    REQUIRE(db.copies.at("C2").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(db.readers.at("R1").activeLoanIds.empty());
+    REQUIRE(db.readers.at("R1").activeBanUntil == makeDate(2025,11,15));
+    REQUIRE(gw.out.size() == 1); // dos copias del mismo libro, un aviso
+
+    const vector<string> again{"C1"};
+    REQUIRE(libsvc.returnBatch(again, d).items[0].error == LibError::CopyNotLoaned);
+}
+
+TEST_CASE("Lotes: lotes solapados en paralelo no se interbloquean") {
+    BioAlert::getInstance().reset();
+    MemoryDb db;
+    for (int i = 0; i < 8; ++i) db.copies["C" + to_string(i)] = Copy{ "C" + to_string(i), "B1", CopyStatus::IN_LIBRARY };
+    db.books["B1"] = Book{ "B1","Software Engineering",2020, Author{"Ian Sommerville","1951-08-23"},"10th", false };
+    for (int r = 0; r < 4; ++r) db.readers["R" + to_string(r)] = Reader{ "R" + to_string(r), "r@example.com", {}, {} };
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < 4; ++t) {
+        pool.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            const string reader = "R" + to_string(t);
+            for (int k = 0; k < 300; ++k) {
+                vector<string> ids;
+                for (int j = 0; j < 3; ++j) ids.push_back("C" + to_string((rng() % 8)));
+                if (libsvc.borrowBatch(reader, ids, d).committed) libsvc.returnBatch(ids, d);
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    REQUIRE(db.checkIndexes());
+    for (auto& kv : db.copies) REQUIRE(kv.second.status == CopyStatus::IN_LIBRARY);
+    for (auto& kv : db.readers) REQUIRE(kv.second.activeLoanIds.empty());
+}
+
+TEST_CASE("API sin excepciones: los rechazos vuelven como LibError") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    auto ok = libsvc.tryBorrowCopy("C1","R1", d);
+    REQUIRE(ok.has_value());
+    REQUIRE(db.loans.contains(*ok));
+
+    REQUIRE(libsvc.tryBorrowCopy("C1","R2", d).error() == LibError::CopyNotAvailable);
+    REQUIRE(libsvc.tryBorrowCopy("NO","R2", d).error() == LibError::CopyNotFound);
+    REQUIRE(libsvc.tryBorrowCopy("C2","NO", d).error() == LibError::ReaderNotFound);
+    REQUIRE(libsvc.tryReturnCopy("C2", d).error() == LibError::CopyNotLoaned);
+    REQUIRE(libsvc.tryBorrowOriginalNewRelease("B1","R1", d).error() == LibError::NotNewRelease);
+    REQUIRE(libsvc.tryBorrowOriginalNewRelease("B2","R1", d));
+    REQUIRE(libsvc.tryBorrowOriginalNewRelease("B2","R2", d).error() == LibError::OriginalAlreadyBorrowed);
+    REQUIRE(libsvc.tryReturnOriginalNewRelease("B2","R2", d).error() == LibError::LoanNotFound);
+    REQUIRE(libsvc.tryReturnOriginalNewRelease("B2","R1", d));
+    REQUIRE(libsvc.tryReturnOriginalNewRelease("B2","R1", d).error() == LibError::OriginalNotBorrowed);
+
+    // La API que lanza conserva los mensajes de siempre
+    try {
+        libsvc.borrowCopy("C1","R2", d);
+        FAIL("debía lanzar");
+    } catch (const std::runtime_error& e) {
+        REQUIRE(string(e.what()) == "COPY_NOT_AVAILABLE");
+    }
+    auto rejected = libsvc.tryBorrowCopy("C1","R2", d);
+    REQUIRE_THROWS_WITH(rejected.value(), "COPY_NOT_AVAILABLE");
+    REQUIRE(string(errorCode(LibError::BorrowForbidden)) == "BORROW_FORBIDDEN");
+}
+
+TEST_CASE("ActiveLoans: capacidad en línea y borrado en su sitio") {
+    static_assert(ActiveLoans::capacity() == kActiveLoansCapacity);
+    static_assert(DefaultLoanPolicy::maxActiveLoans() <= ActiveLoans::capacity());
+    static_assert(sizeof(ActiveLoans) <= (kActiveLoansCapacity + 1) * sizeof(LoanHandle)); // sin puntero a heap
+    ActiveLoans v{LoanHandle{1}, LoanHandle{2}, LoanHandle{3}};
+    for (Handle h = 4; h <= kActiveLoansCapacity; ++h) v.push_back(LoanHandle{h});
+    REQUIRE(v.full());
+    REQUIRE_THROWS_AS(v.push_back(LoanHandle{99}), std::length_error);
+    REQUIRE(v.remove(LoanHandle{2}));
+    REQUIRE(v[0] == LoanHandle{1});
+    REQUIRE(v[1] == LoanHandle{3}); // conserva el orden
+    REQUIRE_FALSE(v.remove(LoanHandle{2}));
+    for (Handle h = 4; h <= kActiveLoansCapacity; ++h) REQUIRE(v.remove(LoanHandle{h}));
+    REQUIRE(v == ActiveLoans{LoanHandle{1}, LoanHandle{3}});
+    v.push_back(LoanHandle{5});
+    REQUIRE(v[2] == LoanHandle{5});
+}
+
+TEST_CASE("Vencimientos: advanceClock marca LATE sólo lo nuevo") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+    libsvc.borrowCopy("C2","R1", LibraryService::addDays(d,10));
+    libsvc.borrowOriginalNewRelease("B2","R2", d);
+
+    vector<OverdueLoan> seen;
+    auto collect = [&](const OverdueLoan& o) { seen.push_back(o); };
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,30), collect) == 0); // vence el día 30: aún no
+
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,31), collect) == 2);
+    REQUIRE(db.copies.at("C1").status == CopyStatus::LATE);
+    REQUIRE(db.copies.at("C2").status == CopyStatus::LOANED);
+    REQUIRE(db.loans.idOf(seen[0].loan).size() > 0);
+    bool sawOriginal = false;
+    for (auto& o : seen) sawOriginal |= (o.copy == kNoCopy && db.books.idOf(o.book) == "B2");
+    REQUIRE(sawOriginal);
+
+    // Ya emitidos: una segunda pasada no los repite
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,35), collect) == 0);
+
+    // Devuelta antes de vencer: su entrada se descarta sin emitirse
+    libsvc.returnCopy("C2", LibraryService::addDays(d,20));
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,90), collect) == 0);
+    REQUIRE(db.dueIndex.empty());
+
+    // Una copia LATE se devuelve normalmente (con sanción)
+    libsvc.returnCopy("C1", LibraryService::addDays(d,33));
+    REQUIRE(db.copies.at("C1").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(db.readers.at("R1").activeBanUntil.has_value());
+    REQUIRE(db.checkIndexes());
+
+    // Reconstruir el índice no vuelve a emitir copias ya LATE
+    libsvc.borrowCopy("C1","R2", d);
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,40), collect) == 1);
+    db.rebuildIndexes();
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,41), collect) == 0);
+}
+
+TEST_CASE("Baneos: la rueda los levanta en bloque al avanzar los días") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    const ReaderHandle r1 = *db.readers.lookup("R1");
+    const ReaderHandle r2 = *db.readers.lookup("R2");
+
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.returnCopy("C1", LibraryService::addDays(d,35));  // 5 días tarde: baneado hasta d+45
+    libsvc.borrowCopy("C2","R2", d);
+    libsvc.returnCopy("C2", LibraryService::addDays(d,80));  // 50 días tarde: 100 días, más que la rueda
+    REQUIRE(libsvc.bannedReaders() == vector<ReaderHandle>{r1, r2});
+    REQUIRE(db.checkBans());
+
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,45)) == 0); // el último día aún cuenta
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,46)) == 1);
+    REQUIRE_FALSE(db.readers.at("R1").activeBanUntil.has_value());
+    REQUIRE(db.readers.at("R1").canBorrow(LibraryService::addDays(d,46)));
+    REQUIRE(libsvc.bannedReaders() == vector<ReaderHandle>{r2});
+
+    // Un salto mayor que la rueda no pierde el baneo largo ni lo levanta antes
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,150)) == 0);
+    REQUIRE(libsvc.bannedCount() == 1);
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,181)) == 1);
+    REQUIRE(libsvc.bannedCount() == 0);
+    REQUIRE(db.checkBans());
+}
+
+TEST_CASE("Baneos: una sanción nueva deja obsoleta la anterior") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    libsvc.borrowCopy("C1","R1", d);
+    libsvc.borrowCopy("C2","R1", d);
+    libsvc.returnCopy("C1", LibraryService::addDays(d,31)); // hasta d+33
+    libsvc.returnCopy("C2", LibraryService::addDays(d,40)); // reemplaza: hasta d+60
+    REQUIRE(libsvc.bannedCount() == 1);
+
+    // advanceClock también vence baneos; la entrada de d+33 ya no vale
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,34), [](const OverdueLoan&) {}) == 0);
+    REQUIRE(db.readers.at("R1").activeBanUntil == LibraryService::addDays(d,60));
+    REQUIRE(libsvc.bannedCount() == 1);
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,61)) == 1);
+    REQUIRE(libsvc.bannedCount() == 0);
+
+    // Un baneo puesto a mano entra con rebuildIndexes; si ya pasó, sale en el próximo avance
+    db.readers["R2"].activeBanUntil = LibraryService::addDays(d,10);
+    REQUIRE_FALSE(db.checkBans());
+    db.rebuildIndexes();
+    REQUIRE(db.checkBans());
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,62)) == 1);
+    REQUIRE(libsvc.bannedCount() == 0);
+}
+
+TEST_CASE("Disponibilidad: borrowAnyCopy toma una copia libre del libro") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    db.readers["R3"] = Reader{ "R3","carol@example.com", {}, {} };
+    db.rebuildIndexes();
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::IN_LIBRARY) == 2);
+    const string L1 = libsvc.borrowAnyCopy("B1","R1", d);
+    const string L2 = libsvc.borrowAnyCopy("B1","R2", d);
+    REQUIRE(db.loans.at(L1).copy != db.loans.at(L2).copy);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::LOANED) == 2);
+    REQUIRE_FALSE(libsvc.findAvailableCopy("B1").has_value());
+    REQUIRE(libsvc.tryBorrowAnyCopy("B1","R3", d).error() == LibError::CopyNotAvailable);
+    REQUIRE(libsvc.tryBorrowAnyCopy("B9","R3", d).error() == LibError::BookNotFound);
+    REQUIRE(libsvc.tryBorrowAnyCopy("B2","R3", d).error() == LibError::CopyNotAvailable); // sin copias
+    REQUIRE(db.checkIndexes());
+
+    // La devuelta vuelve a la lista; LATE cuenta aparte
+    libsvc.returnCopy(db.copies.idOf(db.loans.at(L1).copy), d);
+    REQUIRE(libsvc.findAvailableCopy("B1") == db.copies.idOf(db.loans.at(L1).copy));
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,31), [](const OverdueLoan&) {}) == 1);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::LATE) == 1);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::IN_LIBRARY) == 1);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Disponibilidad: copias cargadas a mano y estados cambiados fuera del servicio") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    // C1 se indexa al prestarse por ID aunque nadie llamara a rebuildIndexes
+    libsvc.borrowCopy("C1","R1", d);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::LOANED) == 1);
+    db.rebuildIndexes();
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::IN_LIBRARY) == 1);
+
+    // C2 pasa a REPAIR a mano: borrowAnyCopy la descarta y corrige el índice
+    db.copies["C2"].status = CopyStatus::REPAIR;
+    REQUIRE(libsvc.tryBorrowAnyCopy("B1","R2", d).error() == LibError::CopyNotAvailable);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::REPAIR) == 1);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Disponibilidad: borrowAnyCopy concurrente no reparte una copia dos veces") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    constexpr int kThreads = 4, kPerThread = 6;
+    for (int i = 0; i < kThreads * kPerThread; ++i) {
+        db.copies["X" + to_string(i)] = Copy{ "X" + to_string(i), "B1", CopyStatus::IN_LIBRARY };
+        db.readers["Q" + to_string(i)] = Reader{ "Q" + to_string(i), "q@example.com", {}, {} };
+    }
+    db.rebuildIndexes();
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+
+    std::atomic<int> ok{0};
+    vector<thread> ts;
+    for (int t = 0; t < kThreads; ++t) {
+        ts.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; ++i)
+                if (libsvc.tryBorrowAnyCopy("B1", "Q" + to_string(t * kPerThread + i), d)) ++ok;
+        });
+    }
+    for (auto& th : ts) th.join();
+    REQUIRE(ok == kThreads * kPerThread);                          // 24 de las 26 copias
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::IN_LIBRARY) == 2); // C1 y C2
+    REQUIRE(db.openLoanByCopy.size() == std::size_t(kThreads * kPerThread));
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Histórico: archiveReturned saca los devueltos y los agregados cuadran") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    db.copies["C3"] = Copy{ "C3","B1", CopyStatus::IN_LIBRARY };
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+    libsvc.returnCopy("C1", LibraryService::addDays(d,10));            // a tiempo
+    string L2 = libsvc.borrowCopy("C2","R2", d);
+    libsvc.returnCopy("C2", LibraryService::addDays(d,35));            // 5 días tarde
+    libsvc.borrowOriginalNewRelease("B2","R2", makeDate(2025,11,20)); // ya sin baneo
+    libsvc.returnOriginalNewRelease("B2","R2", makeDate(2025,11,27)); // original: 7 días de plazo
+    string L4 = libsvc.borrowCopy("C3","R1", LibraryService::addDays(d,12)); // sigue abierto
+    db.loans["MANUAL-1"] = Loan{ *db.copies.lookup("C1"), *db.books.lookup("B1"), *db.readers.lookup("R1"),
+                                 d, LibraryService::addDays(d,30), LibraryService::addDays(d,32) };      // ID sin forma "L<n>", 2 días tarde
+
+    // Sólo los devueltos antes de la fecha
+    REQUIRE(libsvc.archiveReturned(LibraryService::addDays(d,11)) == 1);
+    REQUIRE(libsvc.archiveReturned(makeDate(2026,1,1)) == 3);
+    REQUIRE(libsvc.archiveReturned(makeDate(2026,1,1)) == 0);
+    REQUIRE(db.loans.size() == 1);
+    REQUIRE(db.loans.contains(L4));
+    REQUIRE(db.checkIndexes());
+
+    libsvc.queryArchive([&](const LoanArchive& ar) {
+        REQUIRE(ar.size() == 4);
+        REQUIRE(ar.segmentStarts().size() == 2);
+        REQUIRE(ar.contains(L1));
+        REQUIRE(ar.contains("MANUAL-1"));
+        REQUIRE_FALSE(ar.contains(L4));
+        const auto r2 = ar.row(*ar.find(L2));
+        REQUIRE(db.readers.idOf(r2.reader) == "R2");
+        REQUIRE(r2.returned == LibraryService::addDays(d,35));
+        REQUIRE(ar.idOf(*ar.find("MANUAL-1")) == "MANUAL-1");
+        REQUIRE(ar.row(*ar.find("MANUAL-1")).copy == *db.copies.lookup("C1"));
+
+        REQUIRE(ar.countLate() == 2);
+        REQUIRE(ar.totalLateDays() == 7);
+        REQUIRE(ar.lateDaysHistogram(4) == vector<uint64_t>{2, 0, 1, 1}); // 0, 0, 2, 5 (>=3)
+        REQUIRE(ar.countByBook(*db.books.lookup("B1")) == 3);
+        const int oct = LoanArchive::monthOf(d);
+        REQUIRE(ar.monthlyLoans(*db.books.lookup("B1"), oct, 2) == vector<uint32_t>{3, 0});
+        REQUIRE(ar.monthlyLoans(*db.books.lookup("B2"), oct, 2) == vector<uint32_t>{0, 1});
+        REQUIRE(ar.monthlyLoans(*db.books.lookup("B2"), oct + 2, 3) == vector<uint32_t>{0, 0, 0});
+    });
+
+    // El servicio sigue normal tras archivar: vencimientos y préstamos nuevos
+    vector<OverdueLoan> seen;
+    REQUIRE(libsvc.advanceClock(makeDate(2025,12,1), [&](const OverdueLoan& o) { seen.push_back(o); }) == 1);
+    REQUIRE(db.loans.idOf(seen[0].loan) == L4);
+    string L5 = libsvc.borrowCopy("C1","R2", makeDate(2025,12,1));
+    REQUIRE(parseLoanId(L5).value() > parseLoanId(L4).value());
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Histórico: snapshot v2 lo conserva y el WAL no resucita préstamos archivados") {
+    BioAlert::getInstance().reset();
+    const auto walPath = tempPath("biblioteca_archive.log");
+    const auto snapPath = tempPath("biblioteca_archive.snap");
+    MemoryDb db; seedMinimal(db);
+    auto d = makeDate(2025,10,1);
+    string L1, L2;
+    {
+        WriteAheadLog wal(walPath);
+        LibraryService libsvc(db, &wal);
+        L1 = libsvc.borrowCopy("C1","R1", d);
+        libsvc.returnCopy("C1", LibraryService::addDays(d,40));  // 10 días tarde
+        L2 = libsvc.borrowCopy("C2","R2", d);
+        REQUIRE(libsvc.archiveReturned(makeDate(2026,1,1)) == 1);
+        libsvc.writeSnapshot(snapPath);
+    }
+    {
+        SnapshotView view(snapPath);
+        REQUIRE(view.loanCount() == 1);
+        REQUIRE(view.archivedLoanCount() == 1);
+    }
+
+    MemoryDb restored;
+    loadSnapshot(restored, snapPath);
+    REQUIRE(restored.checkIndexes());
+    REQUIRE(restored.archive.size() == 1);
+    REQUIRE(restored.archive.totalLateDays() == 10);
+    const auto row = restored.archive.row(*restored.archive.find(L1));
+    REQUIRE(restored.copies.idOf(row.copy) == "C1");
+    REQUIRE(restored.readers.idOf(row.reader) == "R1");
+    REQUIRE(row.start == d);
+
+    // El log entero encima del snapshot: el préstamo archivado no vuelve a `loans`
+    LibraryService svc(restored);
+    readWal(walPath, [&](const WalRecord& r) { svc.applyLogRecord(r); });
+    REQUIRE_FALSE(restored.loans.contains(L1));
+    REQUIRE(restored.loans.contains(L2));
+    REQUIRE(restored.copies.at("C1").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(restored.checkIndexes());
+    REQUIRE(parseLoanId(svc.borrowCopy("C1","R2", d)).value() == 3);
+    std::filesystem::remove(walPath);
+    std::filesystem::remove(snapPath);
+}
+
+namespace {
+// memory_resource que cuenta las reservas que le llegan
+struct CountingResource : std::pmr::memory_resource {
+    std::size_t allocations{0};
+    void* do_allocate(std::size_t n, std::size_t align) override {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(n, align);
+    }
+    void do_deallocate(void* p, std::size_t n, std::size_t align) override {
+        std::pmr::new_delete_resource()->deallocate(p, n, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+};
+} // namespace
+
+TEST_CASE("Memoria: préstamos e índices salen del arena de MemoryDb") {
+    BioAlert::getInstance().reset();
+    CountingResource arena;
+    MemoryDb db(&arena);
+    const std::size_t empty = arena.allocations;
+    seedMinimal(db);
+    REQUIRE(arena.allocations == empty); // el catálogo usa el recurso por defecto
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    string L1 = libsvc.borrowCopy("C1","R1", d);
+    libsvc.borrowOriginalNewRelease("B2","R2", d);
+    REQUIRE(arena.allocations > empty);
+    libsvc.returnCopy("C1", d);
+    REQUIRE(db.loans.at(L1).returned == d);
+    REQUIRE(db.checkIndexes());
+
+    // Sin pool, cada préstamo reserva al menos su nodo en openLoanByCopy;
+    // con pool, devolver y volver a prestar recicla esos nodos
+    auto cycles = [&](LibraryService& svc, int n) {
+        for (int i = 0; i < n; ++i) { svc.borrowCopy("C2","R1", d); svc.returnCopy("C2", d); }
+    };
+    const std::size_t before = arena.allocations;
+    cycles(libsvc, 64);
+    REQUIRE(arena.allocations - before >= 64);
+
+    CountingResource upstream;
+    std::pmr::unsynchronized_pool_resource pool(&upstream);
+    MemoryDb pooled(&pool); seedMinimal(pooled);
+    LibraryService svc(pooled);
+    cycles(svc, 8);
+    const std::size_t warm = upstream.allocations;
+    cycles(svc, 64);
+    REQUIRE(upstream.allocations - warm < 16);
+    REQUIRE(pooled.checkIndexes());
+    REQUIRE(pooled.loans.size() == 72);
+}
+
+TEST_CASE("Vistas: versiones inmutables al día con las mutaciones del servicio") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    auto d = makeDate(2025,10,1);
+    string L0 = libsvc.borrowCopy("C1","R1", d); // antes de enganchar: entra en la versión 0
+
+    ReadViews views;
+    REQUIRE(views.current() == nullptr);
+    libsvc.attachViews(&views);
+    auto v0 = views.current();
+    REQUIRE(v0->version == 0);
+    REQUIRE(v0->loans->table.contains(L0));
+
+    string L1 = libsvc.borrowCopy("C2","R2", d);
+    libsvc.borrowOriginalNewRelease("B2","R2", d);
+    auto v1 = views.latest();
+    REQUIRE(v1->version == 2);
+    REQUIRE(v1->copies->table.at("C2").status == CopyStatus::LOANED);
+    REQUIRE(v1->readers->table.at("R2").activeLoanIds.size() == 2);
+    REQUIRE(v1->materialize().checkIndexes());
+    REQUIRE_FALSE(v0->loans->table.contains(L1)); // la versión vieja no cambia
+
+    // Vencimientos, baneos y archivado también llegan
+    REQUIRE(libsvc.advanceClock(LibraryService::addDays(d,31), [](const OverdueLoan&) {}) == 3);
+    libsvc.returnCopy("C1", LibraryService::addDays(d,35)); // 5 días tarde: baneo hasta el día 45
+    REQUIRE(libsvc.expireBans(LibraryService::addDays(d,60)) == 1);
+    REQUIRE(libsvc.archiveReturned(makeDate(2026,1,1)) == 1);
+    const auto v2 = views.latest();
+    REQUIRE(v2->version == 7); // + 2 LATE, devolución, baneo levantado y archivado
+    REQUIRE(v2->copies->table.at("C2").status == CopyStatus::LATE);
+    REQUIRE(v2->copies->table.at("C1").status == CopyStatus::IN_LIBRARY);
+    REQUIRE_FALSE(v2->readers->table.at("R1").activeBanUntil.has_value());
+    REQUIRE_FALSE(v2->loans->table.contains(L0));
+    REQUIRE(v2->materialize().archive.empty());
+    REQUIRE(v2->materialize().checkIndexes());
+    REQUIRE(v2->materialize().checkBans());
+    REQUIRE(v1->copies->table.at("C2").status == CopyStatus::LOANED);
+    REQUIRE(dbState(v2->materialize()) == dbState(db));
+
+    // Las versiones soltadas las libera el hilo de las vistas: sólo queda v2
+    v0.reset();
+    v1.reset();
+    const std::uint64_t published = views.stats().published;
+    REQUIRE(published >= 3);
+    for (int i = 0; i < 1000 && views.stats().reclaimed < published - 1; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    REQUIRE(views.stats().reclaimed == published - 1);
+
+    // Desenganchadas, las vistas ya publicadas siguen valiendo
+    libsvc.attachViews(nullptr);
+    libsvc.borrowCopy("C1","R2", LibraryService::addDays(d,60));
+    REQUIRE(views.latest()->version == 7);
+}
+
+TEST_CASE("Vistas: cada versión copia sólo las tablas que cambiaron") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    const auto d = makeDate(2025, 10, 1);
+    ReadViews views;
+    libsvc.attachViews(&views);
+    const auto v0 = views.current();
+    REQUIRE(views.stats().tablesCopied == 4);
+
+    // Un préstamo toca copias, lectores y préstamos; los libros se comparten
+    libsvc.borrowCopy("C1", "R1", d);
+    const auto v1 = views.latest();
+    REQUIRE(v1->books == v0->books);
+    REQUIRE(v1->copies != v0->copies);
+    REQUIRE(v1->readers != v0->readers);
+    REQUIRE(v1->loans != v0->loans);
+    REQUIRE(views.stats().tablesCopied == 7);
+
+    // Marcarlo LATE sólo toca las copias
+    REQUIRE(libsvc.advanceClock(d + std::chrono::days(31), [](const OverdueLoan&) {}) == 1);
+    const auto v2 = views.latest();
+    REQUIRE(v2->version == 2);
+    REQUIRE(v2->copies->table.at("C1").status == CopyStatus::LATE);
+    REQUIRE(v1->copies->table.at("C1").status == CopyStatus::LOANED);
+    REQUIRE(v2->books == v0->books);
+    REQUIRE(v2->readers == v1->readers);
+    REQUIRE(v2->loans == v1->loans);
+    REQUIRE(views.stats().tablesCopied == 8);
+    REQUIRE(v2->materialize().checkIndexes());
+    REQUIRE(dbState(v2->materialize()) == dbState(db));
+}
+
+TEST_CASE("Vistas: los informes leen versiones consistentes sin frenar préstamos") {
+    BioAlert::getInstance().reset();
+    MemoryDb db;
+    WorkloadConfig cfg;
+    cfg.books = 32; cfg.copiesPerBook = 2; cfg.readers = 128; cfg.events = 6000; cfg.newReleaseFraction = 0.1;
+    populateWorkload(db, cfg);
+    const auto events = generateWorkload(cfg);
+    LibraryService libsvc(db);
+    ReadViews views(ReadViews::Options{std::chrono::milliseconds(1)});
+    libsvc.attachViews(&views);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::uint64_t seen = 0, last = 0;
+    std::thread reporter([&] {
+        while (!done.load()) {
+            const auto v = views.current();
+            if (v->version < last || !v->materialize().checkIndexes() || !v->materialize().checkBans()) bad++;
+            std::size_t lent = 0;
+            for (auto& kv : v->copies->table) lent += kv.second.status != CopyStatus::IN_LIBRARY;
+            if (lent != v->loans->openLoanByCopy.size()) bad++;
+            last = v->version;
+            ++seen;
+        }
+    });
+    replayWorkload(libsvc, events, 4);
+    done = true;
+    reporter.join();
+
+    REQUIRE(bad == 0);
+    REQUIRE(seen > 0);
+    const auto v = views.latest();
+    REQUIRE(v->version == views.stats().changes);
+    REQUIRE(dbState(v->materialize()) == dbState(db));
+}
+
+// Catálogo de sedes para los tests: libros B1 (normal) y B2 (new release),
+// lectores R1..Rn y copias C1..Cm de B1 repartidas por turno entre sedes
+static void loadBranches(ShardedLibrary& lib, std::size_t copies, std::size_t readers) {
+    lib.addBook(Book{"B1", "Libro", 2000, Author{"A", "1970-01-01"}, "1st", false});
+    lib.addBook(Book{"B2", "Novedad", 2025, Author{"A", "1970-01-01"}, "1st", true});
+    for (std::size_t i = 1; i <= readers; ++i)
+        lib.addReader(Reader{"R" + to_string(i), "r" + to_string(i) + "@x", {}, {}});
+    for (std::size_t i = 1; i <= copies; ++i)
+        lib.addCopy(Copy{"C" + to_string(i), "B1", CopyStatus::IN_LIBRARY}, (i - 1) % lib.shardCount());
+}
+
+TEST_CASE("Sedes: cada operación va a su shard y el tope de 3 es global") {
+    BioAlert alerts;
+    ShardedLibrary lib(2, alerts);
+    loadBranches(lib, 4, 2);
+    const auto d = makeDate(2025, 10, 1);
+    REQUIRE(lib.shardOfCopy("C1") == 0u);
+    REQUIRE(lib.shardOfCopy("C2") == 1u);
+    REQUIRE_FALSE(lib.shardOfCopy("C9"));
+
+    const string l1 = lib.borrowCopy("C1", "R1", d);
+    const string l2 = lib.borrowCopy("C2", "R1", d);
+    REQUIRE(lib.db(0).loans.contains(l1));
+    REQUIRE(lib.db(1).loans.contains(l2));
+    REQUIRE_FALSE(lib.db(0).loans.contains(l2)); // cada sede numera en su rango
+    REQUIRE(lib.borrowOriginalNewRelease("B2", "R1", d).size() > 1);
+    REQUIRE(lib.db(lib.shardOfBook("B2")).newReleaseBorrowed.size() == 1);
+    REQUIRE(lib.activeLoanCount("R1") == 3);
+
+    // Cuarto préstamo, en cualquier sede: rechazado y sin dejar la copia tomada
+    REQUIRE(lib.tryBorrowCopy("C3", "R1", d).error() == LibError::BorrowForbidden);
+    REQUIRE(lib.tryBorrowCopy("C4", "R1", d).error() == LibError::BorrowForbidden);
+    REQUIRE(lib.tryBorrowCopy("C2", "R2", d).error() == LibError::CopyNotAvailable);
+    REQUIRE(lib.tryBorrowCopy("C9", "R2", d).error() == LibError::CopyNotFound);
+    REQUIRE(lib.tryBorrowCopy("C3", "R9", d).error() == LibError::ReaderNotFound);
+    REQUIRE(lib.borrowCopy("C3", "R2", d).size() > 1);
+    REQUIRE(lib.checkQuotas());
+
+    lib.returnCopy("C2", d);
+    REQUIRE(lib.tryReturnCopy("C2", d).error() == LibError::CopyNotLoaned);
+    REQUIRE(lib.activeLoanCount("R1") == 2);
+    REQUIRE(lib.borrowCopy("C4", "R1", d).size() > 1);
+    lib.returnOriginalNewRelease("B2", "R1", d);
+    REQUIRE(lib.activeLoanCount("R1") == 2);
+    REQUIRE(lib.checkQuotas());
+}
+
+TEST_CASE("Sedes: un baneo en una sede vale en todas y las copias se transfieren") {
+    BioAlert alerts;
+    ShardedLibrary lib(2, alerts);
+    loadBranches(lib, 4, 2);
+    const auto d = makeDate(2025, 10, 1);
+
+    // C1 (sede 0) vuelve 5 días tarde: baneado 10 días también en la sede 1
+    lib.borrowCopy("C1", "R1", d);
+    const auto back = d + std::chrono::days(35);
+    lib.returnCopy("C1", back);
+    REQUIRE(lib.isBanned("R1", back + std::chrono::days(10)));
+    REQUIRE(lib.tryBorrowCopy("C2", "R1", back + std::chrono::days(1)).error() == LibError::BorrowForbidden);
+    REQUIRE_FALSE(lib.db(1).readers.at("R1").activeBanUntil); // la sede 1 no lo tenía
+    REQUIRE(lib.borrowCopy("C2", "R1", back + std::chrono::days(11)).size() > 1);
+    lib.returnCopy("C2", back + std::chrono::days(11));
+
+    // C3 pasa de la sede 0 a la 1: en la 0 queda su fila como TRANSFERRED
+    const std::size_t rows0 = lib.db(0).copies.size();
+    lib.transferCopy("C3", 1);
+    REQUIRE(lib.shardOfCopy("C3") == 1u);
+    REQUIRE(lib.db(0).copies.at("C3").status == CopyStatus::TRANSFERRED);
+    REQUIRE(lib.service(0).countCopies("B1", CopyStatus::TRANSFERRED) == 1);
+    REQUIRE(lib.service(1).countCopies("B1", CopyStatus::IN_LIBRARY) == 3);
+    const string l = lib.borrowCopy("C3", "R2", d);
+    REQUIRE(lib.db(1).loans.contains(l));
+    REQUIRE(lib.tryTransferCopy("C3", 0).error() == LibError::CopyNotAvailable);
+    REQUIRE(lib.checkQuotas());
+    lib.returnCopy("C3", d);
+
+    // De vuelta a la sede 0: reaprovecha la fila y deja la de la 1 como TRANSFERRED
+    lib.transferCopy("C3", 0);
+    REQUIRE(lib.db(0).copies.size() == rows0);
+    REQUIRE(lib.db(0).copies.at("C3").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(lib.db(1).copies.at("C3").status == CopyStatus::TRANSFERRED);
+    REQUIRE(lib.tryTransferCopy("C9", 1).error() == LibError::CopyNotFound);
+    REQUIRE_THROWS_AS(lib.transferCopy("C3", 2), std::out_of_range);
+    REQUIRE(lib.db(0).checkIndexes());
+    REQUIRE(lib.db(1).checkIndexes());
+    REQUIRE(lib.checkQuotas());
+
+    // Su fila en la sede 1 cambiada por fuera: el traslado falla y la copia
+    // sigue libre en la 0
+    REQUIRE(lib.service(1).tryChangeCopyStatus(*lib.db(1).copies.lookup("C3"), CopyStatus::TRANSFERRED,
+                                                CopyStatus::REPAIR));
+    REQUIRE(lib.tryTransferCopy("C3", 1).error() == LibError::CopyNotAvailable);
+    REQUIRE(lib.shardOfCopy("C3") == 0u);
+    REQUIRE(lib.db(0).copies.at("C3").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(lib.borrowCopy("C3", "R2", d).size() > 1);
+    lib.returnCopy("C3", d);
+    REQUIRE(lib.db(0).checkIndexes());
+    REQUIRE(lib.service(1).tryChangeCopyStatus(*lib.db(1).copies.lookup("C3"), CopyStatus::REPAIR,
+                                                CopyStatus::TRANSFERRED));
+    REQUIRE(lib.checkQuotas());
+    REQUIRE(lib.tryReturnOriginalNewRelease("B2", "R9", d).error() == LibError::ReaderNotFound);
+
+    // Los vencidos de todas las sedes salen por el mismo sink
+    lib.borrowCopy("C1", "R2", d);
+    std::size_t overdue = 0;
+    REQUIRE(lib.advanceClock(d + std::chrono::days(31), [&](std::size_t shard, const OverdueLoan&) {
+        REQUIRE(shard == 0);
+        ++overdue;
+    }) == 1);
+    REQUIRE(overdue == 1);
+    REQUIRE(lib.db(0).copies.at("C1").status == CopyStatus::LATE);
+}
+
+TEST_CASE("Sedes: tope, plazo y sanción vienen de las reglas de la biblioteca") {
+    BioAlert alerts;
+    ShardedLibrary lib(2, alerts, RuntimeLoanPolicy{7, 5, 3});
+    loadBranches(lib, 8, 2);
+    const auto d = makeDate(2025, 10, 1);
+    REQUIRE(lib.policy().maxActiveLoans() == 5);
+
+    // Cinco préstamos repartidos entre las dos sedes; el sexto, rechazado
+    for (int i = 1; i <= 5; ++i) {
+        const string loan = lib.borrowCopy("C" + to_string(i), "R1", d);
+        REQUIRE(lib.db(*lib.shardOfCopy("C" + to_string(i))).loans.at(loan).due == d + std::chrono::days(7));
+    }
+    REQUIRE(lib.activeLoanCount("R1") == 5);
+    REQUIRE(lib.tryBorrowCopy("C6", "R1", d).error() == LibError::BorrowForbidden);
+    REQUIRE(lib.checkQuotas());
+
+    // Dos días tarde: 6 días de baneo, también en la otra sede
+    lib.returnCopy("C1", d + std::chrono::days(9));
+    REQUIRE(lib.isBanned("R1", d + std::chrono::days(15)));
+    REQUIRE_FALSE(lib.isBanned("R1", d + std::chrono::days(16)));
+    REQUIRE(lib.tryBorrowCopy("C6", "R1", d + std::chrono::days(15)).error() == LibError::BorrowForbidden);
+    REQUIRE(lib.borrowCopy("C6", "R1", d + std::chrono::days(16)).size() > 1);
+    REQUIRE(lib.checkQuotas());
+}
+
+TEST_CASE("Sedes: préstamos, devoluciones y traslados concurrentes respetan las cuotas") {
+    BioAlert alerts;
+    ShardedLibrary lib(4, alerts);
+    loadBranches(lib, 64, 16);
+    const auto d = makeDate(2025, 10, 1);
+    constexpr int kThreads = 4, kOps = 4000;
+    std::atomic<std::size_t> lent{0};
+    std::atomic<int> overLimit{0};
+    std::vector<std::thread> ts;
+    for (int t = 0; t < kThreads; ++t) {
+        ts.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            for (int i = 0; i < kOps; ++i) {
+                const string c = "C" + to_string(1 + rng() % 64);
+                const string r = "R" + to_string(1 + rng() % 16);
+                switch (rng() % 8) {
+                case 0: (void)lib.tryTransferCopy(c, rng() % 4); break;
+                case 1: case 2: case 3: (void)lib.tryReturnCopy(c, d); break;
+                default:
+                    if (lib.tryBorrowCopy(c, r, d)) lent++;
+                    if (lib.activeLoanCount(r) > kMaxActiveLoans) overLimit++;
+                }
+            }
+        });
+    }
+    for (auto& t : ts) t.join();
+
+    REQUIRE(lent > 0);
+    REQUIRE(overLimit == 0);
+    REQUIRE(lib.checkQuotas());
+    std::size_t open = 0;
+    for (std::size_t s = 0; s < lib.shardCount(); ++s) {
+        REQUIRE(lib.db(s).checkIndexes());
+        open += lib.db(s).openLoanByCopy.size();
+    }
+    std::size_t quota = 0;
+    for (int i = 1; i <= 16; ++i) quota += lib.activeLoanCount("R" + to_string(i));
+    REQUIRE(open == quota);
+}
+
+// Política fija de una sede: préstamos cortos, tope 5 y sanción 3x. Se
+// instancia aquí mismo con library_service_impl.hpp.
+struct ShortLoanPolicy {
+    static constexpr int loanDays() { return 7; }
+    static constexpr std::size_t maxActiveLoans() { return 5; }
+    static constexpr int banMultiplier() { return 3; }
+};
+template class lib::BasicLibraryService<ShortLoanPolicy>;
+
+TEST_CASE("Reglas: plazo, tope y sanción vienen de la política") {
+    static_assert(sizeof(BasicLibraryService<ShortLoanPolicy>) == sizeof(LibraryService)); // sin estado
+    BioAlert alerts;
+    MemoryDb db;
+    db.books["B1"] = Book{"B1", "Libro", 2000, Author{"A", "1970-01-01"}, "1st", false};
+    for (int i = 1; i <= 6; ++i) {
+        const string c = "C" + to_string(i);
+        db.copies[c] = Copy{c, "B1", CopyStatus::IN_LIBRARY};
+    }
+    db.readers["R1"] = Reader{"R1", "r1@x", {}, {}};
+    db.readers["R2"] = Reader{"R2", "r2@x", {}, {}};
+    BasicLibraryService<ShortLoanPolicy> libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+
+    const string l1 = libsvc.borrowCopy("C1", "R1", d);
+    REQUIRE(db.loans.at(l1).due == d + std::chrono::days(7));
+    for (int i = 2; i <= 5; ++i) libsvc.borrowCopy("C" + to_string(i), "R1", d);
+    REQUIRE(libsvc.tryBorrowCopy("C6", "R1", d).error() == LibError::BorrowForbidden);
+    const string batch[] = {"C6"};
+    REQUIRE(libsvc.borrowBatch("R1", batch, d).items[0].error == LibError::BorrowForbidden);
+
+    // 2 días tarde: 6 días de baneo
+    libsvc.returnCopy("C1", d + std::chrono::days(9));
+    REQUIRE(db.readers.at("R1").activeBanUntil == d + std::chrono::days(15));
+
+    // Las mismas reglas en ejecución, y las vistas replican con ellas
+    MemoryDb db2;
+    db2.books["B1"] = db.books.at("B1");
+    db2.copies["C1"] = Copy{"C1", "B1", CopyStatus::IN_LIBRARY};
+    db2.readers["R1"] = Reader{"R1", "r1@x", {}, {}};
+    ConfigurableLibraryService tenant(db2, alerts, RuntimeLoanPolicy::of(ShortLoanPolicy{}));
+    ReadViews views;
+    tenant.attachViews(&views);
+    tenant.borrowCopy("C1", "R1", d);
+    tenant.returnCopy("C1", d + std::chrono::days(9));
+    REQUIRE(db2.readers.at("R1").activeBanUntil == d + std::chrono::days(15));
+    const auto v = views.latest();
+    REQUIRE(v->readers->table.at("R1").activeBanUntil == d + std::chrono::days(15));
+    REQUIRE(dbState(v->materialize()) == dbState(db2));
+
+    REQUIRE_THROWS_AS(ConfigurableLibraryService(db2, alerts, RuntimeLoanPolicy{30, kActiveLoansCapacity + 1, 2}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(ConfigurableLibraryService(db2, alerts, RuntimeLoanPolicy{0, 3, 2}), std::invalid_argument);
+}
+
+TEST_CASE("Importación: CSV por bloques entra con sus índices") {
+    MemoryDb db;
+    std::istringstream books(
+        "id,title,year,authorName,authorBirthDate,edition,isNewRelease\n"
+        "B1,\"Software Engineering, 10th\",2020,Ian Sommerville,1951-08-23,10th,0\r\n"
+        "B2,\"El \"\"original\"\"\",2025,Some Author,1980-01-01,1st,1\n");
+    std::istringstream readers("id,email,banUntil\nR1,r1@x\nR2,r2@x,2025-10-20\n\nR3,r3@x,\n");
+    std::istringstream copies("id,bookId,status\nC1,B1\nC2,B1,IN_LIBRARY\nC3,B1,REPAIR\nC4,B1");
+    // Bloques de pocos bytes: casi todas las líneas cruzan de un bloque al siguiente
+    BulkImporter importer(db, ImportOptions{1, 16});
+    importer.importBooks(books);
+    importer.importReaders(readers);
+    importer.importCopies(copies);
+    const ImportReport& rep = importer.report();
+    REQUIRE(rep.ok());
+    REQUIRE(rep.books == 2);
+    REQUIRE(rep.readers == 3);
+    REQUIRE(rep.copies == 4);
+
+    REQUIRE(db.books.at("B1").title == "Software Engineering, 10th");
+    REQUIRE(db.books.at("B1").edition == "10th");
+    REQUIRE(db.books.at("B2").title == "El \"original\"");
+    REQUIRE(db.books.at("B2").isNewRelease);
+    REQUIRE(db.readers.at("R2").activeBanUntil == makeDate(2025, 10, 20));
+    REQUIRE_FALSE(db.readers.at("R3").activeBanUntil);
+    REQUIRE(db.copies.at("C3").status == CopyStatus::REPAIR);
+    REQUIRE(db.checkIndexes());
+    REQUIRE(db.checkBans());
+
+    // El servicio arranca sobre lo importado sin rebuildIndexes
+    BioAlert alerts;
+    LibraryService libsvc(db, alerts);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::IN_LIBRARY) == 3);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::REPAIR) == 1);
+    const auto d = makeDate(2025, 10, 1);
+    REQUIRE(libsvc.tryBorrowAnyCopy("B1", "R2", d).error() == LibError::BorrowForbidden);
+    libsvc.borrowAnyCopy("B1", "R1", d);
+    libsvc.expireBans(makeDate(2025, 10, 21));
+    REQUIRE_FALSE(db.readers.at("R2").activeBanUntil);
+}
+
+TEST_CASE("Importación: las líneas inválidas se rechazan con su línea y motivo") {
+    MemoryDb db;
+    std::istringstream books(
+        "B1,Libro,2000,A,1970-01-01,1st,0\n"
+        "B1,Repetido,2000,A,1970-01-01,1st,0\n"
+        "B2,Libro,dos mil,A,1970-01-01,1st,0\n"
+        "B3,\"sin cerrar,2000,A,1970-01-01,1st,0\n"
+        "B4,Corto,2000\n");
+    std::istringstream readers("R1,r1@x,2025-02-30\nR2,r2@x\nR2,otra@x\n");
+    std::istringstream copies("C1,B1,LOANED\nC2,B9\nC3,B1,PERDIDA\nC4,B1\n");
+    BulkImporter importer(db, ImportOptions{1, 1024, 100, false});
+    importer.importBooks(books);
+    importer.importReaders(readers);
+    importer.importCopies(copies);
+    const ImportReport& rep = importer.report();
+    REQUIRE(rep.books == 1);
+    REQUIRE(rep.readers == 1);
+    REQUIRE(rep.copies == 1);
+    REQUIRE(rep.rejected == 9);
+
+    std::vector<std::string> got;
+    for (const ImportError& e : rep.errors)
+        got.push_back(std::to_string(int(e.table)) + ":" + std::to_string(e.line) + ":" + importIssueCode(e.issue));
+    std::sort(got.begin(), got.end());
+    const std::vector<std::string> want{
+        "0:2:DUPLICATE_ID", "0:3:BAD_NUMBER", "0:4:MALFORMED_RECORD", "0:5:MALFORMED_RECORD",
+        "1:1:BAD_DATE",     "1:3:DUPLICATE_ID",
+        "2:1:BAD_STATUS",   "2:2:UNKNOWN_BOOK", "2:3:BAD_STATUS"};
+    REQUIRE(got == want);
+    REQUIRE(db.copies.contains("C4"));
+    REQUIRE(db.checkIndexes());
+
+    // Sólo se detallan los primeros maxErrors; el resto cuenta
+    MemoryDb db2;
+    std::istringstream bad("x\ny\nz\n");
+    BulkImporter capped(db2, ImportOptions{1, 1024, 2, false});
+    capped.importBooks(bad);
+    REQUIRE(capped.report().rejected == 3);
+    REQUIRE(capped.report().errors.size() == 2);
+
+    REQUIRE_THROWS_WITH(importCatalog(db2, "/nonexistent/books.csv", "r.csv", "c.csv"), "IMPORT_NOT_FOUND");
+}
+
+TEST_CASE("Importación: el análisis en paralelo da lo mismo que en un hilo") {
+    const std::string booksPath = tempPath("biblioteca_import_books.csv");
+    const std::string readersPath = tempPath("biblioteca_import_readers.csv");
+    const std::string copiesPath = tempPath("biblioteca_import_copies.csv");
+    {
+        std::ofstream b(booksPath), r(readersPath), c(copiesPath);
+        b << "id,title,year,authorName,authorBirthDate,edition,isNewRelease\n";
+        r << "id,email,banUntil\n";
+        c << "id,bookId,status\n";
+        for (int i = 0; i < 2000; ++i)
+            b << "B" << i << ",\"Título, tomo " << i << "\"," << 1900 + i % 125 << ",Autor,1970-01-01,1st,0\n";
+        for (int i = 0; i < 20000; ++i) {
+            r << "R" << i << ",r" << i << "@example.com";
+            if (i % 7 == 0) r << ",2025-11-" << 10 + i % 15;
+            r << "\n";
+        }
+        for (int i = 0; i < 30000; ++i) {
+            c << "C" << i << ",B" << (i % 2100) // los B2000.. no existen
+              << (i % 5 == 0 ? ",REPAIR" : "") << "\n";
+            if (i % 1000 == 999) c << "C0,B1\n"; // repetida
+        }
+    }
+
+    MemoryDb one, many;
+    const ImportReport a = importCatalog(one, booksPath, readersPath, copiesPath, ImportOptions{1, 1u << 20});
+    const ImportReport b = importCatalog(many, booksPath, readersPath, copiesPath, ImportOptions{4, 128u << 10});
+    REQUIRE(a.books == 2000);
+    REQUIRE(a.readers == 20000);
+    REQUIRE(a.copies == 30000 - 14 * 100);
+    REQUIRE(a.rejected == 14 * 100 + 30);
+    REQUIRE(a.rejected == b.rejected);
+    REQUIRE(a.books == b.books);
+    REQUIRE(a.readers == b.readers);
+    REQUIRE(a.copies == b.copies);
+    REQUIRE(dbState(one) == dbState(many));
+    for (auto& kv : one.books) REQUIRE(many.books.at(kv.first).title == kv.second.title);
+    REQUIRE(many.checkIndexes());
+    REQUIRE(many.checkBans());
+    std::vector<std::size_t> linesA, linesB;
+    for (auto& e : a.errors) linesA.push_back(e.line);
+    for (auto& e : b.errors) linesB.push_back(e.line);
+    REQUIRE(linesA == linesB);
+}
+
+TEST_CASE("Estados: recuentos e inventario del fondo por columnas") {
+    BioAlert alerts;
+    MemoryDb db;
+    db.books["B1"] = Book{"B1", "Libro", 2000, Author{"A", "1970-01-01"}, "1st", false};
+    db.books["B2"] = Book{"B2", "Otro", 2001, Author{"A", "1970-01-01"}, "1st", false};
+    // Más de un bloque de 255 para que el recuento cruce bloques
+    for (int i = 0; i < 1000; ++i) {
+        const string c = "C" + to_string(i);
+        db.copies[c] = Copy{c, i % 2 ? "B1" : "B2", i % 10 == 0 ? CopyStatus::REPAIR : CopyStatus::IN_LIBRARY};
+    }
+    db.copies["CX"] = Copy{"CX", "B9", CopyStatus::IN_LIBRARY}; // su libro no existe: no se indexa
+    db.readers["R1"] = Reader{"R1", "r1@x", {}, {}};
+    db.rebuildIndexes();
+    REQUIRE_FALSE(db.copyStates.tracked(*db.copies.lookup("CX")));
+    REQUIRE(db.copyStates.statusColumn().size() >= 1000);
+
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+    libsvc.borrowCopy("C1", "R1", d);
+    libsvc.borrowCopy("C3", "R1", d);
+    REQUIRE(libsvc.tryChangeCopyStatus(*db.copies.lookup("C5"), CopyStatus::IN_LIBRARY, CopyStatus::RESERVED));
+
+    auto counts = libsvc.countCopiesByStatus();
+    REQUIRE(counts[size_t(CopyStatus::REPAIR)] == 100);
+    REQUIRE(counts[size_t(CopyStatus::LOANED)] == 2);
+    REQUIRE(counts[size_t(CopyStatus::RESERVED)] == 1);
+    REQUIRE(counts[size_t(CopyStatus::IN_LIBRARY)] == 1000 - 100 - 3);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::LOANED) + libsvc.countCopies("B2", CopyStatus::LOANED) == 2);
+    REQUIRE(db.copyStates.count(CopyStatus::REPAIR) == 100);
+
+    REQUIRE(libsvc.copiesInStatus(CopyStatus::LOANED) == vector<string>{"C1", "C3"});
+    REQUIRE(libsvc.copiesInStatus(CopyStatus::REPAIR).size() == 100);
+
+    // Vencer y devolver mueve la columna con el registro
+    std::vector<OverdueLoan> overdue;
+    libsvc.advanceClock(d + std::chrono::days(40), [&](const OverdueLoan& o) { overdue.push_back(o); });
+    REQUIRE(libsvc.copiesInStatus(CopyStatus::LATE) == vector<string>{"C1", "C3"});
+    libsvc.returnCopy("C1", d + std::chrono::days(40));
+    counts = libsvc.countCopiesByStatus();
+    REQUIRE(counts[size_t(CopyStatus::LATE)] == 1);
+    REQUIRE(counts[size_t(CopyStatus::IN_LIBRARY)] == 1000 - 100 - 2);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Reservas: la copia devuelta se aparta para el primero de la cola con un solo aviso") {
+    TestEmailGateway gw;
+    BioAlert alerts;
+    alerts.setGateway(&gw);
+    MemoryDb db; seedMinimal(db);
+    db.copies.erase("C2"); // B1 con una sola copia
+    db.readers["R3"] = Reader{"R3", "r3@x", {}, {}};
+    db.readers["R4"] = Reader{"R4", "r4@x", {}, {}};
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+    for (const char* r : {"R2", "R3", "R4"}) alerts.subscribe("B1", r);
+
+    libsvc.borrowCopy("C1", "R1", d);
+    libsvc.reserve("B1", "R2", d);
+    libsvc.reserve("B1", "R3", d);
+    REQUIRE(libsvc.tryReserve("B1", "R2", d).error() == LibError::AlreadyReserved);
+    REQUIRE(libsvc.reservationCount("B1") == 2);
+    REQUIRE(gw.out.empty());
+
+    // Vuelve: apartada para R2 y un único email, sin avisar a los suscriptores
+    libsvc.returnCopy("C1", d + std::chrono::days(5));
+    REQUIRE(db.copies.at("C1").status == CopyStatus::RESERVED);
+    REQUIRE(libsvc.holdOf("C1") == "R2");
+    REQUIRE(libsvc.reservationCount("B1") == 1);
+    REQUIRE(gw.out.size() == 1);
+    REQUIRE(gw.out[0].to == db.readers.at("R2").email);
+    REQUIRE(gw.out[0].subject == "Apartado: Software Engineering");
+    REQUIRE(gw.out[0].body == "Te lo guardamos hasta el 2025-10-09");
+    REQUIRE(libsvc.tryReserve("B1", "R2", d).error() == LibError::AlreadyReserved); // ya la tiene apartada
+
+    // Sólo R2 se la lleva; borrowAnyCopy toma la apartada
+    REQUIRE(libsvc.tryBorrowCopy("C1", "R3", d + std::chrono::days(5)).error() == LibError::CopyNotAvailable);
+    REQUIRE(libsvc.tryBorrowAnyCopy("B1", "R4", d + std::chrono::days(5)).error() == LibError::CopyNotAvailable);
+    const string loan = libsvc.borrowAnyCopy("B1", "R2", d + std::chrono::days(6));
+    REQUIRE(db.loans.at(loan).copy == *db.copies.lookup("C1"));
+    REQUIRE_FALSE(libsvc.holdOf("C1"));
+    REQUIRE(db.checkIndexes());
+
+    // La siguiente devolución sirve a R3; con la cola vacía, la otra avisa a todos
+    libsvc.returnCopy("C1", d + std::chrono::days(7));
+    REQUIRE(libsvc.holdOf("C1") == "R3");
+    libsvc.borrowCopy("C1", "R3", d + std::chrono::days(7));
+    gw.out.clear();
+    libsvc.returnCopy("C1", d + std::chrono::days(8));
+    REQUIRE(db.copies.at("C1").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(gw.out.size() == 3);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Reservas: apartados que vencen, cancelaciones y lotes") {
+    TestEmailGateway gw;
+    BioAlert alerts;
+    alerts.setGateway(&gw);
+    MemoryDb db; seedMinimal(db);
+    db.readers["R3"] = Reader{"R3", "r3@x", {}, {}};
+    db.readers["R4"] = Reader{"R4", "r4@x", makeDate(2025, 12, 1), {}};
+    alerts.subscribe("B1", "R4");
+    db.rebuildIndexes();
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+
+    // Con copias libres se aparta ya
+    libsvc.reserve("B1", "R1", d);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::RESERVED) == 1);
+    const string c1 = libsvc.copiesInStatus(CopyStatus::RESERVED).at(0);
+    REQUIRE(libsvc.holdOf(c1) == "R1");
+    REQUIRE(gw.out.size() == 1);
+    REQUIRE(libsvc.tryReserve("B1", "R4", d).error() == LibError::BorrowForbidden);
+    REQUIRE(libsvc.tryCancelReservation("B1", "R3", d).error() == LibError::ReservationNotFound);
+
+    // La otra copia, prestada; R2 y R3 esperan
+    libsvc.borrowAnyCopy("B1", "R3", d);
+    libsvc.reserve("B1", "R2", d);
+    libsvc.reserve("B1", "R3", d);
+    REQUIRE(libsvc.tryCancelReservation("B1", "R3", d));
+    REQUIRE(libsvc.reservationCount("B1") == 1);
+    libsvc.reserve("B1", "R3", d); // vuelve al final de la cola
+
+    // R1 no la recoge: al vencer pasa a R2, que cancela, y luego a R3
+    gw.out.clear();
+    std::vector<OverdueLoan> overdue;
+    const auto late = d + std::chrono::days(kHoldDays + 1);
+    libsvc.advanceClock(late, [&](const OverdueLoan& o) { overdue.push_back(o); });
+    REQUIRE(libsvc.holdOf(c1) == "R2");
+    REQUIRE(gw.out.size() == 1);
+    REQUIRE(gw.out[0].to == db.readers.at("R2").email);
+    REQUIRE(libsvc.tryCancelReservation("B1", "R2", late));
+    REQUIRE(libsvc.holdOf(c1) == "R3");
+    REQUIRE(libsvc.reservationCount("B1") == 0);
+    REQUIRE(db.checkIndexes());
+
+    // Un snapshot no guarda el apartado
+    const auto path = tempPath("biblioteca_reservas.bin");
+    libsvc.writeSnapshot(path);
+    {
+        SnapshotView view(path);
+        MemoryDb restored;
+        view.materialize(restored);
+        REQUIRE(restored.copies.at(c1).status == CopyStatus::IN_LIBRARY);
+    }
+
+    // Nadie más en cola: al vencer vuelve IN_LIBRARY y avisa a los suscriptores
+    gw.out.clear();
+    REQUIRE(libsvc.expireHolds(late + std::chrono::days(kHoldDays + 1)) == 1);
+    REQUIRE(db.copies.at(c1).status == CopyStatus::IN_LIBRARY);
+    REQUIRE(gw.out.size() == 1);
+    REQUIRE(gw.out[0].to == "r4@x");
+
+    // Un lote de devoluciones aparta para la cola igual que una a una
+    const string other = c1 == "C1" ? "C2" : "C1";
+    libsvc.borrowCopy(c1, "R1", late);
+    libsvc.reserve("B1", "R2", late);
+    gw.out.clear();
+    const string batch[] = {c1, other};
+    REQUIRE(libsvc.returnBatch(batch, late).committed);
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::RESERVED) == 1);
+    REQUIRE(libsvc.holdOf(c1) == "R2");
+    REQUIRE(gw.out.size() == 2); // el apartado de R2 y el aviso habitual por la otra copia
+    REQUIRE(db.checkIndexes());
+
+    // Pasarla a mano a REPAIR suelta el apartado
+    REQUIRE(libsvc.tryChangeCopyStatus(*db.copies.lookup(c1), CopyStatus::RESERVED, CopyStatus::REPAIR));
+    REQUIRE_FALSE(libsvc.holdOf(c1));
+    REQUIRE(db.checkIndexes());
+
+    // Y devolverla a mano a IN_LIBRARY aparta para la cola con el día que se le pasa
+    REQUIRE(libsvc.tryChangeCopyStatus(*db.copies.lookup(other), CopyStatus::IN_LIBRARY, CopyStatus::REPAIR));
+    libsvc.reserve("B1", "R3", late);
+    REQUIRE(libsvc.tryChangeCopyStatus(*db.copies.lookup(c1), CopyStatus::REPAIR, CopyStatus::IN_LIBRARY, late));
+    REQUIRE(libsvc.holdOf(c1) == "R3");
+    REQUIRE(libsvc.expireHolds(late + std::chrono::days(kHoldDays)) == 0);
+    REQUIRE(libsvc.expireHolds(late + std::chrono::days(kHoldDays + 1)) == 1);
+    REQUIRE(db.copies.at(c1).status == CopyStatus::IN_LIBRARY);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Reservas: una copia RESERVED sin apartado se presta como libre") {
+    BioAlert alerts;
+    MemoryDb db; seedMinimal(db);
+    std::istringstream copies("id,bookId,status\nC3,B1,RESERVED\n");
+    BulkImporter importer(db);
+    importer.importCopies(copies);
+    REQUIRE(importer.report().ok());
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+    REQUIRE_FALSE(libsvc.holdOf("C3"));
+    const string loan = libsvc.borrowCopy("C3", "R1", d);
+    REQUIRE(db.loans.at(loan).copy == *db.copies.lookup("C3"));
+    REQUIRE(db.copies.at("C3").status == CopyStatus::LOANED);
+    libsvc.returnCopy("C3", d);
+    REQUIRE(db.copies.at("C3").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Reservas: reservas, recogidas y devoluciones concurrentes") {
+    BioAlert alerts;
+    MemoryDb db;
+    db.books["B1"] = Book{"B1", "Libro", 2000, Author{"A", "1970-01-01"}, "1st", false};
+    for (int i = 0; i < 4; ++i) db.copies["C" + to_string(i)] = Copy{"C" + to_string(i), "B1", CopyStatus::IN_LIBRARY};
+    constexpr int kThreads = 4;
+    for (int t = 0; t < kThreads; ++t) db.readers["R" + to_string(t)] = Reader{"R" + to_string(t), "r@x", {}, {}};
+    db.rebuildIndexes();
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+
+    std::atomic<int> loans{0};
+    {
+        std::vector<std::jthread> ts;
+        for (int t = 0; t < kThreads; ++t) {
+            ts.emplace_back([&, t] {
+                const string reader = "R" + to_string(t);
+                for (int i = 0; i < 200; ++i) {
+                    (void)libsvc.tryReserve("B1", reader, d);
+                    if (auto l = libsvc.tryBorrowAnyCopy("B1", reader, d)) {
+                        ++loans;
+                        libsvc.returnCopy(db.copies.idOf(db.loans.at(*l).copy), d);
+                    }
+                    if (i % 7 == 0) (void)libsvc.tryCancelReservation("B1", reader, d);
+                    if (t == 0 && i % 50 == 0) libsvc.expireHolds(d + std::chrono::days(kHoldDays + 1));
+                }
+                (void)libsvc.tryCancelReservation("B1", reader, d);
+            });
+        }
+    }
+    REQUIRE(loans > 0);
+    REQUIRE(db.checkIndexes());
+    REQUIRE(libsvc.reservationCount("B1") == 0);
+    // Apartados sin recoger vuelven tras vencer; todas las copias acaban libres
+    libsvc.expireHolds(d + std::chrono::days(100));
+    REQUIRE(libsvc.countCopies("B1", CopyStatus::IN_LIBRARY) == 4);
+}
+
+TEST_CASE("Métricas: llamadas, rechazos por código y tamaño de los avisos") {
+    if (!metrics::kEnabled) return; // compilado con BIBLIOTECA_METRICS=OFF
+    using metrics::Op;
+    TestEmailGateway gw;
+    BioAlert alerts;
+    alerts.setGateway(&gw);
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+    alerts.subscribe("B1", "R2");
+    const auto before = metrics::snapshot();
+
+    libsvc.borrowCopy("C1", "R1", d);
+    REQUIRE(libsvc.tryBorrowCopy("C1", "R2", d).error() == LibError::CopyNotAvailable);
+    REQUIRE(libsvc.tryBorrowCopy("C9", "R2", d).error() == LibError::CopyNotFound); // no llega a medirse
+    REQUIRE_THROWS(libsvc.returnCopy("C2", d));
+    libsvc.returnCopy("C1", d); // avisa a R2
+    REQUIRE(gw.out.size() == 1);
+
+    const auto after = metrics::snapshot();
+    auto delta = [&](auto f) { return f(after) - f(before); };
+    REQUIRE(delta([](auto& s) { return s.calls(Op::Borrow); }) == 2);
+    REQUIRE(delta([](auto& s) { return s.calls(Op::Return); }) == 2);
+    REQUIRE(delta([](auto& s) { return s.rejections(Op::Borrow, LibError::CopyNotAvailable); }) == 1);
+    REQUIRE(delta([](auto& s) { return s.rejections(Op::Borrow, LibError::CopyNotFound); }) == 1);
+    REQUIRE(delta([](auto& s) { return s.rejections(Op::Return, LibError::CopyNotLoaned); }) == 1);
+    REQUIRE(delta([](auto& s) { return s.rejections(Op::Borrow); }) == 2);
+    // Un aviso a un suscriptor, con un envío al gateway
+    REQUIRE(delta([](auto& s) { return s.calls(Op::Notify); }) == 1);
+    REQUIRE(delta([](auto& s) { return s.calls(Op::GatewaySend); }) == 1);
+    REQUIRE(delta([](auto& s) { return s.fanoutEvents; }) == 1);
+    REQUIRE(delta([](auto& s) { return s.fanoutSum; }) == 1);
+    REQUIRE(delta([](auto& s) { return s.fanout[metrics::fanoutBucket(1)]; }) == 1);
+
+    // Los cubos de latencia suman las llamadas
+    for (std::size_t op = 0; op < metrics::kOpCount; ++op) {
+        std::uint64_t n = 0;
+        for (auto b : after.latency[op].buckets) n += b;
+        REQUIRE(n == after.latency[op].count);
+    }
+    STATIC_REQUIRE(metrics::latencyBucket(0) == 0);
+    STATIC_REQUIRE(metrics::latencyBucket(64) == 0);
+    STATIC_REQUIRE(metrics::latencyBucket(65) == 1);
+    STATIC_REQUIRE(metrics::latencyBucket(128) == 1);
+    STATIC_REQUIRE(metrics::latencyBucket(129) == 2);
+    STATIC_REQUIRE(metrics::latencyBucket(~std::uint64_t{0}) == metrics::kLatencyBuckets - 1);
+    STATIC_REQUIRE(metrics::fanoutBucket(0) == 0);
+    STATIC_REQUIRE(metrics::fanoutBucket(3) == 2);
+    STATIC_REQUIRE(metrics::fanoutBucket(4) == 3);
+}
+
+TEST_CASE("Métricas: las cuentas de hilos que ya terminaron siguen en el total y en Prometheus") {
+    if (!metrics::kEnabled) return; // compilado con BIBLIOTECA_METRICS=OFF
+    using metrics::Op;
+    BioAlert alerts; // sin gateway: las operaciones no avisan
+    MemoryDb db;
+    db.books["B1"] = Book{"B1", "T", 2020, Author{"A", "1950-01-01"}, "1st", false};
+    constexpr int kThreads = 4, kRounds = 200;
+    for (int t = 0; t < kThreads; ++t) {
+        db.copies["C" + to_string(t)] = Copy{"C" + to_string(t), "B1", CopyStatus::IN_LIBRARY};
+        db.readers["R" + to_string(t)] = Reader{"R" + to_string(t), "r@x", {}, {}};
+    }
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+    const auto before = metrics::snapshot();
+
+    std::atomic<int> unexpected{0};
+    std::vector<std::thread> pool;
+    for (int t = 0; t < kThreads; ++t) {
+        pool.emplace_back([&, t] {
+            const string c = "C" + to_string(t), r = "R" + to_string(t);
+            for (int i = 0; i < kRounds; ++i) {
+                libsvc.borrowCopy(c, r, d);
+                if (libsvc.tryBorrowCopy(c, r, d)) unexpected++; // ya prestada
+                libsvc.returnCopy(c, d);
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    REQUIRE(unexpected == 0);
+
+    const auto after = metrics::snapshot();
+    REQUIRE(after.calls(Op::Borrow) - before.calls(Op::Borrow) == 2u * kThreads * kRounds);
+    REQUIRE(after.calls(Op::Return) - before.calls(Op::Return) == 1u * kThreads * kRounds);
+    REQUIRE(after.rejections(Op::Borrow, LibError::CopyNotAvailable) -
+                before.rejections(Op::Borrow, LibError::CopyNotAvailable) == 1u * kThreads * kRounds);
+
+    const string text = metrics::prometheusText();
+    REQUIRE(text.find("# TYPE biblioteca_op_duration_seconds histogram\n") != string::npos);
+    REQUIRE(text.find("biblioteca_op_duration_seconds_bucket{op=\"borrow\",le=\"6.4e-08\"} ") != string::npos);
+    const string count = "biblioteca_op_duration_seconds_count{op=\"return\"} ";
+    const auto at = text.find(count);
+    REQUIRE(at != string::npos);
+    REQUIRE(std::stoull(text.substr(at + count.size())) >= after.calls(Op::Return));
+    REQUIRE(text.find("biblioteca_rejections_total{op=\"borrow\",code=\"COPY_NOT_AVAILABLE\"} ") != string::npos);
+    REQUIRE(text.find("# TYPE biblioteca_notify_fanout histogram\n") != string::npos);
+    REQUIRE(text.find("biblioteca_notify_fanout_bucket{le=\"+Inf\"} ") != string::npos);
+}
+
+TEST_CASE("Async: miles de devoluciones con el aviso en vuelo sin ocupar hilos") {
+    TestAsyncEmailGateway gw;
+    BioAlert alerts;
+    alerts.setAsyncGateway(&gw);
+    MemoryDb db;
+    constexpr int kBooks = 2000;
+    for (int i = 0; i < kBooks; ++i) {
+        const string b = "B" + to_string(i), c = "C" + to_string(i), r = "R" + to_string(i);
+        db.books[b] = Book{b, "Titulo " + to_string(i), 2020, Author{"A", "1950-01-01"}, "1st", false};
+        db.copies[c] = Copy{c, b, CopyStatus::IN_LIBRARY};
+        db.readers[r] = Reader{r, r + "@x", {}, {}};
+    }
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+    for (int i = 0; i < kBooks; ++i) {
+        REQUIRE(syncWait(libsvc.borrowCopyAsync("C" + to_string(i), "R" + to_string(i), d)));
+        alerts.subscribe("B" + to_string(i), "R" + to_string((i + 1) % kBooks));
+    }
+
+    // Todas se lanzan desde este hilo y quedan suspendidas en el envío
+    std::atomic<int> finished{0}, failed{0};
+    for (int i = 0; i < kBooks; ++i) {
+        spawn([](LibraryService& svc, string copy, std::chrono::sys_days day, std::atomic<int>& finished,
+                 std::atomic<int>& failed) -> Task<> {
+            const auto r = co_await svc.returnCopyAsync(copy, day);
+            if (!r) failed++;
+            finished++;
+        }(libsvc, "C" + to_string(i), d, finished, failed));
+    }
+    REQUIRE(gw.pending() == size_t(kBooks));
+    REQUIRE(finished == 0);
+    // La devolución ya está hecha; sólo falta el aviso
+    REQUIRE(db.copies.at("C7").status == CopyStatus::IN_LIBRARY);
+    REQUIRE(gw.out.size() == size_t(kBooks));
+    REQUIRE(gw.out[0].subject == "Disponible: Titulo 0");
+    REQUIRE(gw.out[0].to == "R1@x");
+
+    // Dos hilos completan los envíos; cada corrutina sigue en el que completa el suyo
+    std::thread a([&] { gw.complete(0, kBooks / 2); });
+    std::thread b([&] { gw.complete(kBooks / 2, kBooks); });
+    a.join();
+    b.join();
+    REQUIRE(finished == kBooks);
+    REQUIRE(failed == 0);
+    REQUIRE(db.checkIndexes());
+}
+
+TEST_CASE("Async: syncWait, errores, apartados y gateways síncronos adaptados") {
+    MemoryDb db; seedMinimal(db);
+    BioAlert alerts;
+    LibraryService libsvc(db, alerts);
+    const auto d = makeDate(2025, 10, 1);
+
+    // Sin gateway asíncrono se envía por el síncrono, dentro de la tarea
+    TestEmailGateway sync;
+    alerts.setGateway(&sync);
+    alerts.subscribe("B1", "R2");
+    const auto loan = syncWait(libsvc.borrowCopyAsync("C1", "R1", d));
+    REQUIRE(loan);
+    REQUIRE(db.loans.at(*loan).reader == *db.readers.lookup("R1"));
+    REQUIRE(syncWait(libsvc.borrowCopyAsync("C1", "R2", d)).error() == LibError::CopyNotAvailable);
+    REQUIRE(syncWait(libsvc.returnCopyAsync("C9", d)).error() == LibError::CopyNotFound);
+    REQUIRE(syncWait(libsvc.returnCopyAsync("C1", d)));
+    REQUIRE(sync.out.size() == 1);
+    REQUIRE(syncWait(libsvc.returnCopyAsync("C1", d)).error() == LibError::CopyNotLoaned);
+
+    // El de prueba, adaptado: el envío va en el hilo del adaptador
+    sync.out.clear();
+    {
+        AsyncGatewayAdapter adapter(sync);
+        alerts.setAsyncGateway(&adapter);
+        syncWait(libsvc.borrowAnyCopyAsync("B1", "R1", d)).value();
+        libsvc.reserve("B1", "R2", d);
+        REQUIRE(syncWait(libsvc.returnCopyAsync("C1", d)));
+        REQUIRE(sync.out.size() == 1);
+        REQUIRE(sync.out[0].subject == "Apartado: Software Engineering");
+        REQUIRE(sync.out[0].to == db.readers.at("R2").email);
+        REQUIRE(syncWait(libsvc.borrowCopyAsync("C1", "R2", d)));
+
+        // Originales: mismo código de error y aviso que la versión síncrona
+        alerts.subscribe("B2", "R1");
+        libsvc.borrowOriginalNewRelease("B2", "R2", d);
+        REQUIRE(syncWait(libsvc.returnOriginalNewReleaseAsync("B2", "R1", d)).error() == LibError::LoanNotFound);
+        REQUIRE(syncWait(libsvc.returnOriginalNewReleaseAsync("B2", "R2", d)));
+        REQUIRE(sync.out.size() == 2);
+        REQUIRE(sync.out[1].subject == "Disponible: Clean C++ (New Release)");
+        REQUIRE(adapter.pending() == 0);
+        alerts.setAsyncGateway(nullptr);
+    }
+
+    // ConsoleEmailGateway adaptado escribe en cout desde su hilo
+    {
+        std::ostringstream captured;
+        auto* old = std::cout.rdbuf(captured.rdbuf());
+        ConsoleEmailGateway console;
+        {
+            AsyncGatewayAdapter adapter(console);
+            alerts.setAsyncGateway(&adapter);
+            REQUIRE(syncWait(alerts.notifyHoldAsync("a@x", "T", d)));
+            alerts.setAsyncGateway(nullptr);
+        }
+        std::cout.rdbuf(old);
+        REQUIRE(captured.str() == "[EMAIL] To: a@x | Apartado: T | Te lo guardamos hasta el 2025-10-01\n");
+    }
+
+    // Un gateway que lanza acaba en false; una excepción de la tarea llega a syncWait
+    struct Failing : NotificationGateway {
+        void sendEmail(const string&, const string&, const string&) override { throw std::runtime_error("smtp"); }
+    } failing;
+    {
+        AsyncGatewayAdapter adapter(failing);
+        const EmailView msg{"a@x", "s", "b"};
+        auto send = [](AsyncNotificationGateway& gw, const EmailView& m) -> Task<bool> {
+            co_return co_await sendAsync(gw, {&m, 1});
+        };
+        REQUIRE_FALSE(syncWait(send(adapter, msg)));
+        adapter.stop();
+        REQUIRE_FALSE(syncWait(send(adapter, msg))); // ya detenido: se completa en la llamada
+    }
+    auto boom = []() -> Task<int> { throw std::runtime_error("boom"); co_return 0; };
+    REQUIRE_THROWS_WITH(syncWait(boom()), "boom");
+}
+
+TEST_CASE("Async: reset() también suelta el gateway asíncrono") {
+    TestAsyncEmailGateway gw;
+    BioAlert alerts;
+    TestEmailGateway sync;
+    alerts.setAsyncGateway(&gw);
+    alerts.reset();
+    alerts.setGateway(&sync);
+    REQUIRE(syncWait(alerts.notifyHoldAsync("a@x", "T", makeDate(2025, 10, 1))));
+    REQUIRE(gw.out.empty());      // no se usó el asíncrono ya soltado
+    REQUIRE(sync.out.size() == 1); // cae en el síncrono
+}
+
+TEST_CASE("WAL: la recuperación reaplica con las reglas del servicio que escribió el log") {
+    BioAlert::getInstance().reset();
+    const auto walPath = tempPath("biblioteca_wal_policy.log");
+    const RuntimeLoanPolicy rules{7, 5, 3};
+    MemoryDb db; seedMinimal(db);
+    for (const char* c : {"C3", "C4"}) db.copies[c] = Copy{c, "B1", CopyStatus::IN_LIBRARY};
+    const auto d = makeDate(2025, 10, 1);
+    {
+        WriteAheadLog wal(walPath);
+        ConfigurableLibraryService libsvc(db, BioAlert::getInstance(), rules, &wal);
+        for (const char* c : {"C1", "C2", "C3", "C4"}) libsvc.borrowCopy(c, "R1", d); // 4 > kMaxActiveLoans
+        libsvc.returnCopy("C4", d + std::chrono::days(9)); // 2 días tarde: 6 de baneo
+        REQUIRE(wal.stats().records == 5);
+    }
+    REQUIRE(db.readers.at("R1").activeBanUntil == d + std::chrono::days(15));
+
+    MemoryDb restored; seedMinimal(restored);
+    for (const char* c : {"C3", "C4"}) restored.copies[c] = Copy{c, "B1", CopyStatus::IN_LIBRARY};
+    const RecoveryReport rep = recover(restored, "", walPath, rules);
+    REQUIRE(rep.applied == 5);
+    REQUIRE(dbState(restored) == dbState(db));
+    for (const auto& [id, L] : restored.loans) REQUIRE(L.due == d + std::chrono::days(7));
+    REQUIRE(restored.readers.at("R1").activeBanUntil == d + std::chrono::days(15));
+    REQUIRE(restored.checkIndexes());
+
+    // Con las reglas por defecto el cuarto préstamo no cabe
+    MemoryDb wrong; seedMinimal(wrong);
+    for (const char* c : {"C3", "C4"}) wrong.copies[c] = Copy{c, "B1", CopyStatus::IN_LIBRARY};
+    REQUIRE_THROWS_WITH(recover(wrong, "", walPath), "BORROW_FORBIDDEN");
+    std::filesystem::remove(walPath);
+}
+
+TEST_CASE("WAL: un registro que el log rechaza no cambia el estado del servicio") {
+    BioAlert::getInstance().reset();
+    const auto walPath = tempPath("biblioteca_wal_rechazo.log");
+    std::filesystem::remove(walPath);
+    MemoryDb db; seedMinimal(db);
+    const string big(70000, 'X'); // no cabe en los u16 de longitud de un registro
+    db.copies[big] = Copy{big, "B1", CopyStatus::IN_LIBRARY};
+    const auto d = makeDate(2025, 10, 1);
+    {
+        WriteAheadLog wal(walPath);
+        LibraryService libsvc(db, &wal);
+        const auto before = dbState(db);
+        REQUIRE(libsvc.tryBorrowCopy(big, "R1", d).error() == LibError::WalRecordTooLarge);
+        REQUIRE_THROWS_WITH(libsvc.borrowCopy(big, "R1", d), "WAL_RECORD_TOO_LARGE");
+        const string batch[] = {"C1", big};
+        const BatchResult res = libsvc.borrowBatch("R1", batch, d);
+        REQUIRE_FALSE(res.committed);
+        REQUIRE(res.items[0].error == LibError::BatchAborted);
+        REQUIRE(res.items[1].error == LibError::WalRecordTooLarge);
+        REQUIRE(dbState(db) == before);
+        REQUIRE(db.readers.at("R1").activeLoanIds.empty());
+        REQUIRE(db.checkIndexes());
+
+        // append() lo rechaza sin dejar un marco a medias en el buffer
+        REQUIRE_THROWS_WITH(wal.append(LogOp::ReturnCopy, d, "L1", big, ""), "WAL_RECORD_TOO_LARGE");
+        libsvc.borrowCopy("C1", "R1", d);
+        REQUIRE(wal.stats().records == 1);
+    }
+    std::size_t n = 0;
+    const WalScan scan = readWal(walPath, [&](const WalRecord& r) {
+        REQUIRE(r.itemId == "C1");
+        ++n;
+    });
+    REQUIRE(n == 1);
+    REQUIRE(scan.discardedBytes == 0);
+    std::filesystem::remove(walPath);
+}
+
+TEST_CASE("Snapshot: posiciones y tramos fuera de su sección dan SNAPSHOT_CORRUPT") {
+    BioAlert::getInstance().reset();
+    MemoryDb db; seedMinimal(db);
+    LibraryService libsvc(db);
+    const auto d = makeDate(2025, 10, 1);
+    const string L1 = libsvc.borrowCopy("C1", "R1", d);
+    const auto good = tempPath("biblioteca_snapshot_good.bin");
+    const auto bad = tempPath("biblioteca_snapshot_corrupt.bin");
+    libsvc.writeSnapshot(good);
+
+    // Cabecera: magic[8], version, byteOrder, nextLoanNumber y luego
+    // {offset, count} de 64 bits por sección (Readers = 3, Loans = 4)
+    auto sectionOffset = [&](int s) {
+        std::ifstream in(good, std::ios::binary);
+        in.seekg(24 + 16 * s);
+        std::uint64_t off = 0;
+        in.read(reinterpret_cast<char*>(&off), sizeof off);
+        return off;
+    };
+    // Copia de `good` con un uint32 sobrescrito en `at`
+    auto corrupt = [&](std::uint64_t at, std::uint32_t value) {
+        std::filesystem::copy_file(good, bad, std::filesystem::copy_options::overwrite_existing);
+        std::fstream f(bad, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(std::streamoff(at));
+        f.write(reinterpret_cast<const char*>(&value), sizeof value);
+    };
+    auto loadFails = [&] {
+        MemoryDb out;
+        try { loadSnapshot(out, bad); } catch (const std::runtime_error& e) { return string(e.what()); }
+        return string("OK");
+    };
+
+    // LoanRec: id(8) copy(4) book(4) reader(4) ...
+    const std::uint64_t loans = sectionOffset(4);
+    corrupt(loans + 12, 1000); // libro inexistente
+    REQUIRE_THROWS_WITH(SnapshotView(bad).findLoan(L1), "SNAPSHOT_CORRUPT");
+    REQUIRE(loadFails() == "SNAPSHOT_CORRUPT");
+    corrupt(loans + 16, 0xFFFF0000u); // lector inexistente
+    REQUIRE(loadFails() == "SNAPSHOT_CORRUPT");
+    corrupt(loans + 0, 0x7FFFFFFF); // ID fuera de la tabla de cadenas
+    REQUIRE(loadFails() == "SNAPSHOT_CORRUPT");
+
+    // ReaderRec: id(8) email(8) banUntil(4) loansBegin(4) loansCount(4)
+    const std::uint64_t readers = sectionOffset(3);
+    corrupt(readers + 20, 0xFFFFFFF0u); // tramo de préstamos fuera de ReaderLoans
+    REQUIRE(loadFails() == "SNAPSHOT_CORRUPT");
+
+    // El segundo lector (ReaderRec de 32 bytes) con el ID del primero: los
+    // handles dejarían de coincidir con las posiciones
+    {
+        char id0[8];
+        std::ifstream in(good, std::ios::binary);
+        in.seekg(std::streamoff(readers));
+        in.read(id0, sizeof id0);
+        in.close();
+        corrupt(readers + 32, 0);
+        std::fstream f(bad, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(std::streamoff(readers + 32));
+        f.write(id0, sizeof id0);
+    }
+    REQUIRE(loadFails() == "SNAPSHOT_CORRUPT");
+
+    // Intacto sigue cargando
+    std::filesystem::copy_file(good, bad, std::filesystem::copy_options::overwrite_existing);
+    REQUIRE(loadFails() == "OK");
+    std::filesystem::remove(good);
+    std::filesystem::remove(bad);
+}